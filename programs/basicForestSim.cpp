@@ -127,7 +127,10 @@ int main(int argc, char** argv) {
 
   // Set mandatory initialization classes
   //
-  runManager->SetUserInitialization(new DetectorConstruction(tree, leaf, treeNumber));
+  DetectorConstruction* detector =
+      new DetectorConstruction(tree, leaf, treeNumber);
+  detector->setPhotonHitRecording(true);  // Draw every detected photon
+  runManager->SetUserInitialization(detector);
   OpticalPhysicsList* physicsList = new OpticalPhysicsList;
   runManager->SetUserInitialization(physicsList);
 
@@ -147,7 +147,9 @@ int main(int argc, char** argv) {
 
   // Set mandatory initialization classes
   //
-  runManager->SetUserInitialization(new DetectorConstruction(tree, leaf));
+  DetectorConstruction* detector = new DetectorConstruction(tree, leaf);
+  detector->setPhotonHitRecording(true);  // Draw every detected photon
+  runManager->SetUserInitialization(detector);
   OpticalPhysicsList* physicsList = new OpticalPhysicsList;
   runManager->SetUserInitialization(physicsList);
 
@@ -114,8 +114,10 @@ int main(int argc, char** argv) {
 
   // Set mandatory initialization classes
   //
-  runManager->SetUserInitialization(
-      new LayeredLeafConstruction(leaf, initialTurtle));
+  LayeredLeafConstruction* leafConstruction =
+      new LayeredLeafConstruction(leaf, initialTurtle);
+  leafConstruction->setPhotonHitRecording(true);  // Draw every photon
+  runManager->SetUserInitialization(leafConstruction);
 
   OpticalPhysicsList* physicsList = new OpticalPhysicsList;
   runManager->SetUserInitialization(physicsList);
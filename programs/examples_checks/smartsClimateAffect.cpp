@@ -198,8 +198,7 @@ TGraphAsymmErrors createSummedSpectralGraph(std::string graphName,
                           simulationStepTime / 2.0));
 
         // Get the direct normal irradiance
-        double irradiance =
-            sun.getSpectrum()->getHistogram(spectrumName)->Integral("width");
+        double irradiance = sun.getSpectrum()->getIntegral(spectrumName);
 
         energySum += irradiance * simulationStepTime;
       }
@@ -307,7 +307,7 @@ int main() {
       spectrum = factory->getSpectrum();
 
       double diffuseIrradianceSum =
-          spectrum->getHistogram("Difuse_tilted_irradiance")->Integral("width");
+          spectrum->getIntegral("Difuse_tilted_irradiance");
       diffuseSkyTotalIrradiance.Fill(
           tiltedAzimuth - 180.0, tiltedElevationValue, diffuseIrradianceSum);
     }
@@ -222,12 +222,11 @@ int main(int argc, char** argv) {
     G4int eventNumber = 1;
     runManager->BeamOn(eventNumber);
 
-    auto normalIrradianceHistogram =
-        sun.getSpectrum()->getHistogram("Direct_normal_irradiance");
-    auto diffuseIrradianceHistogram =
-        sun.getSpectrum()->getHistogram("Difuse_horizn_irradiance");
-    totalNormal = normalIrradianceHistogram->Integral("width");    // [W/m^2]
-    totalDiffuse = diffuseIrradianceHistogram->Integral("width");  // [W/m^2]
+    std::shared_ptr<Spectrum> spectrum = sun.getSpectrum();
+    totalNormal =
+        spectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE);  // [W/m^2]
+    totalDiffuse = spectrum->getIntegral(
+        Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE);  // [W/m^2]
     totalInitial +=
         (totalNormal + totalDiffuse) / 1000.0 *
         (simulationStepTime / 3600.0);  // sum over all time slices
@@ -0,0 +1,221 @@
+/*!
+ * @file
+ * \brief Application to precompute the spectra for every time segment of a
+ *        yearly scan, so that scan jobs can read them instead of running
+ *        SMARTS.
+ *
+ */
+
+#include "pvtree/full/solarSimulation/sun.hpp"
+#include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+#include "pvtree/full/solarSimulation/spectrumArchive.hpp"
+#include "pvtree/full/solarSimulation/skyStatePrefetcher.hpp"
+#include "pvtree/climate/climateFactory.hpp"
+#include "pvtree/location/locationDetails.hpp"
+#include "pvtree/utils/getopt_pp.h"
+#include "pvtree/utils/resource.hpp"
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <string>
+#include <regex>
+
+void showHelp() {
+  std::cout << "spectrumArchiveGenerator help" << std::endl;
+  std::cout << "\t --timeSegments <INTEGER> :\t default 12" << std::endl;
+  std::cout << "\t --startDate <INTEGER> :\t default 1/1/2014" << std::endl;
+  std::cout << "\t --endDate <INTEGER> :\t default 1/1/2015" << std::endl;
+  std::cout << "\t --yearSegments <INTEGER> :\t default 12" << std::endl;
+  std::cout << "\t --spectrumTable <ROOT FILENAME> :\t default ''"
+            << std::endl;
+  std::cout << "\t --wavelengthInterval <DOUBLE> [nm] :\t default 0.5"
+            << std::endl;
+  std::cout << "\t --cloudCover :\t apply the climate cloud cover" << std::endl;
+  std::cout << "\t -o, --outputFile <FILENAME> :\t default "
+               "'spectrumArchive.bin'" << std::endl;
+}
+
+bool isSameDay(time_t time1, time_t time2) {
+  // Convert to calendar time
+  struct tm* calendarTime = gmtime(&time1);
+
+  int monthDay1 = calendarTime->tm_mday;
+  int month1 = calendarTime->tm_mon;
+  int year1 = calendarTime->tm_year;
+
+  calendarTime = gmtime(&time2);
+
+  int monthDay2 = calendarTime->tm_mday;
+  int month2 = calendarTime->tm_mon;
+  int year2 = calendarTime->tm_year;
+
+  if (monthDay1 == monthDay2 && month1 == month2 && year1 == year2) {
+    return true;
+  }
+  return false;
+}
+
+/*! \brief Convert date in format DD/MM/YYYY into the time
+ *         since epoch.
+ *
+ *
+ * @param[in] inputDate String representing date in format DD/MM/YYYY
+ * \returns The time since epoch.
+ */
+time_t interpretDate(std::string inputDate) {
+  // Use regular expressions to extract important quantities
+  std::regex regularExpression("(\\d+)/(\\d+)/(\\d+)");
+
+  std::smatch dateMatches;
+  std::regex_match(inputDate, dateMatches, regularExpression);
+
+  // Is the match the correct size?
+  if (dateMatches.size() != 4) {
+    throw std::string("Cannot interpret date: " + inputDate);
+  }
+
+  struct tm calendarTime;
+
+  calendarTime.tm_sec = 0;
+  calendarTime.tm_min = 0;
+  calendarTime.tm_hour = 12;
+  calendarTime.tm_mday = std::stoi(dateMatches[1]);
+  calendarTime.tm_mon = std::stoi(dateMatches[2]) - 1;
+  calendarTime.tm_year = std::stoi(dateMatches[3]) - 1900;
+  calendarTime.tm_isdst = 1;
+
+  return mktime(&calendarTime);
+}
+
+/*! \brief Evaluate the spectra of a yearly scan and store them in an
+ *         archive.
+ *
+ * The days and time segments are chosen in the same way as by the yearly
+ * tree and forest scans, so the same options must be given to both. The
+ * location is taken from the location configuration and recorded in the
+ * archive.
+ *
+ * @param[in] argc Number of command line arguments.
+ * @param[in] argv Accepts the scan schedule and the name of the output file.
+ */
+int main(int argc, char** argv) {
+  unsigned int simulationTimeSegments;
+  std::string startDate;
+  std::string endDate;
+  unsigned int yearSegments;
+  std::string spectrumTableFileName;
+  double wavelengthInterval;
+  bool useCloudCover;
+  std::string outputFileName;
+
+  GetOpt::GetOpt_pp ops(argc, argv);
+
+  // Check for help request
+  if (ops >> GetOpt::OptionPresent('h', "help")) {
+    showHelp();
+    return 0;
+  }
+
+  ops >> GetOpt::Option("timeSegments", simulationTimeSegments, 12u);
+  ops >> GetOpt::Option("startDate", startDate, "1/1/2014");
+  ops >> GetOpt::Option("endDate", endDate, "1/1/2015");
+  ops >> GetOpt::Option("yearSegments", yearSegments, 12u);
+  ops >> GetOpt::Option("spectrumTable", spectrumTableFileName, "");
+  ops >> GetOpt::Option("wavelengthInterval", wavelengthInterval, 0.5);
+  ops >> GetOpt::OptionPresent("cloudCover", useCloudCover);
+  ops >> GetOpt::Option('o', "outputFile", outputFileName,
+                        "spectrumArchive.bin");
+
+  // Also do not run if other arguments are present
+  if (ops.options_remain()) {
+    std::cerr << "Oops! Unexpected options." << std::endl;
+    showHelp();
+    return -1;
+  }
+
+  if (yearSegments == 0 || simulationTimeSegments == 0) {
+    std::cerr << "Need at least one year and time segment." << std::endl;
+    showHelp();
+    return -1;
+  }
+
+  pvtree::loadEnvironment();
+
+  // Attempt to interpret the start and end dates.
+  time_t interpretedStartDate = interpretDate(startDate);
+  time_t interpretedEndDate = interpretDate(endDate);
+
+  // Get the device location details
+  LocationDetails deviceLocation("location.cfg");
+
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setAltitude(deviceLocation.getAltitude());
+  factory->setWavelengthInterval(wavelengthInterval);
+
+  if (spectrumTableFileName != "") {
+    factory->setSpectrumTable(
+        std::make_shared<SpectrumTable>(spectrumTableFileName));
+  }
+
+  // Prepare the climate factory with the default configuration
+  ClimateFactory::instance()->setConfigurationFile("default.cfg");
+  ClimateFactory::instance()->setDeviceLocation(deviceLocation);
+
+  // Obtain the simulation sun
+  Sun sun(deviceLocation);
+  sun.setClimateOption(Sun::CLOUDCOVER, useCloudCover);
+
+  // Scans compare this with their own factory before any climate values
+  // are applied
+  std::uint64_t smartsCardHash = factory->getSmartsCardHash();
+
+  // Create a list of days (avoiding duplication).
+  std::vector<time_t> dayTimes;
+  double yearSegmentSize =
+      (interpretedEndDate - interpretedStartDate) / yearSegments;
+
+  for (unsigned int segmentIndex = 0; segmentIndex < yearSegments + 1;
+       segmentIndex++) {
+    time_t candidateDay = interpretedStartDate + yearSegmentSize * segmentIndex;
+
+    // Check that it is on a different day
+    if (dayTimes.size() > 0 && isSameDay(candidateDay, dayTimes.back())) {
+      continue;
+    }
+
+    dayTimes.push_back(candidateDay);
+  }
+
+  std::cout << "Evaluating " << dayTimes.size() * simulationTimeSegments
+            << " spectra." << std::endl;
+
+  SkyStatePrefetcher skyStatePrefetcher(sun, simulationTimeSegments);
+  skyStatePrefetcher.prefetch(dayTimes, false);
+
+  std::vector<time_t> times;
+  std::vector<std::shared_ptr<Spectrum> > spectra;
+
+  for (unsigned int dayIndex = 0; dayIndex < dayTimes.size(); dayIndex++) {
+    for (unsigned int timeIndex = 0; timeIndex < simulationTimeSegments;
+         timeIndex++) {
+      std::shared_ptr<const SkyState> skyState =
+          skyStatePrefetcher.getSkyState(dayIndex, timeIndex);
+
+      times.push_back(skyState->time);
+      spectra.push_back(skyState->spectrum);
+    }
+  }
+
+  SpectrumArchive::write(outputFileName, times, spectra,
+                         deviceLocation.getLatitude(),
+                         deviceLocation.getLongitude(),
+                         deviceLocation.getAltitude(),
+                         sun.getClimateOptionMask(), wavelengthInterval,
+                         smartsCardHash);
+
+  factory->printSpectrumCacheStatistics();
+  std::cout << "Spectrum archive written to " << outputFileName << std::endl;
+
+  return 0;
+}
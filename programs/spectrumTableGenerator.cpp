@@ -0,0 +1,180 @@
+/*!
+ * @file
+ * \brief Application to precompute a table of SMARTS spectra which can be
+ *        interpolated by the spectrum factory instead of running SMARTS.
+ *
+ */
+
+#include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+#include "pvtree/full/solarSimulation/spectrumTable.hpp"
+#include "pvtree/location/locationDetails.hpp"
+#include "pvtree/utils/getopt_pp.h"
+#include "pvtree/utils/resource.hpp"
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <string>
+
+void showHelp() {
+  std::cout << "spectrumTableGenerator help" << std::endl;
+  std::cout << "\t --minElevation <DOUBLE> [deg] :\t default 0.0" << std::endl;
+  std::cout << "\t --maxElevation <DOUBLE> [deg] :\t default 90.0" << std::endl;
+  std::cout << "\t --elevationSteps <INTEGER> :\t default 91" << std::endl;
+  std::cout << "\t --minPressure <DOUBLE> [mb] :\t default 960.0" << std::endl;
+  std::cout << "\t --maxPressure <DOUBLE> [mb] :\t default 1060.0" << std::endl;
+  std::cout << "\t --pressureSteps <INTEGER> :\t default 6" << std::endl;
+  std::cout << "\t --minWater <DOUBLE> [g/cm^2] :\t default 0.0" << std::endl;
+  std::cout << "\t --maxWater <DOUBLE> [g/cm^2] :\t default 5.0" << std::endl;
+  std::cout << "\t --waterSteps <INTEGER> :\t default 0 (reference atmosphere)"
+            << std::endl;
+  std::cout << "\t --minOzone <DOUBLE> [atm-cm] :\t default 0.2" << std::endl;
+  std::cout << "\t --maxOzone <DOUBLE> [atm-cm] :\t default 0.5" << std::endl;
+  std::cout << "\t --ozoneSteps <INTEGER> :\t default 0 (reference atmosphere)"
+            << std::endl;
+  std::cout << "\t --wavelengthInterval <DOUBLE> [nm] :\t default 0.5"
+            << std::endl;
+  std::cout << "\t -o, --outputFile <ROOT FILENAME> :\t default "
+               "'spectrumTable.root'" << std::endl;
+}
+
+/*! \brief Evenly spaced grid points between two limits inclusive.
+ */
+std::vector<double> gridPoints(double minimum, double maximum,
+                               unsigned int steps) {
+  std::vector<double> points;
+
+  if (steps == 1) {
+    points.push_back(minimum);
+    return points;
+  }
+
+  for (unsigned int s = 0; s < steps; s++) {
+    points.push_back(minimum + (maximum - minimum) * s / (steps - 1.0));
+  }
+
+  return points;
+}
+
+/*! \brief Fill a table of SMARTS spectra over a grid of solar elevation,
+ *         pressure, precipitable water and ozone abundance.
+ *
+ * The altitude of the site is taken from the location configuration, the
+ * same as for the simulation programs. Setting the number of water or ozone
+ * steps to zero uses the reference atmosphere values for those quantities.
+ *
+ * @param[in] argc Number of command line arguments.
+ * @param[in] argv Accepts the limits and number of steps for each axis of
+ *                 the grid and the name of the output file.
+ */
+int main(int argc, char** argv) {
+  double minElevation, maxElevation;
+  double minPressure, maxPressure;
+  double minWater, maxWater;
+  double minOzone, maxOzone;
+  unsigned int elevationSteps, pressureSteps, waterSteps, ozoneSteps;
+  double wavelengthInterval;
+  std::string outputFileName;
+
+  GetOpt::GetOpt_pp ops(argc, argv);
+
+  // Check for help request
+  if (ops >> GetOpt::OptionPresent('h', "help")) {
+    showHelp();
+    return 0;
+  }
+
+  ops >> GetOpt::Option("minElevation", minElevation, 0.0);
+  ops >> GetOpt::Option("maxElevation", maxElevation, 90.0);
+  ops >> GetOpt::Option("elevationSteps", elevationSteps, 91u);
+  ops >> GetOpt::Option("minPressure", minPressure, 960.0);
+  ops >> GetOpt::Option("maxPressure", maxPressure, 1060.0);
+  ops >> GetOpt::Option("pressureSteps", pressureSteps, 6u);
+  ops >> GetOpt::Option("minWater", minWater, 0.0);
+  ops >> GetOpt::Option("maxWater", maxWater, 5.0);
+  ops >> GetOpt::Option("waterSteps", waterSteps, 0u);
+  ops >> GetOpt::Option("minOzone", minOzone, 0.2);
+  ops >> GetOpt::Option("maxOzone", maxOzone, 0.5);
+  ops >> GetOpt::Option("ozoneSteps", ozoneSteps, 0u);
+  ops >> GetOpt::Option("wavelengthInterval", wavelengthInterval, 0.5);
+  ops >> GetOpt::Option('o', "outputFile", outputFileName,
+                        "spectrumTable.root");
+
+  // Also do not run if other arguments are present
+  if (ops.options_remain()) {
+    std::cerr << "Oops! Unexpected options." << std::endl;
+    showHelp();
+    return -1;
+  }
+
+  if (elevationSteps == 0 || pressureSteps == 0) {
+    std::cerr << "Need at least one elevation and pressure step." << std::endl;
+    showHelp();
+    return -1;
+  }
+
+  pvtree::loadEnvironment();
+
+  // Get the device location details
+  LocationDetails deviceLocation("location.cfg");
+
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setAltitude(deviceLocation.getAltitude());
+  factory->setWavelengthInterval(wavelengthInterval);
+
+  // Every grid point is only visited once
+  factory->setSpectrumCacheSize(0u);
+
+  SpectrumTable table(gridPoints(minElevation, maxElevation, elevationSteps),
+                      gridPoints(minPressure, maxPressure, pressureSteps),
+                      waterSteps == 0
+                          ? std::vector<double>()
+                          : gridPoints(minWater, maxWater, waterSteps),
+                      ozoneSteps == 0
+                          ? std::vector<double>()
+                          : gridPoints(minOzone, maxOzone, ozoneSteps),
+                      deviceLocation.getAltitude());
+
+  std::cout << "Filling a spectrum table of "
+            << table.getElevations().size() * table.getPressures().size() *
+                   table.getPrecipitableWaters().size() *
+                   table.getOzoneAbundances().size() << " spectra."
+            << std::endl;
+
+  for (unsigned int e = 0; e < table.getElevations().size(); e++) {
+    factory->setSolarPositionWithElevationAzimuth(table.getElevations()[e],
+                                                  0.0);
+
+    for (unsigned int p = 0; p < table.getPressures().size(); p++) {
+      factory->setAtmosphericPressure(table.getPressures()[p]);
+
+      for (unsigned int w = 0; w < table.getPrecipitableWaters().size(); w++) {
+        if (table.usesReferencePrecipitableWater()) {
+          factory->setDefaultPrecipitableWater();
+        } else {
+          factory->setPrecipitableWater(table.getPrecipitableWaters()[w]);
+        }
+
+        for (unsigned int o = 0; o < table.getOzoneAbundances().size(); o++) {
+          if (table.usesReferenceOzoneAbundance()) {
+            factory->setDefaultOzoneAbundance();
+          } else {
+            factory->setOzoneAbundance(table.getOzoneAbundances()[o]);
+          }
+
+          table.setSpectrum(e, p, w, o, factory->getSpectrum());
+        }
+      }
+    }
+
+    std::cout << "Completed elevation " << table.getElevations()[e] << " [deg]"
+              << std::endl;
+  }
+
+  // Record the remaining SMARTS inputs so the table is only used with them
+  table.setSmartsCardHash(factory->getSmartsCardHash());
+  table.write(outputFileName);
+  std::cout << "Spectrum table written to " << outputFileName << std::endl;
+
+  return 0;
+}
@@ -9,7 +9,9 @@
 #include "pvtree/leafSystem/leafFactory.hpp"
 #include "pvtree/full/detectorConstruction.hpp"
 #include "pvtree/full/actionInitialization.hpp"
+#include "pvtree/full/steppingAction.hpp"
 #include "pvtree/full/primaryGeneratorAction.hpp"
+#include "pvtree/full/segmentSimulation.hpp"
 #include "pvtree/full/opticalPhysicsList.hpp"
 #include "pvtree/full/recorders/convergenceRecorder.hpp"
 #include "pvtree/full/solarSimulation/sun.hpp"
@@ -36,6 +38,10 @@
 #include "G4UIExecutive.hh"
 #include "Randomize.hh"
 #include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
 #include "G4StepLimiterPhysics.hh"
 
 // save diagnostic state
@@ -60,12 +66,32 @@ void showHelp() {
   std::cout << "\t --treeNumber <INTEGER> :\t default 10" << std::endl;
   std::cout << "\t --timeSegments <INTEGER> :\t default 12" << std::endl;
   std::cout << "\t --photonNumber <INTEGER> :\t default 500" << std::endl;
+  std::cout << "\t --subEvents <INTEGER> :\t default 1" << std::endl;
+  std::cout << "\t --quasiRandom :\t sample the photons with Sobol points"
+            << std::endl;
+  std::cout << "\t --aimAtTrees :\t aim the photons at the trees when the "
+               "floor does not reflect" << std::endl;
+  std::cout << "\t --targetRelativeError <DOUBLE> :\t default 0 (fixed "
+               "photon number)" << std::endl;
+  std::cout << "\t --chunkEvents <INTEGER> :\t default 4" << std::endl;
+  std::cout << "\t --minimumChunks <INTEGER> :\t default 3" << std::endl;
+  std::cout << "\t --maximumPhotonNumber <INTEGER> :\t default 100000"
+            << std::endl;
+  std::cout << "\t --threads <INTEGER> :\t default 1" << std::endl;
+  std::cout << "\t --killStrayPhotons :\t stop photons which cannot reach "
+               "the trees" << std::endl;
+  std::cout << "\t --strayPhotonMargin <DOUBLE> [m] :\t default 0.0"
+            << std::endl;
   std::cout << "\t --geant4Seed <INTEGER> :\t default 1" << std::endl;
   std::cout << "\t --parameterSeedOffset <INTEGER> :\t default 1" << std::endl;
   std::cout << "\t --inputTreeFile <ROOT FILENAME>" << std::endl;
   std::cout << "\t --minimumSensitiveArea <DOUBLE> [m^2] :\t default 1.0"
             << std::endl;
   std::cout << "\t --maximumTreeTrials <INTEGER> :\t default 1000" << std::endl;
+  std::cout << "\t --spectrumTable <ROOT FILENAME> :\t default ''"
+            << std::endl;
+  std::cout << "\t --wavelengthInterval <DOUBLE> [nm] :\t default 0.5"
+            << std::endl;
 }
 
 /*! \brief Efficient tree search main test.
@@ -90,12 +116,24 @@ int main(int argc, char** argv) {
   unsigned int treeNumber;
   unsigned int simulationTimeSegments;
   unsigned int photonNumberPerTimeSegment;
+  unsigned int subEventNumber;
+  bool useQuasiRandom;
+  bool aimAtTrees;
+  double targetRelativeError;
+  unsigned int chunkEventNumber;
+  unsigned int minimumChunkNumber;
+  unsigned int maximumPhotonNumber;
+  unsigned int threadNumber;
+  bool killStrayPhotons;
+  double strayPhotonMargin;
   int geant4Seed;
   int parameterSeedOffset;
   std::string inputTreeFileName;
   bool singleTreeRunning = false;
   double minimumSensitiveArea;
   unsigned int maximumTreeTrials;
+  std::string spectrumTableFileName;
+  double wavelengthInterval;
 
   GetOpt::GetOpt_pp ops(argc, argv);
 
@@ -110,11 +148,23 @@ int main(int argc, char** argv) {
   ops >> GetOpt::Option("treeNumber", treeNumber, 10u);
   ops >> GetOpt::Option("timeSegments", simulationTimeSegments, 12u);
   ops >> GetOpt::Option("photonNumber", photonNumberPerTimeSegment, 500u);
+  ops >> GetOpt::Option("subEvents", subEventNumber, 1u);
+  ops >> GetOpt::OptionPresent("quasiRandom", useQuasiRandom);
+  ops >> GetOpt::OptionPresent("aimAtTrees", aimAtTrees);
+  ops >> GetOpt::Option("targetRelativeError", targetRelativeError, 0.0);
+  ops >> GetOpt::Option("chunkEvents", chunkEventNumber, 4u);
+  ops >> GetOpt::Option("minimumChunks", minimumChunkNumber, 3u);
+  ops >> GetOpt::Option("maximumPhotonNumber", maximumPhotonNumber, 100000u);
+  ops >> GetOpt::Option("threads", threadNumber, 1u);
+  ops >> GetOpt::OptionPresent("killStrayPhotons", killStrayPhotons);
+  ops >> GetOpt::Option("strayPhotonMargin", strayPhotonMargin, 0.0);
   ops >> GetOpt::Option("geant4Seed", geant4Seed, 1);
   ops >> GetOpt::Option("parameterSeedOffset", parameterSeedOffset, 1);
   ops >> GetOpt::Option("inputTreeFile", inputTreeFileName, "");
   ops >> GetOpt::Option("minimumSensitiveArea", minimumSensitiveArea, 1.0);
   ops >> GetOpt::Option("maximumTreeTrials", maximumTreeTrials, 1000u);
+  ops >> GetOpt::Option("spectrumTable", spectrumTableFileName, "");
+  ops >> GetOpt::Option("wavelengthInterval", wavelengthInterval, 0.5);
 
   // Report input parameters
   if (inputTreeFileName != "") {
@@ -135,6 +185,32 @@ int main(int argc, char** argv) {
             << std::endl;
   std::cout << "Considering " << photonNumberPerTimeSegment
             << " photons per time segments." << std::endl;
+  if (subEventNumber > 1) {
+    std::cout << "Splitting the photons of each time segment into "
+              << subEventNumber << " events." << std::endl;
+  }
+  if (useQuasiRandom) {
+    std::cout << "Sampling the photons with scrambled Sobol points."
+              << std::endl;
+  }
+  if (aimAtTrees) {
+    std::cout << "Aiming the photons at the trees." << std::endl;
+  }
+  if (targetRelativeError > 0.0) {
+    std::cout << "Simulating each time segment in chunks of "
+              << chunkEventNumber << " events until, after at least "
+              << minimumChunkNumber << " chunks, the relative error is "
+              << targetRelativeError << " or " << maximumPhotonNumber
+              << " photons have been used." << std::endl;
+  }
+  if (threadNumber > 1) {
+    std::cout << "Tracking the events on " << threadNumber << " threads."
+              << std::endl;
+  }
+  if (killStrayPhotons) {
+    std::cout << "Stopping photons which cannot reach within "
+              << strayPhotonMargin << " m of the trees." << std::endl;
+  }
 
   // Also do not run if other arguments are present
   if (ops.options_remain()) {
@@ -143,6 +219,24 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (subEventNumber == 0) {
+    std::cerr << "Need at least one event per time segment." << std::endl;
+    return -1;
+  }
+
+  if (targetRelativeError > 0.0 && chunkEventNumber * subEventNumber < 2) {
+    std::cerr << "Need at least two events per chunk to estimate the error."
+              << std::endl;
+    return -1;
+  }
+
+  // Every sub-event has the same number of photons
+  unsigned int photonNumberPerEvent =
+      (photonNumberPerTimeSegment + subEventNumber - 1) / subEventNumber;
+  SegmentSimulationSettings segmentSettings = {
+      subEventNumber, photonNumberPerEvent, targetRelativeError,
+      chunkEventNumber, minimumChunkNumber, maximumPhotonNumber};
+
   pvtree::loadEnvironment();
 
   // Prepare initial conditions for test trunk and leaves
@@ -169,6 +263,15 @@ int main(int argc, char** argv) {
   // Set the altitude of the spectrum factory using location details
   SpectrumFactory::instance()->setAltitude(deviceLocation.getAltitude());
 
+  // Coarser spectra are sufficient for screening runs
+  SpectrumFactory::instance()->setWavelengthInterval(wavelengthInterval);
+
+  // Interpolate spectra from a precomputed table when one is provided
+  if (spectrumTableFileName != "") {
+    SpectrumFactory::instance()->setSpectrumTable(
+        std::make_shared<SpectrumTable>(spectrumTableFileName));
+  }
+
   // Prepare the climate factory with the default configuration
   ClimateFactory::instance()->setConfigurationFile("default.cfg");
   ClimateFactory::instance()->setDeviceLocation(deviceLocation);
@@ -196,7 +299,23 @@ int main(int argc, char** argv) {
   G4Random::setTheEngine(new CLHEP::RanecuEngine);
   G4Random::setTheSeed(geant4Seed);
 
-  G4RunManager* runManager = new G4RunManager;
+  // Share the events of each run between worker threads if requested
+  G4RunManager* runManager = 0;
+#ifdef G4MULTITHREADED
+  if (threadNumber > 1) {
+    G4MTRunManager* mtRunManager = new G4MTRunManager;
+    mtRunManager->SetNumberOfThreads(threadNumber);
+    runManager = mtRunManager;
+  }
+#else
+  if (threadNumber > 1) {
+    std::cerr << "Geant4 was built without multi-threading, using one thread."
+              << std::endl;
+  }
+#endif
+  if (runManager == 0) {
+    runManager = new G4RunManager;
+  }
 
   // Set mandatory initialization classes
   DetectorConstruction* detector = new DetectorConstruction(tree, leaf);
@@ -209,12 +328,20 @@ int main(int argc, char** argv) {
   runManager->SetUserInitialization(physicsList);
 
   // Setup primary generator to initialize for the simulation
-  runManager->SetUserInitialization(new ActionInitialization(
+  ActionInitialization* actionInitialization = new ActionInitialization(
       &recorder,
-      [&photonNumberPerTimeSegment, &sun ]() -> G4VUserPrimaryGeneratorAction *
+      [&photonNumberPerEvent, &sun, &useQuasiRandom, &aimAtTrees ]()
+          -> G4VUserPrimaryGeneratorAction *
       {
-        return new PrimaryGeneratorAction(photonNumberPerTimeSegment, &sun);
-      }));
+        PrimaryGeneratorAction* primaryGeneratorAction =
+            new PrimaryGeneratorAction(photonNumberPerEvent, &sun);
+        primaryGeneratorAction->SetQuasiRandomSampling(useQuasiRandom);
+        primaryGeneratorAction->SetTreeEnvelopeSampling(aimAtTrees);
+        return primaryGeneratorAction;
+      });
+  actionInitialization->setPhotonKilling(killStrayPhotons,
+                                         strayPhotonMargin * m);
+  runManager->SetUserInitialization(actionInitialization);
 
   // Initialize G4 kernel
   runManager->Initialize();
@@ -271,7 +398,7 @@ int main(int argc, char** argv) {
 
       detector->resetGeometry(tree, leaf);
       //      runManager->GeometryHasBeenModified();
-      runManager->ReinitializeGeometry(true, false);         // clean up
+      runManager->ReinitializeGeometry(true, threadNumber > 1);  // clean up
       runManager->BeamOn(0); // fake start to build geometry
 
       // Lets not bother with small surface areas!
@@ -295,16 +422,18 @@ int main(int argc, char** argv) {
       dummytime = (int)simulationStartingTime + (int)timeIndex * simulationStepTime + floor(simulationStepTime / 2.0);
       sun.setTime(dummytime);
 
-      // Run simulation with a single event per time point
-      G4int eventNumber = 1;
-      runManager->BeamOn(eventNumber);
+      // Evaluate the sky now so that the worker threads only read it
+      std::shared_ptr<const SkyState> skyState = sun.getSkyState();
 
-      auto normalIrradianceHistogram =
-          sun.getSpectrum()->getHistogram("Direct_normal_irradiance");
-      auto diffuseIrradianceHistogram =
-          sun.getSpectrum()->getHistogram("Difuse_horizn_irradiance");
-      totalNormal = normalIrradianceHistogram->Integral("width");    // [W/m^2]
-      totalDiffuse = diffuseIrradianceHistogram->Integral("width");  // [W/m^2]
+      // Run simulation with the sub-events of a time point, or in chunks of
+      // them until the energy deposited has converged.
+      simulateSegment(runManager, recorder, *skyState, segmentSettings);
+
+      std::shared_ptr<Spectrum> spectrum = sun.getSpectrum();
+      totalNormal =
+          spectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE);  // [W/m^2]
+      totalDiffuse = spectrum->getIntegral(
+          Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE);  // [W/m^2]
       totalInitial +=
           (totalNormal + totalDiffuse) / 1000.0 *
           (simulationStepTime / 3600.0);  // sum over all time slices
@@ -325,15 +454,12 @@ int main(int argc, char** argv) {
 
     // Sum up the energy deposited (in KiloWatt-Hours)
     double totalEnergyDeposited = 0.0;
-    std::vector<std::vector<double> > hitEnergies =
-        recorder.getSummedHitEnergies();
+    std::vector<double> meanHitEnergies = recorder.getMeanHitEnergies();
 
     for (unsigned int timeIndex = 0; timeIndex < simulationTimeSegments;
          timeIndex++) {
-      for (double eventHitEnergy : hitEnergies[timeIndex]) {
-        totalEnergyDeposited +=
-            (eventHitEnergy / 1000.0) * (simulationStepTime / 3600.0);
-      }
+      totalEnergyDeposited += (meanHitEnergies[timeIndex] / 1000.0) *
+                              (simulationStepTime / 3600.0);
     }
 
     // Don't need to keep old records after analysis performed.
@@ -379,6 +505,11 @@ int main(int argc, char** argv) {
     //     leafExportList.Add(clonedLeaf);
   }
 
+  if (killStrayPhotons) {
+    std::cout << "Stopped " << SteppingAction::GetKilledPhotonNumber()
+              << " photons which could not reach the trees." << std::endl;
+  }
+
   // Job termination
   delete runManager;
 
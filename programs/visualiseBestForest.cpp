@@ -168,7 +168,10 @@ int main(int argc, char** argv) {
 
   // Set mandatory initialization classes
   //
-  runManager->SetUserInitialization(new DetectorConstruction(bestT, bestL, treeNumber));
+  DetectorConstruction* detector =
+      new DetectorConstruction(bestT, bestL, treeNumber);
+  detector->setPhotonHitRecording(true);  // Draw every detected photon
+  runManager->SetUserInitialization(detector);
   OpticalPhysicsList* physicsList = new OpticalPhysicsList;
   runManager->SetUserInitialization(physicsList);
 
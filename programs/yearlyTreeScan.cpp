@@ -9,7 +9,9 @@
 #include "pvtree/leafSystem/leafFactory.hpp"
 #include "pvtree/full/detectorConstruction.hpp"
 #include "pvtree/full/actionInitialization.hpp"
+#include "pvtree/full/steppingAction.hpp"
 #include "pvtree/full/primaryGeneratorAction.hpp"
+#include "pvtree/full/segmentSimulation.hpp"
 #include "pvtree/full/opticalPhysicsList.hpp"
 #include "pvtree/full/recorders/convergenceRecorder.hpp"
 #include "pvtree/full/solarSimulation/sun.hpp"
@@ -20,6 +22,8 @@
 #include "pvtree/climate/climateFactory.hpp"
 #include "pvtree/location/locationDetails.hpp"
 #include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+#include "pvtree/full/solarSimulation/skyStatePrefetcher.hpp"
+#include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
 #include "pvtree/utils/signalReceiver.hpp"
 
 #include <iostream>
@@ -38,6 +42,10 @@
 #include "G4UIExecutive.hh"
 #include "Randomize.hh"
 #include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
 #include "G4StepLimiterPhysics.hh"
 
 // save diagnostic state
@@ -63,8 +71,33 @@ void showHelp() {
             << std::endl;
   std::cout << "\t --treeNumber <INTEGER> :\t default 10" << std::endl;
   std::cout << "\t --maximumTreeTrials <INTEGER> :\t default 1000" << std::endl;
+  std::cout << "\t --spectrumTable <ROOT FILENAME> :\t default ''"
+            << std::endl;
+  std::cout << "\t --wavelengthInterval <DOUBLE> [nm] :\t default 0.5"
+            << std::endl;
+  std::cout << "\t --spectrumArchive <FILENAME> :\t default ''" << std::endl;
+  std::cout << "\t --noBackgroundPrefetch :\t evaluate the sky before tracking"
+            << std::endl;
   std::cout << "\t --timeSegments <INTEGER> :\t default 12" << std::endl;
   std::cout << "\t --photonNumber <INTEGER> :\t default 500" << std::endl;
+  std::cout << "\t --subEvents <INTEGER> :\t default 1" << std::endl;
+  std::cout << "\t --dayRuns :\t simulate each day in a single run"
+            << std::endl;
+  std::cout << "\t --quasiRandom :\t sample the photons with Sobol points"
+            << std::endl;
+  std::cout << "\t --aimAtTrees :\t aim the photons at the trees when the "
+               "floor does not reflect" << std::endl;
+  std::cout << "\t --targetRelativeError <DOUBLE> :\t default 0 (fixed "
+               "photon number)" << std::endl;
+  std::cout << "\t --chunkEvents <INTEGER> :\t default 4" << std::endl;
+  std::cout << "\t --minimumChunks <INTEGER> :\t default 3" << std::endl;
+  std::cout << "\t --maximumPhotonNumber <INTEGER> :\t default 100000"
+            << std::endl;
+  std::cout << "\t --threads <INTEGER> :\t default 1" << std::endl;
+  std::cout << "\t --killStrayPhotons :\t stop photons which cannot reach "
+               "the trees" << std::endl;
+  std::cout << "\t --strayPhotonMargin <DOUBLE> [m] :\t default 0.0"
+            << std::endl;
   std::cout << "\t --geant4Seed <INTEGER> :\t default 1" << std::endl;
   std::cout << "\t --parameterSeed <INTEGER> :\t default 1" << std::endl;
   std::cout << "\t --inputTreeFile <ROOT FILENAME> :\t default ''" << std::endl;
@@ -143,8 +176,23 @@ int main(int argc, char** argv) {
   std::string treeType, leafType;
   unsigned int treeNumber;
   unsigned int maximumTreeTrials;
+  std::string spectrumTableFileName;
+  double wavelengthInterval;
+  std::string spectrumArchiveFileName;
+  bool noBackgroundPrefetch;
   unsigned int simulationTimeSegments;
   unsigned int photonNumberPerTimeSegment;
+  unsigned int subEventNumber;
+  bool useDayRuns;
+  bool useQuasiRandom;
+  bool aimAtTrees;
+  double targetRelativeError;
+  unsigned int chunkEventNumber;
+  unsigned int minimumChunkNumber;
+  unsigned int maximumPhotonNumber;
+  unsigned int threadNumber;
+  bool killStrayPhotons;
+  double strayPhotonMargin;
   int geant4Seed;
   int parameterSeed;
   std::string inputTreeFileName;
@@ -167,8 +215,23 @@ int main(int argc, char** argv) {
   ops >> GetOpt::Option('l', "leaf", leafType, "cordate");
   ops >> GetOpt::Option("treeNumber", treeNumber, 10u);
   ops >> GetOpt::Option("maximumTreeTrials", maximumTreeTrials, 1000u);
+  ops >> GetOpt::Option("spectrumTable", spectrumTableFileName, "");
+  ops >> GetOpt::Option("wavelengthInterval", wavelengthInterval, 0.5);
+  ops >> GetOpt::Option("spectrumArchive", spectrumArchiveFileName, "");
+  ops >> GetOpt::OptionPresent("noBackgroundPrefetch", noBackgroundPrefetch);
   ops >> GetOpt::Option("timeSegments", simulationTimeSegments, 12u);
   ops >> GetOpt::Option("photonNumber", photonNumberPerTimeSegment, 500u);
+  ops >> GetOpt::Option("subEvents", subEventNumber, 1u);
+  ops >> GetOpt::OptionPresent("dayRuns", useDayRuns);
+  ops >> GetOpt::OptionPresent("quasiRandom", useQuasiRandom);
+  ops >> GetOpt::OptionPresent("aimAtTrees", aimAtTrees);
+  ops >> GetOpt::Option("targetRelativeError", targetRelativeError, 0.0);
+  ops >> GetOpt::Option("chunkEvents", chunkEventNumber, 4u);
+  ops >> GetOpt::Option("minimumChunks", minimumChunkNumber, 3u);
+  ops >> GetOpt::Option("maximumPhotonNumber", maximumPhotonNumber, 100000u);
+  ops >> GetOpt::Option("threads", threadNumber, 1u);
+  ops >> GetOpt::OptionPresent("killStrayPhotons", killStrayPhotons);
+  ops >> GetOpt::Option("strayPhotonMargin", strayPhotonMargin, 0.0);
   ops >> GetOpt::Option("geant4Seed", geant4Seed, 1);
   ops >> GetOpt::Option("parameterSeed", parameterSeed, 1);
   ops >> GetOpt::Option("inputTreeFile", inputTreeFileName, "");
@@ -204,6 +267,36 @@ int main(int argc, char** argv) {
             << std::endl;
   std::cout << "Considering " << photonNumberPerTimeSegment
             << " photons per time segments." << std::endl;
+  if (subEventNumber > 1) {
+    std::cout << "Splitting the photons of each time segment into "
+              << subEventNumber << " events." << std::endl;
+  }
+  if (useDayRuns) {
+    std::cout << "Simulating all the time segments of a day in one run."
+              << std::endl;
+  }
+  if (useQuasiRandom) {
+    std::cout << "Sampling the photons with scrambled Sobol points."
+              << std::endl;
+  }
+  if (aimAtTrees) {
+    std::cout << "Aiming the photons at the trees." << std::endl;
+  }
+  if (targetRelativeError > 0.0) {
+    std::cout << "Simulating each time segment in chunks of "
+              << chunkEventNumber << " events until, after at least "
+              << minimumChunkNumber << " chunks, the relative error is "
+              << targetRelativeError << " or " << maximumPhotonNumber
+              << " photons have been used." << std::endl;
+  }
+  if (threadNumber > 1) {
+    std::cout << "Tracking the events on " << threadNumber << " threads."
+              << std::endl;
+  }
+  if (killStrayPhotons) {
+    std::cout << "Stopping photons which cannot reach within "
+              << strayPhotonMargin << " m of the trees." << std::endl;
+  }
   std::cout << "Starting from day " << startDate << " and finishing on "
             << endDate << " splitting into " << yearSegments << " segments."
             << std::endl;
@@ -216,6 +309,30 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (subEventNumber == 0) {
+    std::cerr << "Need at least one event per time segment." << std::endl;
+    return -1;
+  }
+
+  if (useDayRuns && targetRelativeError > 0.0) {
+    std::cerr << "The photon number of a day run cannot be adapted."
+              << std::endl;
+    return -1;
+  }
+
+  if (targetRelativeError > 0.0 && chunkEventNumber * subEventNumber < 2) {
+    std::cerr << "Need at least two events per chunk to estimate the error."
+              << std::endl;
+    return -1;
+  }
+
+  // Every sub-event has the same number of photons
+  unsigned int photonNumberPerEvent =
+      (photonNumberPerTimeSegment + subEventNumber - 1) / subEventNumber;
+  SegmentSimulationSettings segmentSettings = {
+      subEventNumber, photonNumberPerEvent, targetRelativeError,
+      chunkEventNumber, minimumChunkNumber, maximumPhotonNumber};
+
   pvtree::loadEnvironment();
 
   // Attempt to interpret the start and end dates.
@@ -246,6 +363,15 @@ int main(int argc, char** argv) {
   // Set the altitude of the spectrum factory using location details
   SpectrumFactory::instance()->setAltitude(deviceLocation.getAltitude());
 
+  // Coarser spectra are sufficient for screening runs
+  SpectrumFactory::instance()->setWavelengthInterval(wavelengthInterval);
+
+  // Interpolate spectra from a precomputed table when one is provided
+  if (spectrumTableFileName != "") {
+    SpectrumFactory::instance()->setSpectrumTable(
+        std::make_shared<SpectrumTable>(spectrumTableFileName));
+  }
+
   // Prepare the climate factory with the default configuration
   ClimateFactory::instance()->setConfigurationFile("default.cfg");
   ClimateFactory::instance()->setDeviceLocation(deviceLocation);
@@ -254,6 +380,52 @@ int main(int argc, char** argv) {
   Sun sun(deviceLocation);
   sun.setClimateOption(Sun::CLOUDCOVER, false);  // Ignore clouds!
 
+  // Read the spectra from an archive produced for the same schedule
+  if (spectrumArchiveFileName != "") {
+    std::shared_ptr<SpectrumArchive> spectrumArchive =
+        std::make_shared<SpectrumArchive>(spectrumArchiveFileName);
+
+    if (!spectrumArchive->matchesLocation(deviceLocation.getLatitude(),
+                                          deviceLocation.getLongitude(),
+                                          deviceLocation.getAltitude())) {
+      std::cerr << "Spectrum archive was produced for a different location."
+                << std::endl;
+      return -1;
+    }
+
+    if (!spectrumArchive->matchesConditions(
+            sun.getClimateOptionMask(), wavelengthInterval,
+            SpectrumFactory::instance()->getSmartsCardHash())) {
+      std::cerr << "Spectrum archive was produced under different conditions."
+                << std::endl;
+      return -1;
+    }
+
+    SpectrumFactory::instance()->setSpectrumArchive(spectrumArchive);
+  }
+
+  // Create a list of days (avoiding duplication).
+  std::vector<time_t> dayTimes;
+  double yearSegmentSize =
+      (interpretedEndDate - interpretedStartDate) / yearSegments;
+
+  for (unsigned int segmentIndex = 0; segmentIndex < yearSegments + 1;
+       segmentIndex++) {
+    time_t candidateDay = interpretedStartDate + yearSegmentSize * segmentIndex;
+
+    // Check that it is on a different day
+    if (dayTimes.size() > 0 && isSameDay(candidateDay, dayTimes.back())) {
+      continue;
+    }
+
+    dayTimes.push_back(candidateDay);
+  }
+
+  // The same days are used for every tree, so evaluate the sky for each
+  // time segment once. This runs in the background whilst tracking.
+  SkyStatePrefetcher skyStatePrefetcher(sun, simulationTimeSegments);
+  skyStatePrefetcher.prefetch(dayTimes, !noBackgroundPrefetch);
+
   // Set the default materials to be used
   MaterialFactory::instance()->addConfigurationFile("defaults-tree.cfg");
 
@@ -267,7 +439,23 @@ int main(int argc, char** argv) {
   G4Random::setTheEngine(new CLHEP::RanecuEngine);
   G4Random::setTheSeed(geant4Seed);
 
-  G4RunManager* runManager = new G4RunManager;
+  // Share the events of each run between worker threads if requested
+  G4RunManager* runManager = 0;
+#ifdef G4MULTITHREADED
+  if (threadNumber > 1) {
+    G4MTRunManager* mtRunManager = new G4MTRunManager;
+    mtRunManager->SetNumberOfThreads(threadNumber);
+    runManager = mtRunManager;
+  }
+#else
+  if (threadNumber > 1) {
+    std::cerr << "Geant4 was built without multi-threading, using one thread."
+              << std::endl;
+  }
+#endif
+  if (runManager == 0) {
+    runManager = new G4RunManager;
+  }
 
   // Set mandatory initialization classes
   DetectorConstruction* detector = new DetectorConstruction(tree, leaf);
@@ -276,16 +464,34 @@ int main(int argc, char** argv) {
   // Construct a recorder to obtain results
   ConvergenceRecorder recorder;
 
+  // Keep the results of each time segment apart within a day run
+  if (useDayRuns) {
+    recorder.setEventsPerTimeSegment(subEventNumber);
+  }
+
   OpticalPhysicsList* physicsList = new OpticalPhysicsList;
   runManager->SetUserInitialization(physicsList);
 
   // Setup primary generator to initialize for the simulation
-  runManager->SetUserInitialization(new ActionInitialization(
+  ActionInitialization* actionInitialization = new ActionInitialization(
       &recorder,
-      [&photonNumberPerTimeSegment, &sun ]() -> G4VUserPrimaryGeneratorAction *
+      [&photonNumberPerEvent, &skyStatePrefetcher, &useQuasiRandom,
+       &aimAtTrees, &useDayRuns, &subEventNumber ]()
+          -> G4VUserPrimaryGeneratorAction *
       {
-        return new PrimaryGeneratorAction(photonNumberPerTimeSegment, &sun);
-      }));
+        PrimaryGeneratorAction* primaryGeneratorAction =
+            new PrimaryGeneratorAction(photonNumberPerEvent,
+                                       &skyStatePrefetcher);
+        primaryGeneratorAction->SetQuasiRandomSampling(useQuasiRandom);
+        primaryGeneratorAction->SetTreeEnvelopeSampling(aimAtTrees);
+        if (useDayRuns) {
+          primaryGeneratorAction->SetEventsPerTimeSegment(subEventNumber);
+        }
+        return primaryGeneratorAction;
+      });
+  actionInitialization->setPhotonKilling(killStrayPhotons,
+                                         strayPhotonMargin * m);
+  runManager->SetUserInitialization(actionInitialization);
 
   // Initialize G4 kernel
   runManager->Initialize();
@@ -338,7 +544,7 @@ int main(int argc, char** argv) {
       leaf->randomizeParameters(leafParameterSeed);
 
       detector->resetGeometry(tree, leaf);
-      runManager->ReinitializeGeometry(true, false);         // clean up
+      runManager->ReinitializeGeometry(true, threadNumber > 1);  // clean up
       runManager->BeamOn(0); // fake start to build geometry
       //      runManager->GeometryHasBeenModified();
 
@@ -356,69 +562,47 @@ int main(int argc, char** argv) {
       }
     }
 
-    std::vector<time_t> dayTimes;
     std::vector<double> dayEnergySums;
 
-    // Create a list of days (avoiding duplication).
-    double yearSegmentSize =
-        (interpretedEndDate - interpretedStartDate) / yearSegments;
-
-    for (unsigned int segmentIndex = 0; segmentIndex < yearSegments + 1;
-         segmentIndex++) {
-      time_t candidateDay =
-          interpretedStartDate + yearSegmentSize * segmentIndex;
-
-      // Check that it is on a different day
-      if (dayTimes.size() > 0 && isSameDay(candidateDay, dayTimes.back())) {
-        continue;
-      }
-
-      dayTimes.push_back(candidateDay);
-    }
-
     double totalEvaluatedEnergy = 0.0;
 
     // Repeat simulation for each day
     for (unsigned int dayIndex = 0; dayIndex < dayTimes.size(); dayIndex++) {
       // Perform the simulation between the sunrise and sunset on the selected
       // day.
-      sun.setDate(dayTimes[dayIndex]);
-      int simulationStartingTime = sun.getSunriseTime() * 60;  // s
-      int simulationEndingTime = sun.getSunsetTime() * 60;  // s,
-      int simulationStepTime =
-          (double)(simulationEndingTime - simulationStartingTime) /
-          simulationTimeSegments;
+      int simulationStepTime = skyStatePrefetcher.getStepTime(dayIndex);
 
       // Integrate over the representative day
       // Simulate at all time points with the same number of events...
-      int dummytime = 0;
-      for (unsigned int timeIndex = 0; timeIndex < simulationTimeSegments;
-           timeIndex++) {
-        // Set the time to the mid-point of the day-time segment
-	dummytime = (int)simulationStartingTime + (int)timeIndex * simulationStepTime + floor(simulationStepTime / 2.0);
-        sun.setTime(dummytime);
-
-        // Run simulation with a single event per time point
-        G4int eventNumber = 1;
-        runManager->BeamOn(eventNumber);
+      if (useDayRuns) {
+        // The generator steps through the time segments of the day, with
+        // the sub-events of each segment in turn.
+        skyStatePrefetcher.selectDay(dayIndex);
+        runManager->BeamOn(subEventNumber * simulationTimeSegments);
+      } else {
+        for (unsigned int timeIndex = 0; timeIndex < simulationTimeSegments;
+             timeIndex++) {
+          // Use the sky at the mid-point of the day-time segment
+          skyStatePrefetcher.selectSkyState(dayIndex, timeIndex);
+
+          // Run simulation with the sub-events of a time point, or in chunks of
+          // them until the energy deposited has converged.
+          simulateSegment(runManager, recorder,
+                          *skyStatePrefetcher.getSelectedSkyState(),
+                          segmentSettings);
+        }
       }
 
       // Sum up the energy deposited (in KiloWatt hour)
-      std::vector<std::vector<double> > hitEnergies =
-          recorder.getSummedHitEnergies();
+      std::vector<double> meanHitEnergies = recorder.getMeanHitEnergies();
 
       // Grab the total energy sum firstly for normalization!
       double totalEnergy = 0.0;
 
       for (unsigned int timeIndex = 0; timeIndex < simulationTimeSegments;
            timeIndex++) {
-        // Sum up the energy deposited in a 'run' (should just be a single event
-        // per run).
-        double totalRunEnergy = 0.0;  // kWh
-        for (double eventHitEnergy : hitEnergies[timeIndex]) {
-          totalRunEnergy +=
-              (eventHitEnergy / 1000.0) * (simulationStepTime / 3600.0);
-        }
+        double totalRunEnergy = (meanHitEnergies[timeIndex] / 1000.0) *
+                                (simulationStepTime / 3600.0);  // kWh
 
         totalEnergy += totalRunEnergy;
         totalEvaluatedEnergy += totalRunEnergy;
@@ -492,6 +676,11 @@ int main(int argc, char** argv) {
     currentTreeNumber++;
   }
 
+  if (killStrayPhotons) {
+    std::cout << "Stopped " << SteppingAction::GetKilledPhotonNumber()
+              << " photons which could not reach the trees." << std::endl;
+  }
+
   // Job termination
   delete runManager;
 
@@ -505,6 +694,8 @@ int main(int argc, char** argv) {
   // Output some useful information
   std::cout << currentTreeNumber << " trees produced in " << treeTrialNumber
             << " trials." << std::endl;
+  SpectrumFactory::instance()->printSpectrumCacheStatistics();
+  HosekSkyModelStateCache::instance()->printStatistics();
 
   if (!(treeTrialNumber < maximumTreeTrials)) {
     std::cerr
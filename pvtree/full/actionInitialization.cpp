@@ -4,23 +4,45 @@
 #include "pvtree/full/steppingAction.hpp"
 #include "pvtree/full/recorders/recorderBase.hpp"
 #include "pvtree/full/solarSimulation/sun.hpp"
+#include "G4Threading.hh"
 
 ActionInitialization::ActionInitialization(
     RecorderBase* recorder,
     std::function<G4VUserPrimaryGeneratorAction*()> primaryGenerator)
     : G4VUserActionInitialization(),
       m_recorder(recorder),
-      m_primaryGenerator(primaryGenerator) {}
+      m_primaryGenerator(primaryGenerator),
+      m_killPhotons(false),
+      m_photonKillMargin(0.0) {}
 
 ActionInitialization::~ActionInitialization() {}
 
+void ActionInitialization::setPhotonKilling(bool killPhotons,
+                                            double margin /* = 0.0 */) {
+  m_killPhotons = killPhotons;
+  m_photonKillMargin = margin;
+}
+
 void ActionInitialization::BuildForMaster() const {
   SetUserAction(new RunAction(m_recorder));
 }
 
 void ActionInitialization::Build() const {
+  // Worker threads record into their own recorder, which is merged into
+  // the shared one at the end of every run.
+  RecorderBase* recorder = m_recorder;
+  RecorderBase* masterRecorder = 0;
+
+  if (G4Threading::IsWorkerThread()) {
+    recorder = m_recorder->createWorkerRecorder();
+    masterRecorder = m_recorder;
+  }
+
   SetUserAction(m_primaryGenerator());
-  SetUserAction(new RunAction(m_recorder));
-  SetUserAction(new EventAction(m_recorder));
-  SetUserAction(new SteppingAction());
+  SetUserAction(new RunAction(recorder, masterRecorder));
+  SetUserAction(new EventAction(recorder));
+
+  SteppingAction* steppingAction = new SteppingAction();
+  steppingAction->SetPhotonKilling(m_killPhotons, m_photonKillMargin);
+  SetUserAction(steppingAction);
 }
@@ -7,6 +7,11 @@
  *
  * A number of elements of the simulation are configured here including the
  * analysis performed, number of photons and the light source.
+ *
+ * With a multi-threaded run manager every worker thread gets its own primary
+ * generator and recorder, so the generator function must be safe to call
+ * from any thread and the generators may only read any shared sun or sky
+ * state.
  */
 
 #include "G4VUserActionInitialization.hh"
@@ -26,6 +31,16 @@ class ActionInitialization : public G4VUserActionInitialization {
   virtual void BuildForMaster() const;
   virtual void Build() const;
 
+  /*! \brief Stop tracking photons which can no longer reach the trees.
+   *
+   * Must be set before the run manager is initialized.
+   *
+   * @param[in] killPhotons Enable the killing of stray photons.
+   * @param[in] margin Distance by which the box around the trees is
+   *                   enlarged on every side.
+   */
+  void setPhotonKilling(bool killPhotons, double margin = 0.0);
+
  private:
   /*! \brief Number of photons to generate per event. */
   unsigned int m_photonNumber;
@@ -38,6 +53,10 @@ class ActionInitialization : public G4VUserActionInitialization {
 
   /*! \brief Solar model */
   Sun* m_sun;
+
+  /*! \brief Stray photon killing settings for the stepping actions. */
+  bool m_killPhotons;
+  double m_photonKillMargin;
 };
 
 #endif  // PV_FULL_ACTION_INITIALIZATION
@@ -176,6 +176,10 @@ void DetectorConstruction::ConstructSDandField() {
   m_leafConstructor.ConstructSDandField();
 }
 
+void DetectorConstruction::setPhotonHitRecording(bool recordPhotonHits) {
+  m_leafConstructor.setPhotonHitRecording(recordPhotonHits);
+}
+
 void DetectorConstruction::constructWorld() {
   // Find size of 1 tree and calculate the size of the world box
   double boundingRadius = calculateWorldSize();
@@ -58,6 +58,14 @@ class DetectorConstruction : public G4VUserDetectorConstruction {
    */
   double getSensitiveSurfaceArea();
 
+  /*! \brief Choose whether a hit is recorded for every detected photon,
+   *         for debugging and visualisation, rather than one summed hit
+   *         for each tree.
+   *
+   * Must be set before the run manager is initialized.
+   */
+  void setPhotonHitRecording(bool recordPhotonHits);
+
   /*! \brief Get the total number of leaves attached to tree
    *
    * \returns number of leaves.
@@ -30,14 +30,13 @@ LayeredLeafConstruction::LayeredLeafConstruction(
       m_initialTurtle(initialTurtle),
       m_offsetPosition(0.0,0.0,0.0),
       m_worldLogicalVolume(nullptr),
-      m_trackerSD(nullptr),
       m_airMaterialName("pv-air"),
       m_frontMaterialName("pv-glass"),
       m_sensitiveMaterialName("pv-silicon"),
       m_backMaterialName("pv-glass"),
       //    m_backMaterialName("pv-aluminium"),
-      m_constructedSensitiveDetectors(false),
-      m_sensitiveArea(0.0) {
+      m_sensitiveArea(0.0),
+      m_recordPhotonHits(false) {
   // Set colours for diffent parts of leaves
   m_frontAttributes.SetColour(
       G4Colour(0.0, 0.6, 1.0, 1.0));  // Blue (transparent)
@@ -60,14 +59,13 @@ LayeredLeafConstruction::LayeredLeafConstruction()
       m_leafSystem(nullptr),
       m_initialTurtle(nullptr),
       m_worldLogicalVolume(nullptr),
-      m_trackerSD(nullptr),
       m_airMaterialName("pv-air"),
       //     m_frontMaterialName("pv-glass"),
       m_frontMaterialName("pv-glass"),
       m_sensitiveMaterialName("pv-silicon"),
       m_backMaterialName("pv-glass"),
-      m_constructedSensitiveDetectors(false),
-      m_sensitiveArea(0.0) {
+      m_sensitiveArea(0.0),
+      m_recordPhotonHits(false) {
   m_frontAttributes.SetColour(
       G4Colour(0.0, 0.6, 1.0, 1.0));  // Blue (transparent)
   m_sensitiveAttributes.SetColour(G4Colour(0.32, 0.84, 0.18, 1.0));  // Green
@@ -88,6 +86,10 @@ double LayeredLeafConstruction::getSensitiveSurfaceArea() {
   return m_sensitiveArea;
 }
 
+void LayeredLeafConstruction::setPhotonHitRecording(bool recordPhotonHits) {
+  m_recordPhotonHits = recordPhotonHits;
+}
+
 G4VPhysicalVolume* LayeredLeafConstruction::Construct() {
   // Get the leaf logical geometry from current settings
   G4LogicalVolume* leafEnvelope = constructLeafLogicalVolume();
@@ -179,35 +181,26 @@ G4LogicalVolume* LayeredLeafConstruction::constructForTree(
 }
 
 void LayeredLeafConstruction::ConstructSDandField() {
-  // Turn all the leaves into sensitive detectors.
-  if (!m_constructedSensitiveDetectors) {
-  //  std::cout << "SIM: in Leaf SD Construct()" << std::endl;
-    G4String photovoltaicCellsName = "PVTree/LeafSensitiveDetector";
-
-    // Check if the sensitive detector has already been constructed elsewhere
-    bool showSearchWarning = false;
-    m_trackerSD = static_cast<LeafTrackerSD*>(
-        G4SDManager::GetSDMpointer()->FindSensitiveDetector(
-	    photovoltaicCellsName, showSearchWarning));
-
-    if (m_trackerSD == 0) {
-      m_trackerSD =
+  // Turn all the leaves into sensitive detectors. This is called by every
+  // worker thread, each with its own sensitive detector manager, so the
+  // detector is looked up each time rather than kept by the construction.
+  G4String photovoltaicCellsName = "PVTree/LeafSensitiveDetector";
+
+  // Check if the sensitive detector has already been constructed elsewhere
+  bool showSearchWarning = false;
+  LeafTrackerSD* trackerSD = static_cast<LeafTrackerSD*>(
+      G4SDManager::GetSDMpointer()->FindSensitiveDetector(
+          photovoltaicCellsName, showSearchWarning));
+
+  if (trackerSD == 0) {
+    trackerSD =
         new LeafTrackerSD(photovoltaicCellsName, "TrackerHitsCollection");
-      G4SDManager::GetSDMpointer()->AddNewDetector(m_trackerSD);
-    }
-    //  std::cout << "SIM: in Leaf SD Construct(), tracker SD check 2: " 
-    //	    << m_trackerSD->GetName() << " is active? "
-    //	    << m_trackerSD->isActive() << std::endl;
-    
-    // Set as sensitive all the leave's logical volumes
-    SetSensitiveDetector("LeafSensitive", m_trackerSD, true);
-  } else {
-    // If the sensitive detectors were previously setup don't completely
-    // recreate...
-    
-    // Set as sensitive all the leave's logical volumes
-    SetSensitiveDetector("Leaf", m_trackerSD, true);
+    G4SDManager::GetSDMpointer()->AddNewDetector(trackerSD);
   }
+  trackerSD->setPhotonHitRecording(m_recordPhotonHits);
+
+  // Set as sensitive all the leave's logical volumes
+  SetSensitiveDetector("LeafSensitive", trackerSD, true);
 }
 
 void LayeredLeafConstruction::iterateLSystem() {
@@ -17,7 +17,6 @@ class G4OpticalSurface;
 class TVector3;
 class Vertex;
 class LeafConstructionInterface;
-class LeafTrackerSD;
 
 /*! \brief A class used to describe how to translate a leaf L-System into a
  *         Geant4 geometry.
@@ -67,6 +66,14 @@ class LayeredLeafConstruction : public G4VUserDetectorConstruction {
    */
   double getSensitiveSurfaceArea();
 
+  /*! \brief Choose whether the sensitive detector records a hit for every
+   *         detected photon, rather than one summed hit for each tree.
+   *
+   * Photon hits are only needed for debugging and visualisation. Applied
+   * when the sensitive detectors are constructed.
+   */
+  void setPhotonHitRecording(bool recordPhotonHits);
+
  private:
   /*! \brief Iterate Lindenmeyer system for leaf.
    *
@@ -179,9 +186,6 @@ class LayeredLeafConstruction : public G4VUserDetectorConstruction {
   // Volumes
   G4LogicalVolume* m_worldLogicalVolume;
 
-  // Sensitive volumes
-  LeafTrackerSD* m_trackerSD;
-
   // Materials
   std::string m_airMaterialName;
   std::string m_frontMaterialName;
@@ -195,11 +199,11 @@ class LayeredLeafConstruction : public G4VUserDetectorConstruction {
   G4VisAttributes m_worldVisualAttributes;
   G4VisAttributes m_envelopeAttributes;
 
-  // For re-construction
-  bool m_constructedSensitiveDetectors;
-
   // Important leaf properties
   double m_sensitiveArea;
+
+  // Sensitive detector settings
+  bool m_recordPhotonHits;
 };
 
 #endif  // PVTREE_FULL_LAYERED_LEAF_CONSTRUCTION
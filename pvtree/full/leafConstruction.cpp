@@ -32,10 +32,8 @@ LeafConstruction::LeafConstruction(
       m_initialTurtle(initialTurtle),
       m_leafSolid(nullptr),
       m_worldLogicalVolume(nullptr),
-      m_trackerSD(nullptr),
       m_airMaterialName("pv-air"),
       m_sensitiveMaterialName("pv-silicon"),
-      m_constructedSensitiveDetectors(false),
       m_leafArea(0.0) {
   m_leafVisualAttributes.SetColour(G4Colour(0.32, 0.84, 0.18, 0.7));  // Green
 
@@ -52,10 +50,8 @@ LeafConstruction::LeafConstruction()
       m_initialTurtle(nullptr),
       m_leafSolid(nullptr),
       m_worldLogicalVolume(nullptr),
-      m_trackerSD(nullptr),
       m_airMaterialName("pv-air"),
       m_sensitiveMaterialName("pv-silicon"),
-      m_constructedSensitiveDetectors(false),
       m_leafArea(0.0) {
   m_leafVisualAttributes.SetColour(G4Colour(0.32, 0.84, 0.18, 0.7));  // Green
 
@@ -215,33 +211,25 @@ G4LogicalVolume* LeafConstruction::constructForTree(
 }
 
 void LeafConstruction::ConstructSDandField() {
-  // Turn all the leaves into sensitive detectors.
-  if (!m_constructedSensitiveDetectors) {
-    G4String photovoltaicCellsName = "PVTree/LeafSensitiveDetector";
-
-    // Check if the sensitive detector has already been constructed elsewhere
-    bool showSearchWarning = false;
-    m_trackerSD = static_cast<LeafTrackerSD*>(
-        G4SDManager::GetSDMpointer()->FindSensitiveDetector(
-            photovoltaicCellsName, showSearchWarning));
-
-    if (m_trackerSD == 0) {
-      m_trackerSD =
-          new LeafTrackerSD(photovoltaicCellsName, "TrackerHitsCollection");
-      G4SDManager::GetSDMpointer()->AddNewDetector(m_trackerSD);
-    }
-
-    // Set as sensitive all the leave's logical volumes
-    SetSensitiveDetector("Leaf", m_trackerSD, true);
-
-    m_constructedSensitiveDetectors = true;
-  } else {
-    // If the sensitive detectors were previously setup don't completely
-    // recreate...
-
-    // Set as sensitive all the leave's logical volumes
-    SetSensitiveDetector("Leaf", m_trackerSD, true);
+  // Turn all the leaves into sensitive detectors. This is called by every
+  // worker thread, each with its own sensitive detector manager, so the
+  // detector is looked up each time rather than kept by the construction.
+  G4String photovoltaicCellsName = "PVTree/LeafSensitiveDetector";
+
+  // Check if the sensitive detector has already been constructed elsewhere
+  bool showSearchWarning = false;
+  LeafTrackerSD* trackerSD = static_cast<LeafTrackerSD*>(
+      G4SDManager::GetSDMpointer()->FindSensitiveDetector(
+          photovoltaicCellsName, showSearchWarning));
+
+  if (trackerSD == 0) {
+    trackerSD =
+        new LeafTrackerSD(photovoltaicCellsName, "TrackerHitsCollection");
+    G4SDManager::GetSDMpointer()->AddNewDetector(trackerSD);
   }
+
+  // Set as sensitive all the leave's logical volumes
+  SetSensitiveDetector("Leaf", trackerSD, true);
 }
 
 void LeafConstruction::iterateLSystem() {
@@ -17,7 +17,6 @@ class G4OpticalSurface;
 class TVector3;
 class Vertex;
 class LeafConstructionInterface;
-class LeafTrackerSD;
 
 /*! \brief A class used to describe how to translate a leaf L-System into a
  *           Geant4 geometry.
@@ -85,9 +84,6 @@ class LeafConstruction : public G4VUserDetectorConstruction {
   // Volumes
   G4LogicalVolume* m_worldLogicalVolume;
 
-  // Sensitive volumes
-  LeafTrackerSD* m_trackerSD;
-
   // Materials
   std::string m_airMaterialName;
   std::string m_sensitiveMaterialName;
@@ -96,9 +92,6 @@ class LeafConstruction : public G4VUserDetectorConstruction {
   G4VisAttributes m_leafVisualAttributes;
   G4VisAttributes m_worldVisualAttributes;
 
-  // For re-construction
-  bool m_constructedSensitiveDetectors;
-
   // Important leaf properties
   double m_leafArea;
 };
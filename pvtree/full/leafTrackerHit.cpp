@@ -14,7 +14,9 @@ LeafTrackerHit::LeafTrackerHit()
       m_trackID(-1),
       m_chamberNumber(-1),
       m_energyDeposited(0.0),
-      m_position(0.0, 0.0, 0.0) {}
+      m_position(0.0, 0.0, 0.0),
+      m_treeNumber(-1),
+      m_photonNumber(1) {}
 
 LeafTrackerHit::LeafTrackerHit(const LeafTrackerHit& leafTrackerHit)
     : G4VHit() {
@@ -22,6 +24,8 @@ LeafTrackerHit::LeafTrackerHit(const LeafTrackerHit& leafTrackerHit)
   m_chamberNumber = leafTrackerHit.m_chamberNumber;
   m_energyDeposited = leafTrackerHit.m_energyDeposited;
   m_position = leafTrackerHit.m_position;
+  m_treeNumber = leafTrackerHit.m_treeNumber;
+  m_photonNumber = leafTrackerHit.m_photonNumber;
 }
 
 LeafTrackerHit::~LeafTrackerHit() {}
@@ -31,6 +35,8 @@ const LeafTrackerHit& LeafTrackerHit::operator=(const LeafTrackerHit& right) {
   m_chamberNumber = right.m_chamberNumber;
   m_energyDeposited = right.m_energyDeposited;
   m_position = right.m_position;
+  m_treeNumber = right.m_treeNumber;
+  m_photonNumber = right.m_photonNumber;
 
   return *this;
 }
@@ -42,7 +48,9 @@ G4int LeafTrackerHit::operator==(const LeafTrackerHit& right) const {
 // Base class methods
 void LeafTrackerHit::Draw() {
   G4VVisManager* pVVisManager = G4VVisManager::GetConcreteInstance();
-  if (pVVisManager) {
+
+  // Summed hits have no single track or position to be drawn
+  if (pVVisManager && m_trackID >= 0) {
     G4Circle circle(m_position);
     circle.SetScreenSize(4.);
     circle.SetFillStyle(G4Circle::filled);
@@ -58,7 +66,8 @@ void LeafTrackerHit::Print() {
          << " Energy Deposited: " << std::setw(7)
          << G4BestUnit(m_energyDeposited, "Energy")
          << "Position: " << std::setw(7) << G4BestUnit(m_position, "Length")
-         << G4endl;
+         << " Tree Number: " << m_treeNumber
+         << " Photon Number: " << m_photonNumber << G4endl;
 }
 
 // Setters
@@ -80,6 +89,15 @@ void LeafTrackerHit::setTreeNumber(G4int treeNumber) {
   m_treeNumber = treeNumber;
 }
 
+void LeafTrackerHit::setPhotonNumber(G4int photonNumber) {
+  m_photonNumber = photonNumber;
+}
+
+void LeafTrackerHit::addPhoton(G4double energy) {
+  m_energyDeposited += energy;
+  m_photonNumber++;
+}
+
 // Getters
 G4int LeafTrackerHit::getTrackID() { return m_trackID; }
 
@@ -90,3 +108,5 @@ G4double LeafTrackerHit::getEnergyDeposited() { return m_energyDeposited; }
 G4ThreeVector LeafTrackerHit::getPosition() { return m_position; }
 
 G4int LeafTrackerHit::getTreeNumber() { return m_treeNumber; }
+
+G4int LeafTrackerHit::getPhotonNumber() { return m_photonNumber; }
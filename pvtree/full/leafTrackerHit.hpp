@@ -9,6 +9,9 @@
 
 /* Leaf tracker hit class
 //
+// Either a single detected photon or, when the sensitive detector
+// is only scoring, the sum of all the photons detected by one tree
+// in an event.
  */
 
 class LeafTrackerHit : public G4VHit {
@@ -33,6 +36,10 @@ class LeafTrackerHit : public G4VHit {
   void setEnergyDeposited(G4double energy);
   void setPosition(G4ThreeVector position);
   void setTreeNumber(G4int treeNumber); // Copy number of bounding tree
+  void setPhotonNumber(G4int photonNumber);
+
+  // Add a further detected photon to the hit
+  void addPhoton(G4double energy);
 
   // Getters
   G4int getTrackID();
@@ -40,6 +47,7 @@ class LeafTrackerHit : public G4VHit {
   G4double getEnergyDeposited();
   G4ThreeVector getPosition();
   G4int getTreeNumber();
+  G4int getPhotonNumber();
 
  private:
   G4int m_trackID;
@@ -47,6 +55,7 @@ class LeafTrackerHit : public G4VHit {
   G4double m_energyDeposited;
   G4ThreeVector m_position;
   G4int m_treeNumber;
+  G4int m_photonNumber;
 };
 
 typedef G4THitsCollection<LeafTrackerHit> LeafTrackerHitsCollection;
@@ -1,9 +1,14 @@
 #include "pvtree/full/leafTrackerSD.hpp"
 #include "G4SDManager.hh"
 
+#include <algorithm>
+
 LeafTrackerSD::LeafTrackerSD(const G4String& name,
                              const G4String& hitsCollectionName)
-    : G4VSensitiveDetector(name), m_hitsCollection(NULL) {
+    : G4VSensitiveDetector(name),
+      m_hitsCollection(NULL),
+      m_hitsCollectionID(-1),
+      m_recordPhotonHits(false) {
   collectionName.insert(hitsCollectionName);
 }
 
@@ -17,9 +22,15 @@ void LeafTrackerSD::Initialize(G4HCofThisEvent* eventHitCollection) {
       new LeafTrackerHitsCollection(SensitiveDetectorName, collectionName[0]);
 
   // Add collection to the event hit collection
-  G4int hitCollectionID =
-      G4SDManager::GetSDMpointer()->GetCollectionID(collectionName[0]);
-  eventHitCollection->AddHitsCollection(hitCollectionID, m_hitsCollection);
+  if (m_hitsCollectionID < 0) {
+    m_hitsCollectionID =
+        G4SDManager::GetSDMpointer()->GetCollectionID(collectionName[0]);
+  }
+  eventHitCollection->AddHitsCollection(m_hitsCollectionID, m_hitsCollection);
+
+  // The summed hits of the previous event belong to its collection
+  std::fill(m_treeHits.begin(), m_treeHits.end(),
+            static_cast<LeafTrackerHit*>(0));
 }
 
 G4bool LeafTrackerSD::ProcessHits(G4Step* /*step*/,
@@ -37,6 +48,31 @@ G4bool LeafTrackerSD::ProcessHits_user(const G4Step* step,
 
   //  step->GetTrack()->SetWeight(0.0); // into absorber - gone.
 
+  G4int treeNumber =
+      step->GetPostStepPoint()->GetTouchableHandle()->GetCopyNumber(2);
+
+  if (!m_recordPhotonHits && treeNumber >= 0) {
+    // Only score the energy, adding it to the hit of the tree
+    if (static_cast<unsigned int>(treeNumber) >= m_treeHits.size()) {
+      m_treeHits.resize(treeNumber + 1, 0);
+    }
+
+    LeafTrackerHit* treeHit = m_treeHits[treeNumber];
+
+    if (treeHit) {
+      treeHit->addPhoton(energyDeposit);
+    } else {
+      treeHit = new LeafTrackerHit();
+      treeHit->setEnergyDeposited(energyDeposit);
+      treeHit->setTreeNumber(treeNumber);
+
+      m_treeHits[treeNumber] = treeHit;
+      m_hitsCollection->insert(treeHit);
+    }
+
+    return true;
+  }
+
   // Create a hit object storing all the information
   LeafTrackerHit* hit = new LeafTrackerHit();
 
@@ -45,8 +81,7 @@ G4bool LeafTrackerSD::ProcessHits_user(const G4Step* step,
       step->GetPreStepPoint()->GetTouchableHandle()->GetCopyNumber());
   hit->setEnergyDeposited(energyDeposit);
   hit->setPosition(step->GetPostStepPoint()->GetPosition());
-  hit->setTreeNumber(step->GetPostStepPoint()->GetTouchableHandle()
-                     ->GetCopyNumber(2));
+  hit->setTreeNumber(treeNumber);
 
   m_hitsCollection->insert(hit);
 
@@ -61,3 +96,11 @@ void LeafTrackerSD::EndOfEvent(G4HCofThisEvent* /*eventHitCollection*/) {
     for (G4int i = 0; i < numberOfHits; i++) (*m_hitsCollection)[i]->Print();
   }
 }
+
+void LeafTrackerSD::setPhotonHitRecording(G4bool recordPhotonHits) {
+  m_recordPhotonHits = recordPhotonHits;
+}
+
+G4bool LeafTrackerSD::getPhotonHitRecording() const {
+  return m_recordPhotonHits;
+}
@@ -12,6 +12,12 @@ class G4HCofThisEvent;
 
 /* Leaf tracker sensitive detector class
 //
+// Every worker thread constructs its own instance, so the
+// hits of an event are only ever touched by one thread.
+//
+// By default the photons detected by each tree are summed into
+// a single hit per event. Recording a hit for every photon is
+// only needed for debugging and visualisation.
  */
 
 class LeafTrackerSD : public G4VSensitiveDetector {
@@ -25,8 +31,17 @@ class LeafTrackerSD : public G4VSensitiveDetector {
   virtual void EndOfEvent(G4HCofThisEvent* hitCollection);
   G4bool ProcessHits_user(const G4Step* step, G4TouchableHistory* history);
 
+  // Choose between a hit for every photon or one for each tree
+  void setPhotonHitRecording(G4bool recordPhotonHits);
+  G4bool getPhotonHitRecording() const;
+
  private:
   LeafTrackerHitsCollection* m_hitsCollection;
+  G4int m_hitsCollectionID;
+  G4bool m_recordPhotonHits;
+
+  // Summed hit of each tree in the current event, by tree number
+  std::vector<LeafTrackerHit*> m_treeHits;
 };
 
 #endif  // LEAF_TRACKER_SD_HPP
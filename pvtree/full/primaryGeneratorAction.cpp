@@ -1,28 +1,74 @@
 #include "pvtree/full/primaryGeneratorAction.hpp"
 #include "pvtree/full/weightedParticleGun.hpp"
+#include "pvtree/full/treeEnvelope.hpp"
 
 #include "G4Event.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
 
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
 #include "G4Orb.hh"
+#include "G4LogicalSkinSurface.hh"
+#include "G4OpticalSurface.hh"
+#include "G4MaterialPropertiesTable.hh"
 
 //#include "TRandom.h"
 #include "Randomize.hh"
 #include "pvtree/full/solarSimulation/sun.hpp"
-#include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
-#include "TF2.h"
+#include "pvtree/full/solarSimulation/skyStatePrefetcher.hpp"
+#include "pvtree/full/solarSimulation/skySampler.hpp"
 #include "TH1D.h"
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+// Groups of low discrepancy dimensions used for each decision
+enum QuasiRandomGroup {
+  kSourceGroup,        // sun or sky
+  kSunGroup,           // position, polarisation and envelope face
+  kSkyDirectionGroup,  // channel, cell and position within the cell
+  kSkyTargetGroup      // position, polarisation and envelope face
+};
+}
 
 PrimaryGeneratorAction::PrimaryGeneratorAction(unsigned int photonNumber,
                                                Sun* sun)
     : G4VUserPrimaryGeneratorAction(),
       m_photonNumber(photonNumber),
-      m_sun(sun) {
+      m_sun(sun),
+      m_skyStatePrefetcher(0),
+      m_eventsPerTimeSegment(0),
+      m_useQuasiRandom(false),
+      m_aimAtTrees(false),
+      m_reportedReflectiveFloor(false),
+      m_useEnvelope(false),
+      m_envelopeRunID(-1) {
+  initializeParticleGun();
+}
+
+PrimaryGeneratorAction::PrimaryGeneratorAction(
+    unsigned int photonNumber, SkyStatePrefetcher* skyStatePrefetcher)
+    : G4VUserPrimaryGeneratorAction(),
+      m_photonNumber(photonNumber),
+      m_sun(0),
+      m_skyStatePrefetcher(skyStatePrefetcher),
+      m_eventsPerTimeSegment(0),
+      m_useQuasiRandom(false),
+      m_aimAtTrees(false),
+      m_reportedReflectiveFloor(false),
+      m_useEnvelope(false),
+      m_envelopeRunID(-1) {
+  initializeParticleGun();
+}
+
+void PrimaryGeneratorAction::initializeParticleGun() {
   m_particleGun = new WeightedParticleGun();
 
   // default particle kinematic
@@ -40,17 +86,41 @@ void PrimaryGeneratorAction::SetPhotonNumber(unsigned int photonNumber) {
   m_photonNumber = photonNumber;
 }
 
+void PrimaryGeneratorAction::SetQuasiRandomSampling(bool useQuasiRandom) {
+  m_useQuasiRandom = useQuasiRandom;
+}
+
+void PrimaryGeneratorAction::SetEventsPerTimeSegment(
+    unsigned int eventNumber) {
+  if (eventNumber > 0 && m_skyStatePrefetcher == 0) {
+    throw std::invalid_argument(
+        "Stepping through a day needs prepared sky states.");
+  }
+
+  m_eventsPerTimeSegment = eventNumber;
+}
+
+void PrimaryGeneratorAction::SetTreeEnvelopeSampling(bool aimAtTrees) {
+  m_aimAtTrees = aimAtTrees;
+}
+
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
   //  TRandom rnd;
   //  double ret_x, ret_y;
-  // Now need to translate the start position based upon the current unit light
-  // vector of the sun
-  TVector3 currentLightVector = m_sun->getLightVector();
+  // Either use the prepared sky state or evaluate the sun now
+  std::shared_ptr<const SkyState> skyState;
+  if (m_eventsPerTimeSegment > 0) {
+    skyState = m_skyStatePrefetcher->getSelectedSkyState(
+        event->GetEventID() / m_eventsPerTimeSegment);
+  } else if (m_skyStatePrefetcher) {
+    skyState = m_skyStatePrefetcher->getSelectedSkyState();
+  } else {
+    skyState = m_sun->getSkyState();
+  }
 
-  // Define a tangent surface in which the
-  TVector3 orthogonalVector1 = currentLightVector.Orthogonal().Unit();
-  TVector3 orthogonalVector2 =
-      currentLightVector.Cross(orthogonalVector1).Unit();
+  // The light vector, tangent surface, spectrum integrals and sky sampler
+  // are all prepared once per sky state.
+  TVector3 currentLightVector = skyState->lightVector;
 
   // In order to avoid dependence of PrimaryGeneratorAction
   // on DetectorConstruction class we get world volume
@@ -68,77 +138,80 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
         worldSurfaceRadius *
         (1.0 / std::sqrt(3.0) / 10.1 * 0.75);  // fit to size
 
-    double solar_rad =
-        m_sun->getElevationAngle();  // [rad], counts from horizon
-    //    double solar_zenith = pi/2.0 - solar_rad;
-    double solar_azimuth = m_sun->getAzimuthalAngle();  // [rad], counts from
-                                                        // north=0 to
-                                                        // west=270degr
-
-    auto normalIrradianceHistogram =
-        m_sun->getSpectrum()->getHistogram("Direct_normal_irradiance");
-    auto diffuseIrradianceHistogram =
-        m_sun->getSpectrum()->getHistogram("Difuse_horizn_irradiance");
-    auto normalExtraterrIrrHistogram =
-        m_sun->getSpectrum()->getHistogram("Extraterrestrial_spectrm");
-    double totalNormal = normalIrradianceHistogram->Integral("width");
-    double totalDiffuse = diffuseIrradianceHistogram->Integral("width");
-    double totalextraterr = normalExtraterrIrrHistogram->Integral("width");
-
-    // Perez brightness
-    double bright = 1.5 * totalDiffuse / totalextraterr;  // 1.5 air mass
-
-    if (bright < 0.1)
-      bright = 0.1;  // limit to minimum 10% diffuse light or 5deg sun disc size
-    if (bright > 1.0) bright = 1.0;  //
-
-    double turb =
-        1.0 / (1.1 - bright);  // experimental link to Perez bright parameter
-    if (turb > 10.0) turb = 10.0;
-    if (turb < 1.0) turb = 1.0;
-
-    double albedo = m_sun->getAlbedo(); // Albedo set from climate data
-    if (albedo < 0.0) albedo = 0.0;
-    if (albedo > 1.0) albedo = 1.0;
-
-    SkyFunction* sf = new SkyFunction(solar_rad, turb, albedo);
-    TF2* fsky = new TF2("myf", sf, &SkyFunction::Eval, 0.0, pi / 2.0, 0.0,
-                        2.0 * pi, 0, "SkyFunction", "Eval");
-    //    std::cout << "fsky calling Eval(0.1,0.1) " << fsky->Eval(0.1,0.1) <<
-    //    std::endl;
-    //    std::cout << "fsky calling Integral " <<
-    //    fsky->Integral(0.0,pi/2.0,0.0,2.0*pi) << std::endl;
-    fsky->Integral(0.0, pi / 2.0, 0.0,
-                   2.0 * pi);  // activate function, ROOT issue
-
-    // from Perez clearness parameter
-    G4double ratio =
-        1.0 + totalNormal / totalDiffuse;  // =1+normal/diffuse irradiance
-    //     std::cout << "Climate conditions for Hosek: Normal/Diffuse = " <<
-    //     totalNormal / totalDiffuse << std::endl;
-    //     std::cout << "Climate conditions for Hosek: Diffuse/Extraterr = " <<
-    //     totalDiffuse / totalextraterr << std::endl;
-    //     std::cout << "Hosek: brightness = " << bright << std::endl;
-    //     std::cout << "Hosek: turbidity  = " << turb << std::endl;
-    //     std::cout << "Hosek: albedo     = " << albedo << std::endl;
-    //    std::cout << "Hosek: Sun at elevation = " << solar_rad*180.0/pi <<
-    //    std::endl;
-    //    std::cout << "Hosek: Sun at azimuth   = " << solar_azimuth*180.0/pi <<
-    //    std::endl;
-
-    std::vector<std::tuple<double, double> > photonEnergies =
-        m_sun->getSpectrum()->generatePhotons(m_photonNumber);
+    double solar_azimuth = skyState->azimuthalAngle;  // [rad], counts from
+                                                      // north=0 to
+                                                      // west=270degr
+
+    double totalNormal = skyState->totalNormalIrradiance;
+    double totalDiffuse = skyState->totalDiffuseIrradiance;
+
+    // No light reaches the ground, so there is nothing to generate
+    if (totalNormal <= 0.0 && totalDiffuse <= 0.0) return;
 
     double photonWeight = 0.0;
     double photonEnergy = 0.0;
     double theta = 0.0;  // angles in radians on sky sphere
     double gamma =
         0.0;  // with theta=0 at zenith, gamma=0 at sun position azimuth
-    double probability = 1.0 / ratio;
+    double probability = skyState->skyPhotonFraction;
     TVector3 candidatePoint(0, 0, 0);  // for location
+
+    // Only photons which can reach the trees need to be tracked, so aim
+    // at the box around them where it is smaller than the source disk.
+    // Light reflected by the floor can also reach the trees, and the floor
+    // spans the whole disk, so the full disk is kept unless it absorbs.
+    double sourceDiskArea = pi * std::pow(generationRadius, 2.0);
+    bool useEnvelope = useTreeEnvelope(worldLV);
+    double sourceArea = sourceDiskArea;
+
+    // A new randomisation of the low discrepancy points for each event
+    if (m_useQuasiRandom) {
+      m_sobolSequence.setSeed(
+          (std::uint32_t)(G4UniformRand() * 4294967296.0));
+    }
+
+    // Choose the source of every photon first, so that the energies can
+    // be drawn from the matching irradiance.
+    m_photonsFromSun.resize(m_photonNumber);
+    unsigned int sunPhotonNumber = 0;
+    for (unsigned int particleNumber = 0; particleNumber < m_photonNumber;
+         particleNumber++) {
+      m_photonsFromSun[particleNumber] =
+          uniformRandom(particleNumber, 0, kSourceGroup) >= probability;
+      if (m_photonsFromSun[particleNumber]) sunPhotonNumber++;
+    }
+
+    // Sun photons first in the buffer, followed by the sky photons
+    m_photonEnergies.resize(m_photonNumber);
+    if (sunPhotonNumber > 0) {
+      skyState->spectrum->generatePhotonEnergies(m_photonEnergies.data(),
+                                                 sunPhotonNumber);
+    }
+    if (sunPhotonNumber < m_photonNumber) {
+      skyState->spectrum->generatePhotonEnergies(
+          m_photonEnergies.data() + sunPhotonNumber,
+          m_photonNumber - sunPhotonNumber,
+          Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE);
+    }
+    unsigned int sunPhotonIndex = 0;
+    unsigned int skyPhotonIndex = sunPhotonNumber;
+    unsigned int polarisationIndex = 0;
+    unsigned int polarisationGroup = kSunGroup;
+
+    unsigned int primaryNumber = 0;
+
+    m_photonPositions.resize(m_photonNumber);
+    m_photonDirections.resize(m_photonNumber);
+    m_photonPolarisations.resize(m_photonNumber);
+    m_photonKineticEnergies.resize(m_photonNumber);
+    m_photonWeights.resize(m_photonNumber);
+
     for (unsigned int particleNumber = 0; particleNumber < m_photonNumber;
          particleNumber++) {
-      if (G4UniformRand() >= probability) {  // from the sun disk or ...
+      if (m_photonsFromSun[particleNumber]) {  // from the sun disk or ...
+        polarisationIndex = sunPhotonIndex;
+        polarisationGroup = kSunGroup;
+        photonEnergy = m_photonEnergies[sunPhotonIndex++];
         // 	theta = x + solar_zenith; // solar zenith since TVector3 counts
         // theta from zenith
         // 	gamma = y + solar_azimuth; // symmetric around solar azimuth
@@ -146,24 +219,86 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
         // photons are
         // being generated.
         // Gives units of [Watt] since integral arrives as [W/m^2]
-        currentLightVector = m_sun->getLightVector();
-        candidatePoint = directSun(generationRadius, orthogonalVector1,
-                                   orthogonalVector2, currentLightVector);
+        currentLightVector = skyState->lightVector;
+        sourceArea = useEnvelope ? projectedEnvelopeArea(currentLightVector)
+                                 : sourceDiskArea;
+
+        if (sourceArea < sourceDiskArea) {
+          // Start from the source disk plane, dropping any photon outside
+          // the disk so that the same light reaches the trees
+          TVector3 point =
+              envelopePoint(currentLightVector, polarisationIndex, kSunGroup);
+          point -= point.Dot(currentLightVector) * currentLightVector;
+          if (point.Mag() > generationRadius) continue;
+
+          candidatePoint = point - 1.5 * generationRadius * currentLightVector;
+        } else {
+          sourceArea = sourceDiskArea;
+          candidatePoint = directSun(
+              generationRadius, skyState->orthogonalVector1,
+              skyState->orthogonalVector2, currentLightVector,
+              targetPoint(generationRadius, polarisationIndex, kSunGroup));
+        }
         photonWeight = totalNormal / (m_photonNumber * (1.0 - probability));
-        photonWeight *=
-            pi * std::pow(generationRadius / CLHEP::meter,
-                          2.0);  // area of normal irradiation source
+        // area of normal irradiation source
+        photonWeight *= sourceArea / std::pow(CLHEP::meter, 2.0);
       } else {                   // ... from the sky function
-        // Generate point in sky to be 'source' of indirect light
-        fsky->GetRandom2(theta,
-                         gamma);  // theta, gamma random coordinates on sky
+        // Generate direction in sky to be 'source' of indirect light
+        // theta, gamma random coordinates on sky, following the radiance at
+        // the photon wavelength
+        polarisationIndex = skyPhotonIndex - sunPhotonNumber;
+        polarisationGroup = kSkyTargetGroup;
+        photonEnergy = m_photonEnergies[skyPhotonIndex++];
+        double wavelength =
+            CLHEP::h_Planck * CLHEP::c_light / (photonEnergy * eV) / nm;
+
+        if (m_useQuasiRandom) {
+          double randoms[SobolSequence::dimensionNumber];
+          for (unsigned int d = 0; d < SobolSequence::dimensionNumber; d++) {
+            randoms[d] = m_sobolSequence.sample(polarisationIndex, d,
+                                                kSkyDirectionGroup);
+          }
+          skyState->skySampler->generateDirection(wavelength, randoms, theta,
+                                                  gamma);
+        } else {
+          skyState->skySampler->generateDirection(wavelength, theta, gamma);
+        }
         gamma += solar_azimuth - pi / 2.0;  // offset for sun position, TVector3
                                             // out of phi phase by 90deg
-        candidatePoint.SetMagThetaPhi(worldSurfaceRadius, theta, gamma);
-        // Generate random point on world surface (roughly near the trees)
-        // to be target of indirect light.
-        TVector3 target = targetPoint(generationRadius);
-        currentLightVector = target - candidatePoint;
+        TVector3 skyDirection;
+        skyDirection.SetMagThetaPhi(1.0, theta, gamma);
+
+        // Area of the envelope shadow on the ground
+        sourceArea = sourceDiskArea;
+        if (useEnvelope && skyDirection.Z() > 0.0) {
+          sourceArea = std::min(
+              projectedEnvelopeArea(skyDirection) / skyDirection.Z(),
+              sourceDiskArea);
+        }
+
+        // Generate random point on the ground (roughly near the trees) to be
+        // target of indirect light.
+        TVector3 target;
+        if (sourceArea < sourceDiskArea) {
+          // Follow the ray back to the ground, dropping any photon which
+          // would not have been aimed within the target disk
+          TVector3 point = envelopePoint(-skyDirection, polarisationIndex,
+                                         kSkyTargetGroup);
+          target = point - (point.Z() / skyDirection.Z()) * skyDirection;
+          if (target.Mag() > generationRadius) continue;
+        } else {
+          target =
+              targetPoint(generationRadius, polarisationIndex, kSkyTargetGroup);
+        }
+
+        // The sky is distant, so its light arrives at every target from the
+        // same direction. Start on the world surface above the target.
+        double alongSky = target.Dot(skyDirection);
+        double distance =
+            -alongSky + std::sqrt(std::pow(alongSky, 2.0) - target.Mag2() +
+                                  std::pow(worldSurfaceRadius, 2.0));
+        candidatePoint = target + distance * skyDirection;
+        currentLightVector = -skyDirection;
         // Weight also needs to take into account the surface area over which
         // photons are
         // being generated.
@@ -172,29 +307,32 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
         photonWeight *=
             std::pow(0.75 * generationRadius / CLHEP::meter,
                      2.0);  // horizontal area of receiving structure 
+        photonWeight *= sourceArea / sourceDiskArea;
       }
 
       // Set the direction of the photon - point to centre, not to sky
-      m_particleGun->SetParticleMomentumDirection(
+      m_photonDirections[primaryNumber] =
           G4ThreeVector(currentLightVector.X(), currentLightVector.Y(),
-                        currentLightVector.Z()));
+                        currentLightVector.Z()).unit();
 
-      m_particleGun->SetParticlePosition(G4ThreeVector(
-          candidatePoint.X(), candidatePoint.Y(), candidatePoint.Z()));
+      m_photonPositions[primaryNumber] = G4ThreeVector(
+          candidatePoint.X(), candidatePoint.Y(), candidatePoint.Z());
 
       // Set the polarisation of the photon
-      setRandomPhotonPolarisation();
-
-      photonEnergy = std::get<0>(photonEnergies[particleNumber]);
-      //      photonWeight =
-      //      std::get<1>(photonEnergies[particleNumber])/m_photonNumber;
+      m_photonPolarisations[primaryNumber] = randomPhotonPolarisation(
+          m_photonDirections[primaryNumber],
+          uniformRandom(polarisationIndex, 2, polarisationGroup));
 
-      m_particleGun->SetParticleEnergy(photonEnergy * eV);
-      m_particleGun->GenerateWeightedPrimaryVertex(event, photonWeight);
+      m_photonKineticEnergies[primaryNumber] = photonEnergy * eV;
+      m_photonWeights[primaryNumber] = photonWeight;
+      primaryNumber++;
     }
 
-    fsky->Delete();
-    delete sf;
+    // Add all the photons to the event together
+    m_particleGun->GenerateWeightedPrimaryVertices(
+        event, primaryNumber, m_photonPositions.data(),
+        m_photonDirections.data(), m_photonKineticEnergies.data(),
+        m_photonPolarisations.data(), m_photonWeights.data());
   } else {
     G4cerr << "Orb world volume not found." << G4endl;
     G4cerr << "Perhaps you have changed geometry." << G4endl;
@@ -208,11 +346,11 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event) {
   }
 }
 
-void PrimaryGeneratorAction::setRandomPhotonPolarisation() {
-  G4double angle = G4UniformRand() * 360.0 * deg;
+G4ThreeVector PrimaryGeneratorAction::randomPhotonPolarisation(
+    const G4ThreeVector& kphoton, double random) {
+  G4double angle = random * 360.0 * deg;
 
   G4ThreeVector normal(1.0, 0.0, 0.0);
-  G4ThreeVector kphoton = m_particleGun->GetParticleMomentumDirection();
   G4ThreeVector product = normal.cross(kphoton);
   G4double modul2 = product * product;
 
@@ -220,15 +358,12 @@ void PrimaryGeneratorAction::setRandomPhotonPolarisation() {
   if (modul2 > 0.) e_perpend = (1. / std::sqrt(modul2)) * product;
   G4ThreeVector e_paralle = e_perpend.cross(kphoton);
 
-  G4ThreeVector polar =
-      std::cos(angle) * e_paralle + std::sin(angle) * e_perpend;
-
-  m_particleGun->SetParticlePolarization(polar);
+  return std::cos(angle) * e_paralle + std::sin(angle) * e_perpend;
 }
 
 TVector3 PrimaryGeneratorAction::directSun(double genrad, TVector3 v1,
-                                           TVector3 v2, TVector3 lv) {
-  TVector3 point = targetPoint(genrad);
+                                           TVector3 v2, TVector3 lv,
+                                           TVector3 point) {
   TVector3 candidatePoint =
       TVector3(v1) * point[0] + TVector3(v2) * point[1];
 
@@ -239,7 +374,16 @@ TVector3 PrimaryGeneratorAction::directSun(double genrad, TVector3 v1,
   return candidatePoint;
 }
 
-TVector3 PrimaryGeneratorAction::targetPoint(double genrad){
+TVector3 PrimaryGeneratorAction::targetPoint(double genrad, unsigned int index,
+                                             unsigned int group) {
+  if (m_useQuasiRandom) {
+    // Map the unit square onto the disk, keeping the stratification which
+    // rejecting points would spoil
+    double radius = genrad * std::sqrt(m_sobolSequence.sample(index, 0, group));
+    double angle = 2.0 * acos(-1.0) * m_sobolSequence.sample(index, 1, group);
+    return TVector3(radius * std::cos(angle), radius * std::sin(angle), 0.0);
+  }
+
   G4double candidateX = 0.0, candidateY = 0.0;
   bool acceptablePoint = false;
 
@@ -258,3 +402,109 @@ TVector3 PrimaryGeneratorAction::targetPoint(double genrad){
   }
   return TVector3(candidateX, candidateY, 0.0);
 }
+
+bool PrimaryGeneratorAction::useTreeEnvelope(G4LogicalVolume* worldLV) {
+  if (!m_aimAtTrees) return false;
+
+  // The geometry may be rebuilt between runs
+  G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+  if (runID != m_envelopeRunID) {
+    m_useEnvelope = !isFloorReflective(worldLV) && findTreeEnvelope(worldLV);
+    m_envelopeRunID = runID;
+  }
+
+  return m_useEnvelope;
+}
+
+bool PrimaryGeneratorAction::isFloorReflective(G4LogicalVolume* worldLV) {
+  bool reflective = false;
+
+  for (G4int d = 0; d < worldLV->GetNoDaughters() && !reflective; d++) {
+    G4LogicalVolume* daughterLV = worldLV->GetDaughter(d)->GetLogicalVolume();
+    if (daughterLV->GetName().find("Floor") != 0) continue;
+
+    // Without an absorbing surface the floor reflects at least by refraction
+    G4LogicalSkinSurface* skinSurface =
+        G4LogicalSkinSurface::GetSurface(daughterLV);
+    G4OpticalSurface* opticalSurface =
+        skinSurface ? dynamic_cast<G4OpticalSurface*>(
+                          skinSurface->GetSurfaceProperty())
+                    : 0;
+    G4MaterialPropertiesTable* properties =
+        opticalSurface ? opticalSurface->GetMaterialPropertiesTable() : 0;
+    G4MaterialPropertyVector* reflectivity =
+        properties ? properties->GetProperty("REFLECTIVITY") : 0;
+
+    reflective = !reflectivity || reflectivity->GetMaxValue() > 0.0;
+  }
+
+  if (reflective && !m_reportedReflectiveFloor) {
+    G4cout << "The floor reflects light so photons are not aimed at the "
+           << "trees." << G4endl;
+    m_reportedReflectiveFloor = true;
+  }
+
+  return reflective;
+}
+
+bool PrimaryGeneratorAction::findTreeEnvelope(G4LogicalVolume* worldLV) {
+  if (!m_treeEnvelope.update(worldLV)) return false;
+
+  const G4ThreeVector& minimum = m_treeEnvelope.getMinimum();
+  const G4ThreeVector& maximum = m_treeEnvelope.getMaximum();
+  m_envelopeMinimum.SetXYZ(minimum.x(), minimum.y(), minimum.z());
+  m_envelopeMaximum.SetXYZ(maximum.x(), maximum.y(), maximum.z());
+
+  return true;
+}
+
+double PrimaryGeneratorAction::projectedEnvelopeArea(
+    const TVector3& direction) const {
+  TVector3 extent = m_envelopeMaximum - m_envelopeMinimum;
+
+  return extent.Y() * extent.Z() * std::fabs(direction.X()) +
+         extent.X() * extent.Z() * std::fabs(direction.Y()) +
+         extent.X() * extent.Y() * std::fabs(direction.Z());
+}
+
+TVector3 PrimaryGeneratorAction::envelopePoint(const TVector3& direction,
+                                               unsigned int index,
+                                               unsigned int group) {
+  TVector3 extent = m_envelopeMaximum - m_envelopeMinimum;
+
+  // The faces facing the light cover the projection without overlapping,
+  // so choose one in proportion to its projected area.
+  double faceAreas[3] = {extent.Y() * extent.Z() * std::fabs(direction.X()),
+                         extent.X() * extent.Z() * std::fabs(direction.Y()),
+                         extent.X() * extent.Y() * std::fabs(direction.Z())};
+  double faceChoice = uniformRandom(index, 3, group) *
+                      (faceAreas[0] + faceAreas[1] + faceAreas[2]);
+
+  unsigned int axis = 0;
+  while (axis < 2 && faceChoice >= faceAreas[axis]) {
+    faceChoice -= faceAreas[axis];
+    axis++;
+  }
+
+  // Uniformly across the face where the light enters
+  unsigned int axis1 = (axis + 1) % 3;
+  unsigned int axis2 = (axis + 2) % 3;
+  TVector3 point;
+  point[axis] = direction[axis] > 0.0 ? m_envelopeMinimum[axis]
+                                      : m_envelopeMaximum[axis];
+  point[axis1] = m_envelopeMinimum[axis1] +
+                 uniformRandom(index, 0, group) * extent[axis1];
+  point[axis2] = m_envelopeMinimum[axis2] +
+                 uniformRandom(index, 1, group) * extent[axis2];
+
+  return point;
+}
+
+double PrimaryGeneratorAction::uniformRandom(unsigned int index,
+                                             unsigned int dimension,
+                                             unsigned int group) {
+  if (m_useQuasiRandom) {
+    return m_sobolSequence.sample(index, dimension, group);
+  }
+  return G4UniformRand();
+}
@@ -10,15 +10,31 @@
  */
 
 #include "G4VUserPrimaryGeneratorAction.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
 #include "TVector3.h"
+#include "pvtree/full/solarSimulation/sobolSequence.hpp"
+#include "pvtree/full/treeEnvelope.hpp"
+
+#include <vector>
+#include <memory>
 
 class G4Event;
 class WeightedParticleGun;
 class Sun;
+class SkyStatePrefetcher;
+class G4LogicalVolume;
 
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
  public:
   PrimaryGeneratorAction(unsigned int photonNumber, Sun* sun);
+
+  /*! \brief Generate photons using sky states prepared in advance.
+   *
+   * Each event uses the sky state currently selected in the prefetcher.
+   */
+  PrimaryGeneratorAction(unsigned int photonNumber,
+                         SkyStatePrefetcher* skyStatePrefetcher);
   virtual ~PrimaryGeneratorAction();
 
   /*! \brief Called at the start of event generation. Initial vertices
@@ -32,10 +48,75 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
    */
   void SetPhotonNumber(unsigned int photonNumber);
 
+  /*! \brief Use Owen scrambled Sobol points rather than pseudo-random
+   *         numbers to choose the photon sources, start positions, sky
+   *         directions and polarisations.
+   *
+   * The points are randomised again for every event, so the energy
+   * estimates remain unbiased but converge faster with the photon number.
+   * The photon energies are still pseudo-random.
+   */
+  void SetQuasiRandomSampling(bool useQuasiRandom);
+
+  /*! \brief Step through the time segments of the day selected in the
+   *         prefetcher, rather than using the selected sky state.
+   *
+   * Event n of a run uses time segment n / eventNumber, so a single run
+   * can cover a whole day.
+   *
+   * @param[in] eventNumber The number of events for each time segment.
+   *                        Zero uses the selected sky state for every
+   *                        event, which is the default.
+   */
+  void SetEventsPerTimeSegment(unsigned int eventNumber);
+
+  /*! \brief Aim the photons at the box enclosing the trees, rather than
+   *         across the whole source disk, wherever the box appears
+   *         smaller. Disabled by default.
+   *
+   * The weights are scaled by the projected area of the box and any
+   * photon which the source disk would not have produced is dropped.
+   * Photons missing the box can still reach the trees after reflecting
+   * from the floor, which covers the whole disk, so the photons are only
+   * aimed when the floor surface absorbs all the light. Only then are the
+   * expected energies unchanged; otherwise the whole disk is used.
+   */
+  void SetTreeEnvelopeSampling(bool aimAtTrees);
+
  private:
   unsigned int m_photonNumber;
   WeightedParticleGun* m_particleGun;
   Sun* m_sun;
+  SkyStatePrefetcher* m_skyStatePrefetcher;
+  unsigned int m_eventsPerTimeSegment;
+
+  //! Reused buffers for the sampled photon energies [eV] and sources
+  std::vector<double> m_photonEnergies;
+  std::vector<bool> m_photonsFromSun;
+
+  //! Reused buffers of the primaries passed to the gun in one batch
+  std::vector<G4ThreeVector> m_photonPositions;
+  std::vector<G4ThreeVector> m_photonDirections;
+  std::vector<G4ThreeVector> m_photonPolarisations;
+  std::vector<double> m_photonKineticEnergies;
+  std::vector<double> m_photonWeights;
+
+  //! Low discrepancy points, used in place of G4UniformRand when enabled
+  bool m_useQuasiRandom;
+  SobolSequence m_sobolSequence;
+
+  //! Corners of the box enclosing all the trees above the floor
+  bool m_aimAtTrees;
+  bool m_reportedReflectiveFloor;
+  bool m_useEnvelope;
+  G4int m_envelopeRunID;
+  TreeEnvelope m_treeEnvelope;
+  TVector3 m_envelopeMinimum;
+  TVector3 m_envelopeMaximum;
+
+  /*! \brief Prepare the particle gun with default kinematics.
+   */
+  void initializeParticleGun();
 
   /*! \brief Assume photons should be generated with a random
    *         polarisation. This is the default but if it is
@@ -46,17 +127,62 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
    * and it is consistant with the implementation in : -
    * source/event/src/G4PrimaryTransformer.cc
    *
+   * @param[in] kphoton Unit momentum direction of the photon.
+   * @param[in] random Uniform number in [0,1) choosing the angle.
+   *
+   * \returns The polarisation vector.
    */
-  void setRandomPhotonPolarisation();
+  G4ThreeVector randomPhotonPolarisation(const G4ThreeVector& kphoton,
+                                         double random);
 
   /*! \brief source geometry as disk of world radius/sqrt(3)
+   *
+   * @param[in] point Position on the disk, as from targetPoint.
    */
-  TVector3 directSun(double genrad, TVector3 v1, TVector3 v2, TVector3 lv);
+  TVector3 directSun(double genrad, TVector3 v1, TVector3 v2, TVector3 lv,
+                     TVector3 point);
 
   /*! \brief Randomly generate a point on the world surface within 
    *         genrad distance of the origin.
+   *
+   * @param[in] index Photon index within the low discrepancy group.
+   * @param[in] group Low discrepancy dimensions to use.
+   */
+  TVector3 targetPoint(double genrad, unsigned int index, unsigned int group);
+
+  /*! \brief Check if the photons can be aimed at the trees, checking
+   *         the floor and finding the tree envelope again for each new run.
+   */
+  bool useTreeEnvelope(G4LogicalVolume* worldLV);
+
+  /*! \brief Check if light can be reflected by the floor of the world.
+   *
+   * The floor is any world daughter whose name starts with "Floor". It is
+   * taken to reflect unless its skin surface has a zero reflectivity.
+   */
+  bool isFloorReflective(G4LogicalVolume* worldLV);
+
+  /*! \brief Find the box enclosing the placed trees, above the floor.
+   *
+   * \returns False if the world does not contain any trees.
+   */
+  bool findTreeEnvelope(G4LogicalVolume* worldLV);
+
+  /*! \brief Get the area of the tree envelope seen along a direction.
+   */
+  double projectedEnvelopeArea(const TVector3& direction) const;
+
+  /*! \brief Choose a point where light travelling in a direction enters
+   *         the tree envelope, uniformly over its projected area.
+   */
+  TVector3 envelopePoint(const TVector3& direction, unsigned int index,
+                         unsigned int group);
+
+  /*! \brief Get a uniform number in [0,1), either pseudo-random or a
+   *         coordinate of the low discrepancy point for the photon.
    */
-  TVector3 targetPoint(double genrad);
+  double uniformRandom(unsigned int index, unsigned int dimension,
+                       unsigned int group);
 };
 
 #endif  // PV_FULL_PRIMARY_GENERATOR_ACTION_HPP
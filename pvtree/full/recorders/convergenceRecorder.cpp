@@ -1,19 +1,26 @@
 #include "pvtree/full/recorders/convergenceRecorder.hpp"
+#include "pvtree/full/recorders/runStatistics.hpp"
 #include "pvtree/full/leafTrackerHit.hpp"
 #include "G4Run.hh"
 #include "G4Event.hh"
 #include "G4SystemOfUnits.hh"
 
 ConvergenceRecorder::ConvergenceRecorder()
-    : RecorderBase(), m_eventAborted(false) {}
+    : RecorderBase(),
+      m_eventAborted(false),
+      m_eventsPerTimeSegment(0u),
+      m_firstEntry(0u) {}
 
 ConvergenceRecorder::~ConvergenceRecorder() {}
 
 void ConvergenceRecorder::recordBeginOfRun(const G4Run* /*run*/) {
-  // Extend results array for this new run
-  m_photons.push_back(std::vector<long>());
-  m_hits.push_back(std::vector<long>());
-  m_summedHitEnergies.push_back(std::vector<double>());
+  m_firstEntry = m_summedHitEnergies.size();
+
+  // Extend results array for this new run, unless the entries for
+  // each time segment are added as their events arrive.
+  if (m_eventsPerTimeSegment == 0) {
+    extendEntries(m_firstEntry + 1);
+  }
 
   m_eventAborted = false;
 }
@@ -23,7 +30,7 @@ void ConvergenceRecorder::recordEndOfRun(const G4Run* /*run*/) {}
 void ConvergenceRecorder::recordBeginOfEvent(const G4Event* event) {
   // Store total number of photons being generated
   G4int numberOfPhotons = event->GetNumberOfPrimaryVertex();
-  m_photons.back().push_back(numberOfPhotons);
+  m_photons[getEntry(event)].push_back(numberOfPhotons);
 }
 
 void ConvergenceRecorder::recordEndOfEvent(const G4Event* event) {
@@ -32,20 +39,85 @@ void ConvergenceRecorder::recordEndOfEvent(const G4Event* event) {
     m_eventAborted = true;
   }
 
-  // Store the total number of hits
+  // Store the total number of detected photons and the energy they
+  // deposited, which hits may hold for more than one photon
   G4VHitsCollection* hitCollection = event->GetHCofThisEvent()->GetHC(0);
-  m_hits.back().push_back(hitCollection->GetSize());
-
-  // Store the total energy deposited in hits
+  long hitNumber = 0;
   double energyDeposited = 0.0;
   for (unsigned int h = 0; h < hitCollection->GetSize(); h++) {
     LeafTrackerHit* hit =
         static_cast<LeafTrackerHit*>(hitCollection->GetHit(h));
+    hitNumber += hit->getPhotonNumber();
     energyDeposited += hit->getEnergyDeposited();
   }
 
+  unsigned int entry = getEntry(event);
+  m_hits[entry].push_back(hitNumber);
+
   // The units of energy deposited is [W]
-  m_summedHitEnergies.back().push_back(energyDeposited);
+  m_summedHitEnergies[entry].push_back(energyDeposited);
+}
+
+void ConvergenceRecorder::setEventsPerTimeSegment(unsigned int eventNumber) {
+  m_eventsPerTimeSegment = eventNumber;
+}
+
+unsigned int ConvergenceRecorder::getEntry(const G4Event* event) {
+  unsigned int entry = m_firstEntry;
+  if (m_eventsPerTimeSegment > 0) {
+    entry += event->GetEventID() / m_eventsPerTimeSegment;
+  }
+
+  extendEntries(entry + 1);
+  return entry;
+}
+
+void ConvergenceRecorder::extendEntries(unsigned int entryNumber) {
+  if (m_summedHitEnergies.size() < entryNumber) {
+    m_photons.resize(entryNumber);
+    m_hits.resize(entryNumber);
+    m_summedHitEnergies.resize(entryNumber);
+  }
+}
+
+RecorderBase* ConvergenceRecorder::createWorkerRecorder() const {
+  ConvergenceRecorder* workerRecorder = new ConvergenceRecorder();
+  workerRecorder->setEventsPerTimeSegment(m_eventsPerTimeSegment);
+
+  return workerRecorder;
+}
+
+void ConvergenceRecorder::mergeWorkerRun(
+    const RecorderBase* workerRecorder) {
+  const ConvergenceRecorder* worker =
+      dynamic_cast<const ConvergenceRecorder*>(workerRecorder);
+
+  if (worker == 0) {
+    return;
+  }
+
+  // Add each entry of the worker's run to the matching entry of this run
+  for (unsigned int workerEntry = worker->m_firstEntry;
+       workerEntry < worker->m_summedHitEnergies.size(); workerEntry++) {
+    unsigned int entry = m_firstEntry + (workerEntry - worker->m_firstEntry);
+    extendEntries(entry + 1);
+
+    const auto& workerPhotons = worker->m_photons[workerEntry];
+    const auto& workerHits = worker->m_hits[workerEntry];
+    const auto& workerEnergies = worker->m_summedHitEnergies[workerEntry];
+
+    m_photons[entry].insert(m_photons[entry].end(), workerPhotons.begin(),
+                            workerPhotons.end());
+    m_hits[entry].insert(m_hits[entry].end(), workerHits.begin(),
+                         workerHits.end());
+    m_summedHitEnergies[entry].insert(m_summedHitEnergies[entry].end(),
+                                      workerEnergies.begin(),
+                                      workerEnergies.end());
+  }
+
+  if (worker->m_eventAborted) {
+    m_eventAborted = true;
+  }
 }
 
 void ConvergenceRecorder::reset() {
@@ -53,6 +125,7 @@ void ConvergenceRecorder::reset() {
   m_hits.clear();
   m_summedHitEnergies.clear();
   m_eventAborted = false;
+  m_firstEntry = 0u;
 }
 
 std::vector<std::vector<long> > ConvergenceRecorder::getPhotonCounts() {
@@ -68,3 +141,31 @@ std::vector<std::vector<double> > ConvergenceRecorder::getSummedHitEnergies() {
 }
 
 bool ConvergenceRecorder::wasAborted() { return m_eventAborted; }
+
+unsigned int ConvergenceRecorder::getRunNumber() const {
+  return m_summedHitEnergies.size();
+}
+
+std::vector<double> ConvergenceRecorder::getMeanHitEnergies() const {
+  std::vector<double> meanHitEnergies;
+
+  for (const auto& runEnergies : m_summedHitEnergies) {
+    double meanEnergy = 0.0;
+    for (double energy : runEnergies) {
+      meanEnergy += energy / runEnergies.size();
+    }
+    meanHitEnergies.push_back(meanEnergy);
+  }
+
+  return meanHitEnergies;
+}
+
+double ConvergenceRecorder::getRelativeStandardError(unsigned int firstRun) const {
+  return computeRelativeStandardError(m_summedHitEnergies, firstRun);
+}
+
+void ConvergenceRecorder::mergeRuns(unsigned int firstRun) {
+  mergeRunResults(m_photons, firstRun);
+  mergeRunResults(m_hits, firstRun);
+  mergeRunResults(m_summedHitEnergies, firstRun);
+}
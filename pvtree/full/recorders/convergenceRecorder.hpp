@@ -37,6 +37,25 @@ class ConvergenceRecorder : public RecorderBase {
    */
   bool m_eventAborted;
 
+  /*! \brief Number of events for each time segment when runs
+   *         cover several time segments, otherwise zero.
+   */
+  unsigned int m_eventsPerTimeSegment;
+
+  /*! \brief Index of the first results entry of the current run.
+   */
+  unsigned int m_firstEntry;
+
+  /*! \brief Get the results entry of an event, adding it if
+   *         necessary.
+   */
+  unsigned int getEntry(const G4Event* event);
+
+  /*! \brief Make sure there are at least a number of results
+   *         entries.
+   */
+  void extendEntries(unsigned int entryNumber);
+
  public:
   ConvergenceRecorder();
   ~ConvergenceRecorder();
@@ -47,6 +66,9 @@ class ConvergenceRecorder : public RecorderBase {
   void recordBeginOfEvent(const G4Event* event);
   void recordEndOfEvent(const G4Event* event);
 
+  RecorderBase* createWorkerRecorder() const;
+  void mergeWorkerRun(const RecorderBase* workerRecorder);
+
   /*! \brief Reset the stored results to initial values.
    */
   void reset();
@@ -55,7 +77,8 @@ class ConvergenceRecorder : public RecorderBase {
    */
   std::vector<std::vector<long> > getPhotonCounts();
 
-  /*! \brief Get the hit total counts
+  /*! \brief Get the hit total counts, which are the numbers of detected
+   *         photons.
    */
   std::vector<std::vector<long> > getHitCounts();
 
@@ -66,12 +89,47 @@ class ConvergenceRecorder : public RecorderBase {
    */
   std::vector<std::vector<double> > getSummedHitEnergies();
 
+  /*! \brief Get the mean energy deposited per event
+   *
+   * \returns The energy deposited in each run averaged over its
+   *          events, each of which is a separate estimate. The
+   *          units are [W].
+   */
+  std::vector<double> getMeanHitEnergies() const;
+
   /*! \brief Check if any event in run was aborted.
    *
    * \returns True if any of the events in the run were
    *          aborted.
    */
   bool wasAborted();
+
+  /*! \brief Store the events of each time segment of a run as if
+   *         they had been a separate run.
+   *
+   * For runs which step through several time segments, with event n
+   * belonging to time segment n / eventNumber. Events are placed by
+   * their ID, so the results do not depend on the order in which worker
+   * threads complete them.
+   *
+   * @param[in] eventNumber The number of events for each time segment,
+   *                        or zero for a single entry per run.
+   */
+  void setEventsPerTimeSegment(unsigned int eventNumber);
+
+  /*! \brief Get the number of runs recorded since the last reset.
+   */
+  unsigned int getRunNumber() const;
+
+  /*! \brief Get the relative standard error on the mean energy
+   *         deposited per event, see computeRelativeStandardError.
+   */
+  double getRelativeStandardError(unsigned int firstRun) const;
+
+  /*! \brief Combine the events of a run and all later runs into
+   *         that single run, see mergeRunResults.
+   */
+  void mergeRuns(unsigned int firstRun);
 };
 
 #endif  // RECORDERS_CONVERGENCE_RECORDER_HPP
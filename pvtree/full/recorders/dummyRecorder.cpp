@@ -9,3 +9,9 @@ DummyRecorder::~DummyRecorder() {}
 void DummyRecorder::recordBeginOfRun(const G4Run* /*run*/) {}
 
 void DummyRecorder::recordEndOfRun(const G4Run* /*run*/) {}
+
+RecorderBase* DummyRecorder::createWorkerRecorder() const {
+  return new DummyRecorder();
+}
+
+void DummyRecorder::mergeWorkerRun(const RecorderBase* /*workerRecorder*/) {}
@@ -17,6 +17,9 @@ class DummyRecorder : public RecorderBase {
 
   void recordBeginOfRun(const G4Run* run);
   void recordEndOfRun(const G4Run* run);
+
+  RecorderBase* createWorkerRecorder() const;
+  void mergeWorkerRun(const RecorderBase* workerRecorder);
 };
 
 #endif  // RECORDERS_DUMMY_RECORDER_HPP
@@ -1,4 +1,5 @@
 #include "pvtree/full/recorders/forestRecorder.hpp"
+#include "pvtree/full/recorders/runStatistics.hpp"
 #include "pvtree/full/leafTrackerHit.hpp"
 #include "G4Run.hh"
 #include "G4Event.hh"
@@ -32,15 +33,15 @@ void ForestRecorder::recordEndOfEvent(const G4Event* event) {
     m_eventAborted = true;
   }
 
-  // Store the total number of hits
+  // Store the total number of detected photons and the energy they
+  // deposited in each tree, which hits may hold for more than one photon
   G4VHitsCollection* hitCollection = event->GetHCofThisEvent()->GetHC(0);
-  m_hits.back().push_back(hitCollection->GetSize());
-
-  // Store the total energy deposited in hits
+  long hitNumber = 0;
   std::unordered_map<unsigned int, double> energyDeposited;
   for (unsigned int h = 0; h < hitCollection->GetSize(); h++) {
     LeafTrackerHit* hit =
         static_cast<LeafTrackerHit*>(hitCollection->GetHit(h));
+    hitNumber += hit->getPhotonNumber();
     auto treeNumber = hit->getTreeNumber();
     auto energy = hit->getEnergyDeposited();
     auto wasInserted = energyDeposited.insert({treeNumber, energy});
@@ -48,11 +49,49 @@ void ForestRecorder::recordEndOfEvent(const G4Event* event) {
       energyDeposited[treeNumber] += energy;
     }
   }
+  m_hits.back().push_back(hitNumber);
 
   // The units of energy deposited is [W]
   m_summedHitEnergies.back().push_back(energyDeposited);
 }
 
+RecorderBase* ForestRecorder::createWorkerRecorder() const {
+  return new ForestRecorder();
+}
+
+void ForestRecorder::mergeWorkerRun(const RecorderBase* workerRecorder) {
+  const ForestRecorder* worker =
+      dynamic_cast<const ForestRecorder*>(workerRecorder);
+
+  if (worker == 0 || worker->m_summedHitEnergies.empty()) {
+    return;
+  }
+
+  // The run should already have been started on the master thread
+  if (m_summedHitEnergies.empty()) {
+    m_photons.push_back(std::vector<long>());
+    m_hits.push_back(std::vector<long>());
+    m_summedHitEnergies.push_back(
+        std::vector<std::unordered_map<unsigned int, double> >());
+  }
+
+  const auto& workerPhotons = worker->m_photons.back();
+  const auto& workerHits = worker->m_hits.back();
+  const auto& workerEnergies = worker->m_summedHitEnergies.back();
+
+  m_photons.back().insert(m_photons.back().end(), workerPhotons.begin(),
+                          workerPhotons.end());
+  m_hits.back().insert(m_hits.back().end(), workerHits.begin(),
+                       workerHits.end());
+  m_summedHitEnergies.back().insert(m_summedHitEnergies.back().end(),
+                                    workerEnergies.begin(),
+                                    workerEnergies.end());
+
+  if (worker->m_eventAborted) {
+    m_eventAborted = true;
+  }
+}
+
 void ForestRecorder::reset() {
   m_photons.clear();
   m_hits.clear();
@@ -73,3 +112,35 @@ std::vector<std::vector<std::unordered_map<unsigned int, double> > > ForestRecor
 }
 
 bool ForestRecorder::wasAborted() { return m_eventAborted; }
+
+unsigned int ForestRecorder::getRunNumber() const {
+  return m_summedHitEnergies.size();
+}
+
+std::vector<std::unordered_map<unsigned int, double> >
+ForestRecorder::getMeanHitEnergies() const {
+  std::vector<std::unordered_map<unsigned int, double> > meanHitEnergies;
+
+  for (const auto& runEnergies : m_summedHitEnergies) {
+    std::unordered_map<unsigned int, double> meanTreeEnergies;
+    for (const auto& eventHitEnergies : runEnergies) {
+      for (const auto& treeEnergy : eventHitEnergies) {
+        meanTreeEnergies[treeEnergy.first] +=
+            treeEnergy.second / runEnergies.size();
+      }
+    }
+    meanHitEnergies.push_back(meanTreeEnergies);
+  }
+
+  return meanHitEnergies;
+}
+
+double ForestRecorder::getRelativeStandardError(unsigned int firstRun) const {
+  return computeRelativeStandardError(m_summedHitEnergies, firstRun);
+}
+
+void ForestRecorder::mergeRuns(unsigned int firstRun) {
+  mergeRunResults(m_photons, firstRun);
+  mergeRunResults(m_hits, firstRun);
+  mergeRunResults(m_summedHitEnergies, firstRun);
+}
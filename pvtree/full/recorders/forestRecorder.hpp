@@ -48,6 +48,9 @@ class ForestRecorder : public RecorderBase {
   void recordBeginOfEvent(const G4Event* event);
   void recordEndOfEvent(const G4Event* event);
 
+  RecorderBase* createWorkerRecorder() const;
+  void mergeWorkerRun(const RecorderBase* workerRecorder);
+
   /*! \brief Reset the stored results to initial values.
    */
   void reset();
@@ -56,7 +59,8 @@ class ForestRecorder : public RecorderBase {
    */
   std::vector<std::vector<long> > getPhotonCounts();
 
-  /*! \brief Get the hit total counts
+  /*! \brief Get the hit total counts, which are the numbers of detected
+   *         photons.
    */
   std::vector<std::vector<long> > getHitCounts();
 
@@ -67,12 +71,35 @@ class ForestRecorder : public RecorderBase {
    */
   std::vector<std::vector<std::unordered_map<unsigned int, double> > > getSummedHitEnergies();
 
+  /*! \brief Get the mean energy deposited per event
+   *
+   * \returns The energy deposited in each run per tree averaged
+   *          over its events, each of which is a separate estimate.
+   *          The units are [W].
+   */
+  std::vector<std::unordered_map<unsigned int, double> > getMeanHitEnergies()
+      const;
+
   /*! \brief Check if any event in run was aborted.
    *
    * \returns True if any of the events in the run were
    *          aborted.
    */
   bool wasAborted();
+
+  /*! \brief Get the number of runs recorded since the last reset.
+   */
+  unsigned int getRunNumber() const;
+
+  /*! \brief Get the relative standard error on the mean energy
+   *         deposited per event, see computeRelativeStandardError.
+   */
+  double getRelativeStandardError(unsigned int firstRun) const;
+
+  /*! \brief Combine the events of a run and all later runs into
+   *         that single run, see mergeRunResults.
+   */
+  void mergeRuns(unsigned int firstRun);
 };
 
 #endif  // RECORDERS_FOREST_RECORDER_HPP
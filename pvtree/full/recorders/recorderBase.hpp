@@ -13,6 +13,10 @@
  *
  * This seperates the analysis implementation details from
  * the general simulation (for the most part).
+ *
+ * In multi-threaded running each worker thread records into
+ * its own recorder, and the results of each run are merged
+ * into the recorder given to the action initialization.
  */
 
 class G4Run;
@@ -31,6 +35,24 @@ class RecorderBase {
   virtual void recordEndOfEvent(const G4Event*){};
   virtual void recordTrack(const G4Track*){};
   virtual void recordStep(const G4Step*){};
+
+  /*! \brief Reset the stored results to initial values.
+   */
+  virtual void reset(){};
+
+  /*! \brief Create an empty recorder of the same type for a
+   *         worker thread.
+   */
+  virtual RecorderBase* createWorkerRecorder() const = 0;
+
+  /*! \brief Add the results of the last run of a worker thread
+   *         to the current run.
+   *
+   * Only called by one worker at a time.
+   *
+   * @param[in] workerRecorder A recorder made by createWorkerRecorder.
+   */
+  virtual void mergeWorkerRun(const RecorderBase* workerRecorder) = 0;
 };
 
 #endif  // RECORDERS_RECORDER_BASE_HPP
@@ -0,0 +1,102 @@
+#ifndef RECORDERS_RUN_STATISTICS_HPP
+#define RECORDERS_RUN_STATISTICS_HPP
+
+/*!
+ * @file
+ * \brief Statistics shared by the recorders which keep the
+ *        results of each event of a number of runs.
+ *
+ * The results are stored per run and then per event, with
+ * each event being a separate estimate of the energy
+ * deposited during the time segment of its run.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief Energy deposited in a whole event. [W]
+ */
+inline double getEventEnergy(double energy) { return energy; }
+
+/*! \brief Energy deposited in a whole event, summed over the
+ *         trees which were hit. [W]
+ */
+inline double getEventEnergy(
+    const std::unordered_map<unsigned int, double>& treeEnergies) {
+  double energy = 0.0;
+  for (const auto& treeEnergy : treeEnergies) {
+    energy += treeEnergy.second;
+  }
+  return energy;
+}
+
+/*! \brief Get the relative standard error on the mean energy
+ *         deposited per event.
+ *
+ * Used to stop simulating a time segment once its deposited
+ * energy is known well enough.
+ *
+ * @param[in] runEnergies The energies deposited per run per event.
+ * @param[in] firstRun The events of this run and all later runs
+ *                     are combined.
+ *
+ * \returns The standard error divided by the mean. Infinite if
+ *          there are fewer than two events or no energy was
+ *          deposited, so that a chunk which happened to miss the
+ *          trees is never taken as converged.
+ */
+template <class EventEnergy>
+double computeRelativeStandardError(
+    const std::vector<std::vector<EventEnergy> >& runEnergies,
+    unsigned int firstRun) {
+  long eventNumber = 0;
+  double sum = 0.0;
+  double squaredSum = 0.0;
+
+  for (unsigned int r = firstRun; r < runEnergies.size(); r++) {
+    for (const EventEnergy& eventEnergy : runEnergies[r]) {
+      double energy = getEventEnergy(eventEnergy);
+
+      eventNumber++;
+      sum += energy;
+      squaredSum += energy * energy;
+    }
+  }
+
+  if (eventNumber < 2 || sum <= 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  double mean = sum / eventNumber;
+  double variance =
+      std::max(squaredSum / eventNumber - mean * mean, 0.0) * eventNumber /
+      (eventNumber - 1);
+
+  return std::sqrt(variance / eventNumber) / mean;
+}
+
+/*! \brief Combine the events of a run and all later runs into
+ *         that single run.
+ *
+ * @param[in,out] runResults The results per run per event.
+ * @param[in] firstRun The run which will hold all the events.
+ */
+template <class EventResult>
+void mergeRunResults(std::vector<std::vector<EventResult> >& runResults,
+                     unsigned int firstRun) {
+  if (firstRun >= runResults.size()) {
+    return;
+  }
+
+  for (unsigned int r = firstRun + 1; r < runResults.size(); r++) {
+    runResults[firstRun].insert(runResults[firstRun].end(),
+                                runResults[r].begin(), runResults[r].end());
+  }
+
+  runResults.resize(firstRun + 1);
+}
+
+#endif  // RECORDERS_RUN_STATISTICS_HPP
@@ -3,11 +3,24 @@
 #include "G4Run.hh"
 #include "G4RunManager.hh"
 #include "G4TransportationManager.hh"
+#include "G4AutoLock.hh"
 
-RunAction::RunAction(RecorderBase* recorder)
-    : G4UserRunAction(), m_recorder(recorder) {}
+namespace {
+//! Allows one worker at a time to merge its results
+G4Mutex mergeMutex = G4MUTEX_INITIALIZER;
+}
+
+RunAction::RunAction(RecorderBase* recorder,
+                     RecorderBase* masterRecorder /* = 0 */)
+    : G4UserRunAction(),
+      m_recorder(recorder),
+      m_masterRecorder(masterRecorder) {}
 
-RunAction::~RunAction() {}
+RunAction::~RunAction() {
+  if (m_masterRecorder) {
+    delete m_recorder;
+  }
+}
 
 void RunAction::BeginOfRunAction(const G4Run* run) {
   // inform the runManager to save random number seed
@@ -25,4 +38,13 @@ void RunAction::BeginOfRunAction(const G4Run* run) {
 void RunAction::EndOfRunAction(const G4Run* run) {
   // perform analysis
   m_recorder->recordEndOfRun(run);
+
+  // Pass the worker results on before the master run ends
+  if (m_masterRecorder) {
+    G4AutoLock lock(&mergeMutex);
+    m_masterRecorder->mergeWorkerRun(m_recorder);
+    lock.unlock();
+
+    m_recorder->reset();
+  }
 }
@@ -8,13 +8,22 @@ class RecorderBase;
 
 class RunAction : public G4UserRunAction {
  public:
-  explicit RunAction(RecorderBase* recorder);
+  /*! \brief Pass the start and end of runs to a recorder.
+   *
+   * @param[in] recorder Analysis for this thread.
+   * @param[in] masterRecorder When running on a worker thread, the
+   *                           shared analysis into which the results of
+   *                           each run are merged. The worker recorder
+   *                           is then owned by the run action.
+   */
+  explicit RunAction(RecorderBase* recorder, RecorderBase* masterRecorder = 0);
   virtual ~RunAction();
   virtual void BeginOfRunAction(const G4Run*);
   virtual void EndOfRunAction(const G4Run*);
 
  private:
   RecorderBase* m_recorder;
+  RecorderBase* m_masterRecorder;
 };
 
 #endif  // PV_FULL_RUN_ACTION
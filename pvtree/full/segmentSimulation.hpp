@@ -0,0 +1,77 @@
+#ifndef PV_TREE_FULL_SEGMENT_SIMULATION_HPP
+#define PV_TREE_FULL_SEGMENT_SIMULATION_HPP
+
+/*! @file
+ * \brief Simulation of a single time segment, either with a fixed
+ *        number of events or in chunks of events until the energy
+ *        deposited has converged.
+ *
+ * Shared by the scan programs, which only differ in how they select
+ * the sky of a segment and in the recorder which scores the energy.
+ */
+
+#include "pvtree/full/solarSimulation/skyState.hpp"
+#include "G4RunManager.hh"
+
+/*! \brief Settings controlling how many events simulate a time segment.
+ */
+struct SegmentSimulationSettings {
+  //! Number of events a time segment is split into
+  unsigned int subEventNumber;
+
+  //! Photons fired in each event
+  unsigned int photonNumberPerEvent;
+
+  //! Relative standard error to stop at, or zero for a single run
+  double targetRelativeError;
+
+  //! Multiple of the sub-events simulated in each chunk
+  unsigned int chunkEventNumber;
+
+  //! Chunks to simulate before testing the convergence
+  unsigned int minimumChunkNumber;
+
+  //! Photons after which a segment is stopped even if not converged
+  unsigned int maximumPhotonNumber;
+};
+
+/*! \brief Simulate a time segment, leaving its events in a single run
+ *         of the recorder.
+ *
+ * @param[in] runManager The run manager with the geometry ready.
+ * @param[in,out] recorder Scores the energy deposited, which needs to
+ *                         provide getRunNumber, getRelativeStandardError
+ *                         and mergeRuns.
+ * @param[in] skyState The sky the primary generator will sample.
+ * @param[in] settings The number of events to simulate.
+ */
+template <class Recorder>
+void simulateSegment(G4RunManager* runManager, Recorder& recorder,
+                     const SkyState& skyState,
+                     const SegmentSimulationSettings& settings) {
+  unsigned int firstRun = recorder.getRunNumber();
+  unsigned long segmentPhotonNumber = 0ul;
+  G4int eventNumber = settings.subEventNumber;
+  if (settings.targetRelativeError > 0.0) {
+    eventNumber *= settings.chunkEventNumber;
+  }
+
+  // A segment without any light can only ever deposit nothing
+  bool segmentLit = skyState.totalNormalIrradiance > 0.0 ||
+                    skyState.totalDiffuseIrradiance > 0.0;
+
+  unsigned int chunkNumber = 0u;
+  do {
+    runManager->BeamOn(eventNumber);
+    segmentPhotonNumber += eventNumber * settings.photonNumberPerEvent;
+    chunkNumber++;
+  } while (settings.targetRelativeError > 0.0 && segmentLit &&
+           segmentPhotonNumber < settings.maximumPhotonNumber &&
+           (chunkNumber < settings.minimumChunkNumber ||
+            recorder.getRelativeStandardError(firstRun) >
+                settings.targetRelativeError));
+
+  recorder.mergeRuns(firstRun);
+}
+
+#endif  // PV_TREE_FULL_SEGMENT_SIMULATION_HPP
@@ -1,56 +1,380 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
-#include "TCut.h"
 
 #include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
 
 #include "pvtree/utils/resource.hpp"
 
-SkyFunction::SkyFunction(double solar_elevation, double atmospheric_turbidity,
-                         double ground_albedo) {
-  state = new HosekSkyModelState();
-  theta = 0.0;
-  gamma = 0.0;
-  wavelength = 0.0;
-  ready = 0;  // False
+#include "TFile.h"
+#include "TTree.h"
+
+namespace {
+// Default quantization of the sky conditions when memoizing cooked states
+const double kDefaultElevationStep = 0.001;  // [rad]
+const double kDefaultTurbidityStep = 0.01;   // []
+const double kDefaultAlbedoStep = 0.01;      // []
+
+/*! \brief Evaluate the quintic Bezier curve through six control points.
+ *
+ * @param[in] data The first control point.
+ * @param[in] stride The separation of consecutive control points.
+ * @param[in] t The curve parameter, between 0 and 1.
+ */
+double quinticBezier(const double* data, int stride, double t) {
+  //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
+  return pow(1.0 - t, 5.0) * data[0] +
+         5.0 * pow(1.0 - t, 4.0) * t * data[stride] +
+         10.0 * pow(1.0 - t, 3.0) * pow(t, 2.0) * data[2 * stride] +
+         10.0 * pow(1.0 - t, 2.0) * pow(t, 3.0) * data[3 * stride] +
+         5.0 * (1.0 - t) * pow(t, 4.0) * data[4 * stride] +
+         pow(t, 5.0) * data[5 * stride];
+}
+}
+
+HosekSkyModelData* HosekSkyModelData::instance() {
+  static HosekSkyModelData hosekSkyModelData;
+  return &hosekSkyModelData;
+}
 
+HosekSkyModelData::HosekSkyModelData() {
   std::ifstream localTest("HosekSkyModelData.root");
 
   if (localTest.is_open()) {
     // If found use the local file
     localTest.close();
-    ff = new TFile("HosekSkyModelData.root", "read");
-    tree = (TTree*)ff->Get("skymodeldata");
-    init(solar_elevation, atmospheric_turbidity, ground_albedo);
-  } else {
-    // Environment variable set so give it a try
-    std::string shareFilePath = pvtree::getConfigFile("HosekSkyModelData.root");
-    std::ifstream shareTest(shareFilePath.c_str());
-
-    if (shareTest.is_open()) {
-      shareTest.close();
-      ff = new TFile(shareFilePath.c_str(), "read");
-      tree = (TTree*)ff->Get("skymodeldata");
-      init(solar_elevation, atmospheric_turbidity, ground_albedo);
+    extractFile("HosekSkyModelData.root");
+    return;
+  }
+
+  // Environment variable set so give it a try
+  std::string shareFilePath = pvtree::getConfigFile("HosekSkyModelData.root");
+  std::ifstream shareTest(shareFilePath.c_str());
+
+  if (shareTest.is_open()) {
+    shareTest.close();
+    extractFile(shareFilePath);
+    return;
+  }
+
+  // If reaching here then unable to extract a file's contents!
+  std::cout << "HosekSkyModelData::HosekSkyModelData - Unable to find the Sky "
+               "model file " << std::endl;
+  throw std::invalid_argument("Can't find HosekSkyModelData.root input file.");
+}
+
+void HosekSkyModelData::extractFile(std::string filePath) {
+  TFile inputFile(filePath.c_str(), "READ");
+  TTree* tree = (TTree*)inputFile.Get("skymodeldata");
+
+  if (!tree) {
+    throw std::invalid_argument("File does not contain the sky model data.");
+  }
+
+  int name, wavelength, albedo, turbidity;
+  std::vector<double>* data = 0;
+
+  tree->SetBranchAddress("name", &name);
+  tree->SetBranchAddress("wl", &wavelength);
+  tree->SetBranchAddress("albedo", &albedo);
+  tree->SetBranchAddress("turbidity", &turbidity);
+  tree->SetBranchAddress("datavector", &data);
+
+  int tableNumber = wavelengthChannelNumber * 2 * turbidityNumber;
+  m_configurationData.assign(tableNumber * configurationSize, 0.0);
+  m_radianceData.assign(tableNumber * radianceSize, 0.0);
+  std::vector<bool> configurationFilled(tableNumber, false);
+  std::vector<bool> radianceFilled(tableNumber, false);
+
+  // Single pass over the file, placing each entry in its table
+  for (Long64_t entry = 0; entry < tree->GetEntries(); entry++) {
+    tree->GetEntry(entry);
+
+    int index = tableIndex((wavelength - 320) / 40, albedo, turbidity);
+    int size = name == 0 ? configurationSize : radianceSize;
+
+    if ((name != 0 && name != 1) || (int)data->size() != size) {
+      throw std::invalid_argument("Unexpected entry in the sky model data.");
+    }
+
+    if (name == 0) {
+      std::copy(data->begin(), data->end(),
+                m_configurationData.begin() + index * size);
+      configurationFilled[index] = true;
     } else {
-      // If reaching here then unable to extract a file's contents!
-      std::cout << "Spectrum::Spectrum - Unable to find the Sky model file "
-          << std::endl;
-      throw std::invalid_argument(
-          "Can't find HosekSkyModelData.root input file.");
+      std::copy(data->begin(), data->end(),
+                m_radianceData.begin() + index * size);
+      radianceFilled[index] = true;
     }
   }
 
+  inputFile.Close();
+
+  for (int index = 0; index < tableNumber; index++) {
+    if (!configurationFilled[index] || !radianceFilled[index]) {
+      std::cerr << "Sky model data in " << filePath << " is incomplete."
+                << std::endl;
+      throw std::invalid_argument("Incomplete sky model data.");
+    }
+  }
+}
+
+int HosekSkyModelData::tableIndex(int wavelengthIndex, int albedo,
+                                  int turbidity) const {
+  if (wavelengthIndex < 0 || wavelengthIndex >= wavelengthChannelNumber ||
+      albedo < 0 || albedo > 1 || turbidity < 1 ||
+      turbidity > turbidityNumber) {
+    throw std::out_of_range("Sky model data table does not exist.");
+  }
+
+  return (wavelengthIndex * 2 + albedo) * turbidityNumber + turbidity - 1;
+}
+
+const double* HosekSkyModelData::getConfigurationData(int wavelengthIndex,
+                                                      int albedo,
+                                                      int turbidity) const {
+  return &m_configurationData[tableIndex(wavelengthIndex, albedo, turbidity) *
+                              configurationSize];
+}
+
+const double* HosekSkyModelData::getRadianceData(int wavelengthIndex,
+                                                 int albedo,
+                                                 int turbidity) const {
+  return &m_radianceData[tableIndex(wavelengthIndex, albedo, turbidity) *
+                         radianceSize];
+}
+
+void HosekSkyModelState::evaluateRadiances(const double* thetas,
+                                           const double* gammas,
+                                           double* values,
+                                           unsigned int pointNumber) const {
+  std::vector<double> directionTerms =
+      calculateDirectionTerms(thetas, gammas, pointNumber);
+
+  std::fill(values, values + pointNumber, 0.0);
+
+  // Channels in order so the sum matches the single channel evaluation
+  for (unsigned int c = 0; c < radiances.size(); c++) {
+    addChannelRadiances(c, gammas, directionTerms, values, pointNumber);
+  }
+}
+
+void HosekSkyModelState::evaluateChannelRadiances(
+    const double* thetas, const double* gammas, double* values,
+    unsigned int pointNumber) const {
+  std::vector<double> directionTerms =
+      calculateDirectionTerms(thetas, gammas, pointNumber);
+
+  std::fill(values, values + pointNumber * radiances.size(), 0.0);
+
+  for (unsigned int c = 0; c < radiances.size(); c++) {
+    addChannelRadiances(c, gammas, directionTerms, values + c * pointNumber,
+                        pointNumber);
+  }
+}
+
+std::vector<double> HosekSkyModelState::calculateDirectionTerms(
+    const double* thetas, const double* gammas, unsigned int pointNumber) {
+  std::vector<double> directionTerms(3 * pointNumber);
+  double* cosThetaOffsets = &directionTerms[0];
+  double* zeniths = &directionTerms[pointNumber];
+  double* cosGammas = &directionTerms[2 * pointNumber];
+
+  for (unsigned int i = 0; i < pointNumber; i++) {
+    double cosTheta = cos(thetas[i]);
+    cosThetaOffsets[i] = cosTheta + 0.01;
+    zeniths[i] = sqrt(cosTheta);
+    cosGammas[i] = cos(gammas[i]);
+  }
+
+  return directionTerms;
+}
+
+void HosekSkyModelState::addChannelRadiances(
+    unsigned int channel, const double* gammas,
+    const std::vector<double>& directionTerms, double* values,
+    unsigned int pointNumber) const {
+  const double* cosThetaOffsets = &directionTerms[0];
+  const double* zeniths = &directionTerms[pointNumber];
+  const double* cosGammas = &directionTerms[2 * pointNumber];
+
+  const double a = channelParameters[0][channel];
+  const double b = channelParameters[1][channel];
+  const double c = channelParameters[2][channel];
+  const double d = channelParameters[3][channel];
+  const double e = channelParameters[4][channel];
+  const double f = channelParameters[5][channel];
+  const double g = channelParameters[6][channel];
+  const double h = channelParameters[7][channel];
+  const double k = channelParameters[8][channel];
+  const double channelRadiance = radiances[channel];
+
+  for (unsigned int i = 0; i < pointNumber; i++) {
+    const double expM = exp(e * gammas[i]);
+    const double rayM = cosGammas[i] * cosGammas[i];
+    const double mieBase = 1.0 + k * k - 2.0 * k * cosGammas[i];
+    const double mieM = (1.0 + rayM) / (mieBase * sqrt(mieBase));
+
+    values[i] += (1.0 + a * exp(b / cosThetaOffsets[i])) *
+                 (c + d * expM + f * rayM + g * mieM + h * zeniths[i]) *
+                 channelRadiance;
+  }
+}
+
+HosekSkyModelStateCache* HosekSkyModelStateCache::instance() {
+  static thread_local HosekSkyModelStateCache hosekSkyModelStateCache;
+  return &hosekSkyModelStateCache;
+}
+
+HosekSkyModelStateCache::HosekSkyModelStateCache()
+    : m_elevationStep(kDefaultElevationStep),
+      m_turbidityStep(kDefaultTurbidityStep),
+      m_albedoStep(kDefaultAlbedoStep),
+      m_exactMatch(false),
+      m_cacheSize(256u),
+      m_hits(0ul),
+      m_misses(0ul) {}
+
+std::shared_ptr<const HosekSkyModelState> HosekSkyModelStateCache::getState(
+    double solar_elevation, double atmospheric_turbidity,
+    double ground_albedo) {
+  StateCacheKey key;
+
+  if (m_exactMatch) {
+    double values[3] = {solar_elevation, atmospheric_turbidity, ground_albedo};
+    static_assert(sizeof(key) == sizeof(values),
+                  "Exact sky model keys need 64 bit values.");
+    std::memcpy(key.data(), values, sizeof(values));
+  } else {
+    key = {{std::llround(solar_elevation / m_elevationStep),
+            std::llround(atmospheric_turbidity / m_turbidityStep),
+            std::llround(ground_albedo / m_albedoStep)}};
+
+    // Cook at the centre of the quantization step, kept within the tables
+    solar_elevation = key[0] * m_elevationStep;
+    atmospheric_turbidity =
+        std::min(std::max(key[1] * m_turbidityStep, 1.0),
+                 (double)HosekSkyModelData::turbidityNumber);
+    ground_albedo = std::min(std::max(key[2] * m_albedoStep, 0.0), 1.0);
+  }
+
+  if (m_cacheSize == 0u) {
+    m_misses++;
+    return SkyFunction::cookState(solar_elevation, atmospheric_turbidity,
+                                  ground_albedo);
+  }
+
+  auto cachedState = m_stateCache.find(key);
+
+  if (cachedState != m_stateCache.end()) {
+    m_hits++;
+
+    // Move to the front of the usage order
+    m_stateCacheOrder.splice(m_stateCacheOrder.begin(), m_stateCacheOrder,
+                             cachedState->second.order);
+
+    return cachedState->second.state;
+  }
+
+  m_misses++;
+  std::shared_ptr<const HosekSkyModelState> cookedState =
+      SkyFunction::cookState(solar_elevation, atmospheric_turbidity,
+                             ground_albedo);
+
+  // Discard the least recently used state to stay within limits
+  if (m_stateCache.size() >= m_cacheSize) {
+    m_stateCache.erase(m_stateCacheOrder.back());
+    m_stateCacheOrder.pop_back();
+  }
+
+  m_stateCacheOrder.push_front(key);
+
+  StateCacheEntry& entry = m_stateCache[key];
+  entry.state = cookedState;
+  entry.order = m_stateCacheOrder.begin();
+
+  return cookedState;
+}
+
+std::size_t HosekSkyModelStateCache::StateCacheKeyHash::operator()(
+    const StateCacheKey& key) const {
+  std::size_t seed = 0;
+  for (auto value : key) {
+    seed ^= std::hash<long long>()(value) + 0x9e3779b9 + (seed << 6) +
+            (seed >> 2);
+  }
+  return seed;
+}
+
+void HosekSkyModelStateCache::setQuantizationSteps(double elevationStep,
+                                                   double turbidityStep,
+                                                   double albedoStep) {
+  if (elevationStep <= 0.0 || turbidityStep <= 0.0 || albedoStep <= 0.0) {
+    throw std::invalid_argument("Sky model quantization steps must be "
+                                "positive.");
+  }
+
+  m_elevationStep = elevationStep;
+  m_turbidityStep = turbidityStep;
+  m_albedoStep = albedoStep;
+  clear();
+}
+
+void HosekSkyModelStateCache::setExactMatch(bool exactMatch) {
+  if (exactMatch != m_exactMatch) {
+    m_exactMatch = exactMatch;
+    clear();
+  }
+}
+
+void HosekSkyModelStateCache::setCacheSize(unsigned int maximumSize) {
+  m_cacheSize = maximumSize;
+
+  // Remove the least recently used states beyond the new limit
+  while (m_stateCache.size() > m_cacheSize) {
+    m_stateCache.erase(m_stateCacheOrder.back());
+    m_stateCacheOrder.pop_back();
+  }
+}
+
+void HosekSkyModelStateCache::clear() {
+  m_stateCache.clear();
+  m_stateCacheOrder.clear();
+}
+
+unsigned long HosekSkyModelStateCache::getHits() const { return m_hits; }
+
+unsigned long HosekSkyModelStateCache::getMisses() const { return m_misses; }
+
+void HosekSkyModelStateCache::printStatistics() const {
+  unsigned long requests = m_hits + m_misses;
+  double hitRate = requests > 0ul ? 100.0 * m_hits / (double)requests : 0.0;
+
+  std::cout << "Sky model cache: " << m_hits << " hits, " << m_misses
+            << " misses (" << hitRate << "% hit rate) with "
+            << m_stateCache.size() << "/" << m_cacheSize
+            << " states stored." << std::endl;
+}
+
+SkyFunction::SkyFunction(double solar_elevation, double atmospheric_turbidity,
+                         double ground_albedo) {
+  ready = 0;  // False
+
+  init(solar_elevation, atmospheric_turbidity, ground_albedo);
+
   //  std::cout << "in constructor configs, size=" <<
   //  state->configurations().size() << std::endl;
 }
 
-SkyFunction::~SkyFunction() {
-  ff->Close();
-  if (state) delete state;
+SkyFunction::~SkyFunction() {}
+
+std::shared_ptr<const HosekSkyModelState> SkyFunction::getState() const {
+  return state;
 }
 
 double SkyFunction::Eval(double* x, double* /*par*/) {
@@ -58,15 +382,8 @@ double SkyFunction::Eval(double* x, double* /*par*/) {
   //   std::cout << "in Eval configs, size=" << state->configurations().size()
   //   << std::endl;
   if (ready) {
-    theta = x[0];
-    gamma = x[1];
-    int wlchannels[11] = {320, 360, 400, 440, 480, 520,
-                          560, 600, 640, 680, 720};
     double sum = 0.0;
-    for (int wl = 0; wl < 11; ++wl) {
-      wavelength = wlchannels[wl];
-      sum += hosekskymodel_radiance();
-    }
+    state->evaluateRadiances(&x[0], &x[1], &sum, 1u);
     return sum;  // total radiance over all wavelengths
   } else {
     std::cout << "SkyFunction: launch init first before use. Bailing out with "
@@ -78,335 +395,97 @@ double SkyFunction::Eval(double* x, double* /*par*/) {
 std::vector<double> SkyFunction::HosekSkyModel_CookConfiguration(
     int wlid, double turbidity, double albedo, double solar_elevation) {
   double pi = acos(-1.0);
-  std::vector<double> config;
-  int wlchannels[11] = {320, 360, 400, 440, 480, 520, 560, 600, 640, 680, 720};
+  const HosekSkyModelData* modelData = HosekSkyModelData::instance();
+  std::vector<double> config(9, 0.0);
   int int_turbidity = (int)turbidity;
   double turbidity_rem = turbidity - (double)int_turbidity;
 
-  TString name_cut = "name==0";  // Data
-  TCut c1 = name_cut.Data();
-  TString albedo_cut = "albedo==0";
-  TCut c2 = albedo_cut.Data();
-
-  TString turbidity_cut = "turbidity==";
-  turbidity_cut += int_turbidity;
-  TCut c3 = turbidity_cut.Data();
-
-  TString wl_cut = "wl==";
-  wl_cut += wlchannels[wlid];
-  TCut c4 = wl_cut.Data();
-
-  TCut cut = c1 && c2 && c3 && c4;
-  //  cout << cut.GetTitle() << endl;
-
   solar_elevation = pow(solar_elevation / (pi / 2.0), (1.0 / 3.0));
 
-  // alb 0 low turb
-  std::vector<double>* data = 0;
-  tree->SetBranchAddress("datavector", &data);
+  // Blend the low and high turbidity tables for both albedos
+  double weights[2][2] = {
+      {(1.0 - albedo) * (1.0 - turbidity_rem), albedo * (1.0 - turbidity_rem)},
+      {(1.0 - albedo) * turbidity_rem, albedo * turbidity_rem}};
 
-  //  elev_matrix = dataset + ( 9 * 6 * (int_turbidity-1) );
-  TEntryList* elist = 0;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  for (unsigned int i = 0; i < 9; ++i) {
-    //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-    config.push_back((1.0 - albedo) * (1.0 - turbidity_rem) *
-                     (pow(1.0 - solar_elevation, 5.0) * data->at(i) +
-                      5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation *
-                          data->at(i + 9) +
-                      10.0 * pow(1.0 - solar_elevation, 3.0) *
-                          pow(solar_elevation, 2.0) * data->at(i + 18) +
-                      10.0 * pow(1.0 - solar_elevation, 2.0) *
-                          pow(solar_elevation, 3.0) * data->at(i + 27) +
-                      5.0 * (1.0 - solar_elevation) *
-                          pow(solar_elevation, 4.0) * data->at(i + 36) +
-                      pow(solar_elevation, 5.0) * data->at(i + 45)));
-  }
+  for (int turbidityStep = 0; turbidityStep < 2; turbidityStep++) {
+    // Nothing above the highest turbidity to blend with
+    if (int_turbidity + turbidityStep > HosekSkyModelData::turbidityNumber) {
+      break;
+    }
 
-  // alb 1 low turb
-  albedo_cut = "albedo==1";
-  c2 = albedo_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (9*6*10 + 9*6*(int_turbidity-1));
-  for (unsigned int i = 0; i < 9; ++i) {
-    //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-    config[i] += (albedo) * (1.0 - turbidity_rem) *
-                 (pow(1.0 - solar_elevation, 5.0) * data->at(i) +
-                  5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation *
-                      data->at(i + 9) +
-                  10.0 * pow(1.0 - solar_elevation, 3.0) *
-                      pow(solar_elevation, 2.0) * data->at(i + 18) +
-                  10.0 * pow(1.0 - solar_elevation, 2.0) *
-                      pow(solar_elevation, 3.0) * data->at(i + 27) +
-                  5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) *
-                      data->at(i + 36) +
-                  pow(solar_elevation, 5.0) * data->at(i + 45));
-  }
+    for (int albedoIndex = 0; albedoIndex < 2; albedoIndex++) {
+      //  elev_matrix = dataset + (9*6*10*albedo + 9*6*(int_turbidity-1));
+      const double* data = modelData->getConfigurationData(
+          wlid, albedoIndex, int_turbidity + turbidityStep);
 
-  // alb 0 high turb
-  albedo_cut = "albedo==0";
-  c2 = albedo_cut.Data();
-
-  turbidity_cut = "turbidity==";
-  turbidity_cut += int_turbidity + 1;
-  c3 = turbidity_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (9*6*(int_turbidity));
-  for (unsigned int i = 0; i < 9; ++i) {
-    //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-    config[i] += (1.0 - albedo) * (turbidity_rem) *
-                 (pow(1.0 - solar_elevation, 5.0) * data->at(i) +
-                  5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation *
-                      data->at(i + 9) +
-                  10.0 * pow(1.0 - solar_elevation, 3.0) *
-                      pow(solar_elevation, 2.0) * data->at(i + 18) +
-                  10.0 * pow(1.0 - solar_elevation, 2.0) *
-                      pow(solar_elevation, 3.0) * data->at(i + 27) +
-                  5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) *
-                      data->at(i + 36) +
-                  pow(solar_elevation, 5.0) * data->at(i + 45));
+      for (unsigned int i = 0; i < 9; ++i) {
+        config[i] += weights[turbidityStep][albedoIndex] *
+                     quinticBezier(data + i, 9, solar_elevation);
+      }
+    }
   }
 
-  // alb 1 high turb
-  albedo_cut = "albedo==1";
-  c2 = albedo_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (9*6*10 + 9*6*(int_turbidity));
-  for (unsigned int i = 0; i < 9; ++i) {
-    //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-    config[i] += (albedo) * (turbidity_rem) *
-                 (pow(1.0 - solar_elevation, 5.0) * data->at(i) +
-                  5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation *
-                      data->at(i + 9) +
-                  10.0 * pow(1.0 - solar_elevation, 3.0) *
-                      pow(solar_elevation, 2.0) * data->at(i + 18) +
-                  10.0 * pow(1.0 - solar_elevation, 2.0) *
-                      pow(solar_elevation, 3.0) * data->at(i + 27) +
-                  5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) *
-                      data->at(i + 36) +
-                  pow(solar_elevation, 5.0) * data->at(i + 45));
-  }
   return config;
 }
 
 double SkyFunction::HosekSkyModel_CookRadianceConfiguration(
     int wlid, double turbidity, double albedo, double solar_elevation) {
   double pi = acos(-1.0);
-  int wlchannels[11] = {320, 360, 400, 440, 480, 520, 560, 600, 640, 680, 720};
-
+  const HosekSkyModelData* modelData = HosekSkyModelData::instance();
   int int_turbidity = (int)turbidity;
   double turbidity_rem = turbidity - (double)int_turbidity;
-  double res;
-
-  TString name_cut = "name==1";  // RadData
-  TCut c1 = name_cut.Data();
-  TString albedo_cut = "albedo==0";
-  TCut c2 = albedo_cut.Data();
+  double res = 0.0;
 
-  TString turbidity_cut = "turbidity==";
-  turbidity_cut += int_turbidity;
-  TCut c3 = turbidity_cut.Data();
+  solar_elevation = pow(solar_elevation / (pi / 2.0), (1.0 / 3.0));
 
-  TString wl_cut = "wl==";
-  wl_cut += wlchannels[wlid];
-  TCut c4 = wl_cut.Data();
+  // Blend the low and high turbidity tables for both albedos
+  double weights[2][2] = {
+      {(1.0 - albedo) * (1.0 - turbidity_rem), albedo * (1.0 - turbidity_rem)},
+      {(1.0 - albedo) * turbidity_rem, albedo * turbidity_rem}};
 
-  TCut cut = c1 + c2 + c3 + c4;
-  //  cout << "in rad: " << cut.GetTitle() << endl;
+  for (int turbidityStep = 0; turbidityStep < 2; turbidityStep++) {
+    // Nothing above the highest turbidity to blend with
+    if (int_turbidity + turbidityStep > HosekSkyModelData::turbidityNumber) {
+      break;
+    }
 
-  solar_elevation = pow(solar_elevation / (pi / 2.0), (1.0 / 3.0));
+    for (int albedoIndex = 0; albedoIndex < 2; albedoIndex++) {
+      //  elev_matrix = dataset + (6*10*albedo + 6*(int_turbidity-1));
+      const double* data = modelData->getRadianceData(
+          wlid, albedoIndex, int_turbidity + turbidityStep);
 
-  // alb 0 low turb
-  std::vector<double>* data = 0;
-  tree->SetBranchAddress("datavector", &data);
-
-  TEntryList* elist = 0;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
+      res += weights[turbidityStep][albedoIndex] *
+             quinticBezier(data, 1, solar_elevation);
+    }
+  }
 
-  //  elev_matrix = dataset + (6*(int_turbidity-1));
-  //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-  res =
-      (1.0 - albedo) * (1.0 - turbidity_rem) *
-      (pow(1.0 - solar_elevation, 5.0) * data->at(0) +
-       5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation * data->at(1) +
-       10.0 * pow(1.0 - solar_elevation, 3.0) * pow(solar_elevation, 2.0) *
-           data->at(2) +
-       10.0 * pow(1.0 - solar_elevation, 2.0) * pow(solar_elevation, 3.0) *
-           data->at(3) +
-       5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) * data->at(4) +
-       pow(solar_elevation, 5.0) * data->at(5));
-
-  // alb 1 low turb
-  albedo_cut = "albedo==1";
-  c2 = albedo_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (6*10 + 6*(int_turbidity-1));
-  //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-  res +=
-      (albedo) * (1.0 - turbidity_rem) *
-      (pow(1.0 - solar_elevation, 5.0) * data->at(0) +
-       5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation * data->at(1) +
-       10.0 * pow(1.0 - solar_elevation, 3.0) * pow(solar_elevation, 2.0) *
-           data->at(2) +
-       10.0 * pow(1.0 - solar_elevation, 2.0) * pow(solar_elevation, 3.0) *
-           data->at(3) +
-       5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) * data->at(4) +
-       pow(solar_elevation, 5.0) * data->at(5));
-
-  if (int_turbidity >= 10) return res;
-
-  // alb 0 high turb
-  albedo_cut = "albedo==0";
-  c2 = albedo_cut.Data();
-
-  turbidity_cut = "turbidity==";
-  turbidity_cut += int_turbidity + 1;
-  c3 = turbidity_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (6*(int_turbidity));
-  //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-  res +=
-      (1.0 - albedo) * (turbidity_rem) *
-      (pow(1.0 - solar_elevation, 5.0) * data->at(0) +
-       5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation * data->at(1) +
-       10.0 * pow(1.0 - solar_elevation, 3.0) * pow(solar_elevation, 2.0) *
-           data->at(2) +
-       10.0 * pow(1.0 - solar_elevation, 2.0) * pow(solar_elevation, 3.0) *
-           data->at(3) +
-       5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) * data->at(4) +
-       pow(solar_elevation, 5.0) * data->at(5));
-
-  // alb 1 high turb
-  albedo_cut = "albedo==1";
-  c2 = albedo_cut.Data();
-
-  cut = c1 + c2 + c3 + c4;
-  tree->SetEntryList(0);
-  tree->Draw(">>elist", cut, "entrylist");
-  elist = (TEntryList*)gDirectory->Get("elist");
-  tree->SetEntryList(elist);
-  tree->Draw("datavector", "", "goff");
-
-  //  elev_matrix = dataset + (6*10 + 6*(int_turbidity));
-  //(1-t).^3* A1 + 3*(1-t).^2.*t * A2 + 3*(1-t) .* t .^ 2 * A3 + t.^3 * A4;
-  res +=
-      (albedo) * (turbidity_rem) *
-      (pow(1.0 - solar_elevation, 5.0) * data->at(0) +
-       5.0 * pow(1.0 - solar_elevation, 4.0) * solar_elevation * data->at(1) +
-       10.0 * pow(1.0 - solar_elevation, 3.0) * pow(solar_elevation, 2.0) *
-           data->at(2) +
-       10.0 * pow(1.0 - solar_elevation, 2.0) * pow(solar_elevation, 3.0) *
-           data->at(3) +
-       5.0 * (1.0 - solar_elevation) * pow(solar_elevation, 4.0) * data->at(4) +
-       pow(solar_elevation, 5.0) * data->at(5));
   return res;
 }
 
-void SkyFunction::init(double solar_elevation, double atmospheric_turbidity,
-                       double ground_albedo) {
-  std::vector<double> config;
+std::shared_ptr<const HosekSkyModelState> SkyFunction::cookState(
+    double solar_elevation, double atmospheric_turbidity,
+    double ground_albedo) {
+  std::shared_ptr<HosekSkyModelState> cookedState =
+      std::make_shared<HosekSkyModelState>();
 
   for (int wl = 0; wl < 11; ++wl) {
-    config = HosekSkyModel_CookConfiguration(wl, atmospheric_turbidity,
-                                             ground_albedo, solar_elevation);
-
-    state->add_config(config);
-    config.clear();
+    cookedState->add_config(HosekSkyModel_CookConfiguration(
+        wl, atmospheric_turbidity, ground_albedo, solar_elevation));
 
-    state->add_rads(HosekSkyModel_CookRadianceConfiguration(
+    cookedState->add_rads(HosekSkyModel_CookRadianceConfiguration(
         wl, atmospheric_turbidity, ground_albedo, solar_elevation));
   }
 
-  //  std::cout << "read configs, size=" << state->configurations().size() <<
-  //  std::endl;
-  ready = 1;  // precaution
+  return cookedState;
 }
 
-double SkyFunction::hosekskymodel_radiance() {
-  int low_wl = (wavelength - 320.0) / 40.0;
-  //  std::cout << "in radiance function, wavel = " << wavelength << " at index
-  //  = " << low_wl << std::endl;
-
-  if (low_wl < 0 || low_wl >= 11) return 0.0f;
-
-  double interp = fmod((wavelength - 320.0) / 40.0, 1.0);
-  std::vector<double> cfg = state->configurations().at(low_wl);
-
-  double val_low =
-      HosekSkyModel_GetRadianceInternal(cfg) * state->rads()[low_wl];
-
-  if (interp < 1e-6) return val_low;
-
-  double result = (1.0 - interp) * val_low;
-
-  if (low_wl + 1 < 11) {
-    result +=
-        interp *
-        HosekSkyModel_GetRadianceInternal(state->configurations()[low_wl + 1]) *
-        state->rads()[low_wl + 1];
-  }
+void SkyFunction::init(double solar_elevation, double atmospheric_turbidity,
+                       double ground_albedo) {
+  state = HosekSkyModelStateCache::instance()->getState(
+      solar_elevation, atmospheric_turbidity, ground_albedo);
 
-  return result;
+  //  std::cout << "read configs, size=" << state->configurations().size() <<
+  //  std::endl;
+  ready = 1;  // precaution
 }
 
-double SkyFunction::HosekSkyModel_GetRadianceInternal(
-    std::vector<double> configuration) {
-  //  std::cout << "in radiance internal config size = " << configuration.size()
-  //  << std::endl;
-  const double expM = exp(configuration[4] * gamma);
-  const double rayM = cos(gamma) * cos(gamma);
-  const double mieM = (1.0 + cos(gamma) * cos(gamma)) /
-                      pow((1.0 + configuration[8] * configuration[8] -
-                           2.0 * configuration[8] * cos(gamma)),
-                          1.5);
-  const double zenith = sqrt(cos(theta));
-
-  return (1.0 +
-          configuration[0] * exp(configuration[1] / (cos(theta) + 0.01))) *
-         (configuration[2] + configuration[3] * expM + configuration[5] * rayM +
-          configuration[6] * mieM + configuration[7] * zenith);
-}
@@ -10,49 +10,261 @@
  */
 
 #include <vector>
-#include "TFile.h"
-#include "TTree.h"
+#include <string>
+#include <array>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+/*! \brief Coefficient tables of the sky model.
+ *
+ * The tables are read once per process from HosekSkyModelData.root into flat
+ * arrays, so that cooking a configuration is direct indexing.
+ */
+class HosekSkyModelData {
+ public:
+  static HosekSkyModelData* instance();
+
+  //! Spectral channels from 320nm to 720nm in 40nm steps
+  static const int wavelengthChannelNumber = 11;
+  static const int firstChannelWavelength = 320;  // [nm]
+  static const int channelWavelengthStep = 40;    // [nm]
+  //! Integer turbidities from 1 to 10
+  static const int turbidityNumber = 10;
+  //! Nine configuration parameters at six elevation control points
+  static const int configurationSize = 54;
+  //! Radiance at six elevation control points
+  static const int radianceSize = 6;
+
+  /*! \brief Get the configuration control points for a table.
+   *
+   * @param[in] wavelengthIndex The spectral channel.
+   * @param[in] albedo The ground albedo table, either 0 or 1.
+   * @param[in] turbidity The integer turbidity, from 1 to 10.
+   *
+   * \returns The control points, with the nine parameters of each
+   *          control point contiguous.
+   */
+  const double* getConfigurationData(int wavelengthIndex, int albedo,
+                                     int turbidity) const;
+
+  /*! \brief Get the radiance control points for a table.
+   *
+   * Arguments as for getConfigurationData.
+   */
+  const double* getRadianceData(int wavelengthIndex, int albedo,
+                                int turbidity) const;
+
+ private:
+  HosekSkyModelData();
+
+  /*! \brief Read every table from the file into the flat arrays.
+   */
+  void extractFile(std::string filePath);
+
+  /*! \brief Position of a table amongst all the tables.
+   */
+  int tableIndex(int wavelengthIndex, int albedo, int turbidity) const;
+
+  std::vector<double> m_configurationData;
+  std::vector<double> m_radianceData;
+};
 
 class HosekSkyModelState {
  private:
   std::vector<std::vector<double> > configs;
   std::vector<double> radiances;
 
+  //! The configurations again with each parameter contiguous over the
+  //! channels, for the batch evaluation
+  std::array<std::vector<double>, 9> channelParameters;
+
  public:
-  std::vector<std::vector<double> > configurations() { return configs; }
-  void add_config(std::vector<double> cfg) { configs.push_back(cfg); }
-  std::vector<double> rads() { return radiances; }
+  const std::vector<std::vector<double> >& configurations() const {
+    return configs;
+  }
+  void add_config(std::vector<double> cfg) {
+    for (unsigned int p = 0; p < channelParameters.size(); p++) {
+      channelParameters[p].push_back(cfg[p]);
+    }
+    configs.push_back(cfg);
+  }
+  const std::vector<double>& rads() const { return radiances; }
   void add_rads(double val) { radiances.push_back(val); }
+
+  /*! \brief Evaluate the radiance summed over every channel at many points.
+   *
+   * Terms depending only on the direction are computed once per point and
+   * the loops over the points have no branches, so that the compiler can
+   * vectorize them.
+   *
+   * @param[in] thetas Angle of each point from the zenith [rad]
+   * @param[in] gammas Angle of each point from the sun [rad]
+   * @param[out] values The radiance at each point.
+   * @param[in] pointNumber The number of points.
+   */
+  void evaluateRadiances(const double* thetas, const double* gammas,
+                         double* values, unsigned int pointNumber) const;
+
+  /*! \brief Evaluate the radiance of each channel separately at many
+   *         points.
+   *
+   * Arguments as for evaluateRadiances, except that values receives the
+   * radiances of the first channel at every point, then of the second
+   * channel and so on.
+   */
+  void evaluateChannelRadiances(const double* thetas, const double* gammas,
+                                double* values,
+                                unsigned int pointNumber) const;
+
+  unsigned int getChannelNumber() const { return radiances.size(); }
+
+ private:
+  /*! \brief Add the radiance of a channel at each point.
+   *
+   * @param[in] channel The wavelength channel.
+   * @param[in] gammas Angle of each point from the sun [rad]
+   * @param[in] directionTerms The cosine of theta plus 0.01, the square
+   *                           root of the cosine of theta and the cosine
+   *                           of gamma, each for every point.
+   * @param[in,out] values The radiance at each point.
+   * @param[in] pointNumber The number of points.
+   */
+  void addChannelRadiances(unsigned int channel, const double* gammas,
+                           const std::vector<double>& directionTerms,
+                           double* values, unsigned int pointNumber) const;
+
+  /*! \brief Compute the terms of each point shared by all channels.
+   */
+  static std::vector<double> calculateDirectionTerms(
+      const double* thetas, const double* gammas, unsigned int pointNumber);
+};
+
+/*! \brief Cooked sky model states shared between sky functions.
+ *
+ * Neighbouring events, time segments and trees see nearly the same sun, so
+ * the states are memoized using the solar elevation, turbidity and albedo
+ * rounded to the quantization steps. A state is cooked at the rounded values,
+ * making it independent of which event asked for it first. Each thread has
+ * its own instance.
+ */
+class HosekSkyModelStateCache {
+ public:
+  static HosekSkyModelStateCache* instance();
+
+  /*! \brief Get the cooked state for the sky conditions.
+   *
+   * @param[in] solar_elevation The solar elevation [rad]
+   * @param[in] atmospheric_turbidity The turbidity, between 1 and 10.
+   * @param[in] ground_albedo The ground albedo, between 0 and 1.
+   */
+  std::shared_ptr<const HosekSkyModelState> getState(
+      double solar_elevation, double atmospheric_turbidity,
+      double ground_albedo);
+
+  /*! \brief Set the quantization applied to the sky conditions.
+   *
+   * Changing the steps empties the cache.
+   *
+   * @param[in] elevationStep The solar elevation step [rad]
+   * @param[in] turbidityStep The turbidity step.
+   * @param[in] albedoStep The ground albedo step.
+   */
+  void setQuantizationSteps(double elevationStep, double turbidityStep,
+                            double albedoStep);
+
+  /*! \brief Only reuse states cooked for exactly the same conditions.
+   *
+   * Intended for validating the quantization. Changing the mode empties the
+   * cache.
+   */
+  void setExactMatch(bool exactMatch);
+
+  /*! \brief Set the maximum number of states retained.
+   *
+   * When the limit is reached the least recently used state is discarded.
+   *
+   * @param[in] maximumSize The number of states to retain. Setting to zero
+   *                        disables the memoization.
+   */
+  void setCacheSize(unsigned int maximumSize);
+
+  /*! \brief Empty the cache.
+   */
+  void clear();
+
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+
+  /*! \brief Print the cache usage to standard output.
+   */
+  void printStatistics() const;
+
+ private:
+  HosekSkyModelStateCache();
+
+  //! Quantized (or exact) elevation, turbidity and albedo
+  typedef std::array<long long, 3> StateCacheKey;
+
+  struct StateCacheKeyHash {
+    std::size_t operator()(const StateCacheKey& key) const;
+  };
+
+  typedef std::list<StateCacheKey> StateCacheOrder;
+
+  struct StateCacheEntry {
+    std::shared_ptr<const HosekSkyModelState> state;
+    StateCacheOrder::iterator order;
+  };
+
+  typedef std::unordered_map<StateCacheKey, StateCacheEntry,
+                             StateCacheKeyHash> StateCache;
+
+  //! Memoized states and their order of use (most recent first)
+  StateCache m_stateCache;
+  StateCacheOrder m_stateCacheOrder;
+
+  double m_elevationStep;
+  double m_turbidityStep;
+  double m_albedoStep;
+  bool m_exactMatch;
+  unsigned int m_cacheSize;
+  unsigned long m_hits;
+  unsigned long m_misses;
 };
 
 class SkyFunction {
  private:
-  TFile* ff;
-  TTree* tree;
-  HosekSkyModelState* state;
-  double theta;
-  double gamma;
-  double wavelength;
+  std::shared_ptr<const HosekSkyModelState> state;
   bool ready;
 
  protected:
-  std::vector<double> HosekSkyModel_CookConfiguration(int wlid,
-                                                      double turbidity,
-                                                      double albedo,
-                                                      double solar_elevation);
-  double HosekSkyModel_CookRadianceConfiguration(int wlid, double turbidity,
-                                                 double albedo,
-                                                 double solar_elevation);
-  double hosekskymodel_radiance();
-  double HosekSkyModel_GetRadianceInternal(std::vector<double> configuration);
+  static std::vector<double> HosekSkyModel_CookConfiguration(
+      int wlid, double turbidity, double albedo, double solar_elevation);
+  static double HosekSkyModel_CookRadianceConfiguration(
+      int wlid, double turbidity, double albedo, double solar_elevation);
   void init(double solar_elevation, double atmospheric_turbidity,
             double ground_albedo);
 
  public:
+  /*! \brief Prepare the sky, reusing a cooked state from the
+   *         HosekSkyModelStateCache when available.
+   */
   SkyFunction(double solar_elevation, double atmospheric_turbidity,
               double ground_albedo);
   ~SkyFunction();
 
+  /*! \brief Get the cooked configurations used by this sky.
+   */
+  std::shared_ptr<const HosekSkyModelState> getState() const;
+
+  /*! \brief Cook the configurations of every wavelength channel, without
+   *         any caching.
+   */
+  static std::shared_ptr<const HosekSkyModelState> cookState(
+      double solar_elevation, double atmospheric_turbidity,
+      double ground_albedo);
+
   /*! \brief Evaluate the 2-dimensional SkyFunction object
    *
    * \returns the probability of light emission at a point
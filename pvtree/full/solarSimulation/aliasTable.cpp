@@ -0,0 +1,61 @@
+#include "pvtree/full/solarSimulation/aliasTable.hpp"
+
+#include <stdexcept>
+
+AliasTable::AliasTable() {}
+
+AliasTable::AliasTable(const std::vector<double>& weights) {
+  unsigned int binNumber = weights.size();
+  std::vector<double> scaledWeights(binNumber);
+  double totalWeight = 0.0;
+
+  for (unsigned int b = 0; b < binNumber; b++) {
+    scaledWeights[b] = std::max(weights[b], 0.0);
+    totalWeight += scaledWeights[b];
+  }
+
+  if (totalWeight <= 0.0) {
+    throw std::invalid_argument("Alias table needs a positive total weight.");
+  }
+
+  m_probabilities.assign(binNumber, 1.0);
+  m_aliasIndices.resize(binNumber);
+
+  std::vector<unsigned int> smallBins;
+  std::vector<unsigned int> largeBins;
+  for (unsigned int b = 0; b < binNumber; b++) {
+    scaledWeights[b] *= binNumber / totalWeight;
+    m_aliasIndices[b] = b;
+
+    if (scaledWeights[b] < 1.0) {
+      smallBins.push_back(b);
+    } else {
+      largeBins.push_back(b);
+    }
+  }
+
+  // Pair each under-full bin with an over-full one
+  while (!smallBins.empty() && !largeBins.empty()) {
+    unsigned int smallBin = smallBins.back();
+    unsigned int largeBin = largeBins.back();
+    smallBins.pop_back();
+    largeBins.pop_back();
+
+    m_probabilities[smallBin] = scaledWeights[smallBin];
+    m_aliasIndices[smallBin] = largeBin;
+
+    scaledWeights[largeBin] -= 1.0 - scaledWeights[smallBin];
+
+    if (scaledWeights[largeBin] < 1.0) {
+      smallBins.push_back(largeBin);
+    } else {
+      largeBins.push_back(largeBin);
+    }
+  }
+
+  // Remaining bins keep a probability of one (within rounding)
+}
+
+bool AliasTable::empty() const { return m_probabilities.empty(); }
+
+unsigned int AliasTable::size() const { return m_probabilities.size(); }
@@ -0,0 +1,58 @@
+#ifndef PVTREE_SOLAR_SIMULATION_ALIAS_TABLE_HPP
+#define PVTREE_SOLAR_SIMULATION_ALIAS_TABLE_HPP
+
+/*! @file
+ * \brief Constant time sampling of a discrete distribution.
+ *
+ * Uses Vose's version of the alias method, so choosing a bin takes the same
+ * time however many bins there are.
+ */
+
+#include <vector>
+#include <algorithm>
+
+class AliasTable {
+ public:
+  /*! \brief Create an empty table, which cannot be sampled.
+   */
+  AliasTable();
+
+  /*! \brief Build the table for a set of bin weights.
+   *
+   * @param[in] weights The relative weight of each bin. Negative weights
+   *                    are treated as zero.
+   */
+  explicit AliasTable(const std::vector<double>& weights);
+
+  bool empty() const;
+
+  /*! \brief Get the number of bins.
+   */
+  unsigned int size() const;
+
+  /*! \brief Choose a bin.
+   *
+   * @param[in] random A uniform random number in [0,1).
+   *
+   * \returns The index of the bin.
+   */
+  unsigned int sample(double random) const {
+    // Pick a bin uniformly then choose between it and its alias
+    unsigned int binNumber = m_probabilities.size();
+    double binChoice = random * binNumber;
+    unsigned int bin = std::min((unsigned int)binChoice, binNumber - 1);
+
+    if (binChoice - bin >= m_probabilities[bin]) {
+      bin = m_aliasIndices[bin];
+    }
+
+    return bin;
+  }
+
+ private:
+  //! Probability of keeping each bin rather than its alias
+  std::vector<double> m_probabilities;
+  std::vector<unsigned int> m_aliasIndices;
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_ALIAS_TABLE_HPP
@@ -0,0 +1,119 @@
+#include "pvtree/full/solarSimulation/skySampler.hpp"
+#include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Randomize.hh"
+
+SkySampler::SkySampler(const SkyFunction& skyFunction, unsigned int thetaBins,
+                       unsigned int gammaBins)
+    : m_thetaBins(thetaBins),
+      m_gammaBins(gammaBins),
+      m_state(skyFunction.getState()) {
+  if (m_thetaBins == 0u || m_gammaBins == 0u) {
+    throw std::invalid_argument("Sky sampler needs at least one cell.");
+  }
+
+  // Same domain as the sky function is sampled over
+  double pi = acos(-1.0);
+  m_thetaWidth = (pi / 2.0) / m_thetaBins;
+  m_gammaWidth = (2.0 * pi) / m_gammaBins;
+
+  // Cells have equal areas so the radiance at the centre is the weight
+  unsigned int cellNumber = m_thetaBins * m_gammaBins;
+  std::vector<double> thetas(cellNumber);
+  std::vector<double> gammas(cellNumber);
+  std::vector<double> weights(cellNumber, 0.0);
+
+  for (unsigned int t = 0; t < m_thetaBins; t++) {
+    for (unsigned int g = 0; g < m_gammaBins; g++) {
+      thetas[t * m_gammaBins + g] = (t + 0.5) * m_thetaWidth;
+      gammas[t * m_gammaBins + g] = (g + 0.5) * m_gammaWidth;
+    }
+  }
+
+  // All the cells and channels in a single batch
+  unsigned int channelNumber = m_state->getChannelNumber();
+  std::vector<double> channelWeights(channelNumber * cellNumber);
+  m_state->evaluateChannelRadiances(thetas.data(), gammas.data(),
+                                    channelWeights.data(), cellNumber);
+
+  for (unsigned int c = 0; c < channelNumber; c++) {
+    auto channelStart = channelWeights.begin() + c * cellNumber;
+    m_channelCellTables.push_back(
+        AliasTable(std::vector<double>(channelStart,
+                                       channelStart + cellNumber)));
+
+    // Summed in channel order, as by SkyFunction::Eval
+    double channelTotal = 0.0;
+    for (unsigned int i = 0; i < cellNumber; i++) {
+      weights[i] += channelStart[i];
+      channelTotal += channelStart[i];
+    }
+    m_channelTotals.push_back(channelTotal);
+  }
+
+  m_cellTable = AliasTable(weights);
+}
+
+void SkySampler::generateDirection(double& theta, double& gamma) const {
+  double randoms[3];
+  for (double& random : randoms) {
+    random = G4UniformRand();
+  }
+
+  sampleCell(m_cellTable, randoms, theta, gamma);
+}
+
+void SkySampler::generateDirection(double wavelength, double& theta,
+                                   double& gamma) const {
+  double randoms[4];
+  for (double& random : randoms) {
+    random = G4UniformRand();
+  }
+
+  generateDirection(wavelength, randoms, theta, gamma);
+}
+
+void SkySampler::generateDirection(double wavelength, const double* randoms,
+                                   double& theta, double& gamma) const {
+  double channelPosition =
+      (wavelength - HosekSkyModelData::firstChannelWavelength) /
+      HosekSkyModelData::channelWavelengthStep;
+  channelPosition = std::min(std::max(channelPosition, 0.0),
+                             m_channelCellTables.size() - 1.0);
+
+  // The interpolated radiance is a mixture of the two channel tables,
+  // each weighted by its share of the interpolated total
+  unsigned int channel = (unsigned int)channelPosition;
+  double fraction = channelPosition - channel;
+  if (fraction > 0.0) {
+    double lowerWeight = (1.0 - fraction) * m_channelTotals[channel];
+    double upperWeight = fraction * m_channelTotals[channel + 1];
+    if (randoms[0] * (lowerWeight + upperWeight) < upperWeight) {
+      channel++;
+    }
+  }
+
+  sampleCell(m_channelCellTables[channel], randoms + 1, theta, gamma);
+}
+
+void SkySampler::sampleCell(const AliasTable& cellTable,
+                            const double* randoms, double& theta,
+                            double& gamma) const {
+  unsigned int cell = cellTable.sample(randoms[0]);
+
+  theta = (cell / m_gammaBins + randoms[1]) * m_thetaWidth;
+  gamma = (cell % m_gammaBins + randoms[2]) * m_gammaWidth;
+}
+
+unsigned int SkySampler::getThetaBinNumber() const { return m_thetaBins; }
+
+unsigned int SkySampler::getGammaBinNumber() const { return m_gammaBins; }
+
+std::shared_ptr<const HosekSkyModelState> SkySampler::getState() const {
+  return m_state;
+}
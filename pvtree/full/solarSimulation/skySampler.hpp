@@ -0,0 +1,101 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SKY_SAMPLER_HPP
+#define PVTREE_SOLAR_SIMULATION_SKY_SAMPLER_HPP
+
+/*! @file
+ * \brief Samples the directions of diffuse light from the sky model.
+ *
+ * The sky radiance is tabulated once on a (theta, gamma) grid covering the
+ * sky dome and the cells are chosen with an alias table, so each direction
+ * takes a constant time to generate. Directions follow the same distribution
+ * as TF2::GetRandom2 over SkyFunction::Eval, i.e. proportional to the
+ * radiance in the (theta, gamma) coordinates and uniform within a cell.
+ *
+ * Each wavelength channel of the model is also tabulated separately, so
+ * that diffuse photons can be given directions consistent with their
+ * wavelength.
+ */
+
+#include "pvtree/full/solarSimulation/aliasTable.hpp"
+
+#include <memory>
+#include <vector>
+
+class SkyFunction;
+class HosekSkyModelState;
+
+class SkySampler {
+ public:
+  /*! \brief Tabulate the radiance of a sky.
+   *
+   * @param[in] skyFunction The sky to be sampled.
+   * @param[in] thetaBins Number of cells between the zenith and the horizon.
+   * @param[in] gammaBins Number of cells around the sky.
+   */
+  SkySampler(const SkyFunction& skyFunction, unsigned int thetaBins,
+             unsigned int gammaBins);
+
+  /*! \brief Generate a direction on the sky, using the Geant4 random
+   *         engine of the calling thread.
+   *
+   * @param[out] theta Angle from the zenith [rad]
+   * @param[out] gamma Angle around the sky from the sun azimuth [rad]
+   */
+  void generateDirection(double& theta, double& gamma) const;
+
+  /*! \brief Generate a direction on the sky for light of a wavelength.
+   *
+   * The radiance is interpolated linearly between the channels of the sky
+   * model, beyond which the first or last channel is used. The random
+   * numbers come from the Geant4 engine of the calling thread.
+   *
+   * @param[in] wavelength The photon wavelength [nm]
+   * @param[out] theta Angle from the zenith [rad]
+   * @param[out] gamma Angle around the sky from the sun azimuth [rad]
+   */
+  void generateDirection(double wavelength, double& theta,
+                         double& gamma) const;
+
+  /*! \brief Generate a direction on the sky for light of a wavelength
+   *         from given uniform numbers, e.g. a low discrepancy sequence.
+   *
+   * @param[in] wavelength The photon wavelength [nm]
+   * @param[in] randoms Four numbers in [0,1), choosing the channel, the
+   *                    cell and the position within the cell.
+   * @param[out] theta Angle from the zenith [rad]
+   * @param[out] gamma Angle around the sky from the sun azimuth [rad]
+   */
+  void generateDirection(double wavelength, const double* randoms,
+                         double& theta, double& gamma) const;
+
+  unsigned int getThetaBinNumber() const;
+  unsigned int getGammaBinNumber() const;
+
+  /*! \brief Get the cooked sky model state which was tabulated.
+   *
+   * Lets a sampler be reused for any sky function sharing the state.
+   */
+  std::shared_ptr<const HosekSkyModelState> getState() const;
+
+ private:
+  unsigned int m_thetaBins;
+  unsigned int m_gammaBins;
+  double m_thetaWidth;
+  double m_gammaWidth;
+  std::shared_ptr<const HosekSkyModelState> m_state;
+
+  //! Cells ordered with gamma varying fastest
+  AliasTable m_cellTable;
+
+  //! Cells weighted by the radiance of each wavelength channel
+  std::vector<AliasTable> m_channelCellTables;
+
+  //! Radiance summed over the cells of each channel
+  std::vector<double> m_channelTotals;
+
+  /*! \brief Choose a cell and a position within it.
+   */
+  void sampleCell(const AliasTable& cellTable, const double* randoms,
+                  double& theta, double& gamma) const;
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SKY_SAMPLER_HPP
@@ -0,0 +1,69 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SKY_STATE_HPP
+#define PVTREE_SOLAR_SIMULATION_SKY_STATE_HPP
+
+/*! @file
+ * \brief Snapshot of the sun and sky at a single point in time.
+ *
+ * Contains everything the primary generator needs, so that it can be
+ * prepared in advance of the particle tracking. A state is never modified
+ * once built, so it is shared by all the events and threads simulating the
+ * same time.
+ */
+
+#include "pvtree/full/solarSimulation/spectrum.hpp"
+#include "pvtree/full/solarSimulation/skySampler.hpp"
+#include <memory>
+#include <ctime>
+
+// save diagnostic state
+#pragma GCC diagnostic push
+
+// turn off the specific warning.
+#pragma GCC diagnostic ignored "-Wshadow"
+
+#include "TVector3.h"
+
+// turn the warnings back on
+#pragma GCC diagnostic pop
+
+struct SkyState {
+  //! Unit vector of the light ray from the sun
+  TVector3 lightVector;
+
+  //! Unit vectors spanning the plane normal to the light ray
+  TVector3 orthogonalVector1;
+  TVector3 orthogonalVector2;
+
+  //! Elevation angle of the sun in the sky [rad]
+  double elevationAngle;
+
+  //! Azimuthal angle of the sun in the sky, N=0.0, E=90.0 deg [rad]
+  double azimuthalAngle;
+
+  //! Surface albedo from the climate data
+  double albedo;
+
+  //! Spectrum for the current time and conditions
+  std::shared_ptr<Spectrum> spectrum;
+
+  //! Time of the snapshot, as given by Sun::getTime
+  time_t time;
+
+  //! Integrals of the spectrum [W/m^2]
+  double totalNormalIrradiance;
+  double totalDiffuseIrradiance;
+  double totalExtraterrestrialIrradiance;
+
+  //! Sky model parameters derived from the spectrum and climate
+  double turbidity;
+  double skyAlbedo;
+
+  //! Fraction of the photons generated from the sky, 1/(1+normal/diffuse),
+  //! or zero without any diffuse irradiance
+  double skyPhotonFraction;
+
+  //! Diffuse light sampler for the sky model parameters
+  std::shared_ptr<const SkySampler> skySampler;
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SKY_STATE_HPP
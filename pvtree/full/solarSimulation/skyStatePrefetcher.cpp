@@ -0,0 +1,136 @@
+#include "pvtree/full/solarSimulation/skyStatePrefetcher.hpp"
+#include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+SkyStatePrefetcher::SkyStatePrefetcher(const Sun& sun,
+                                       unsigned int timeSegments)
+    : m_sun(sun), m_timeSegments(timeSegments) {}
+
+SkyStatePrefetcher::~SkyStatePrefetcher() {
+  // Background evaluation uses the members so must finish first
+  if (m_worker.valid()) {
+    m_worker.wait();
+  }
+}
+
+void SkyStatePrefetcher::prefetch(const std::vector<time_t>& dayTimes,
+                                  bool background /* = true */) {
+  if (m_worker.valid()) {
+    m_worker.wait();
+  }
+
+  m_dayTimes = dayTimes;
+  m_stepTimes.assign(m_dayTimes.size(), 0);
+  m_skyStates.assign(m_dayTimes.size(),
+                     std::vector<std::shared_ptr<const SkyState> >(
+                         m_timeSegments));
+
+  m_dayPromises = std::vector<std::promise<void> >(m_dayTimes.size());
+  m_dayFutures.clear();
+  for (auto& dayPromise : m_dayPromises) {
+    m_dayFutures.push_back(dayPromise.get_future().share());
+  }
+
+  if (!background) {
+    evaluateDays();
+    return;
+  }
+
+  // The new thread has its own spectrum factory, so start it from
+  // the settings of this thread.
+  const SpectrumFactory* callingFactory = SpectrumFactory::instance();
+  std::promise<void> configured;
+  std::future<void> configuredFuture = configured.get_future();
+
+  m_worker = std::async(std::launch::async, [this, callingFactory,
+                                             &configured]() {
+    SpectrumFactory::instance()->copySettings(*callingFactory);
+    configured.set_value();
+
+    evaluateDays();
+
+    std::cout << "Sky state prefetch completed." << std::endl;
+    SpectrumFactory::instance()->printSpectrumCacheStatistics();
+  });
+
+  configuredFuture.wait();
+}
+
+void SkyStatePrefetcher::evaluateDays() {
+  for (unsigned int dayIndex = 0; dayIndex < m_dayTimes.size(); dayIndex++) {
+    try {
+      // Perform the simulation between the sunrise and sunset on the
+      // selected day.
+      m_sun.setDate(m_dayTimes[dayIndex]);
+      int simulationStartingTime = m_sun.getSunriseTime() * 60;  // s
+      int simulationEndingTime = m_sun.getSunsetTime() * 60;     // s
+      int simulationStepTime =
+          (double)(simulationEndingTime - simulationStartingTime) /
+          m_timeSegments;
+
+      for (unsigned int timeIndex = 0; timeIndex < m_timeSegments;
+           timeIndex++) {
+        // Set the time to the mid-point of the day-time segment
+        int segmentTime = simulationStartingTime +
+                          (int)timeIndex * simulationStepTime +
+                          floor(simulationStepTime / 2.0);
+        m_sun.setTime(segmentTime);
+
+        m_skyStates[dayIndex][timeIndex] = m_sun.getSkyState();
+      }
+
+      m_stepTimes[dayIndex] = simulationStepTime;
+      m_dayPromises[dayIndex].set_value();
+    } catch (...) {
+      // Pass the problem on to whoever is waiting for the day
+      m_dayPromises[dayIndex].set_exception(std::current_exception());
+    }
+  }
+}
+
+void SkyStatePrefetcher::waitForDay(unsigned int dayIndex) {
+  if (dayIndex >= m_dayFutures.size()) {
+    throw std::out_of_range("Day has not been prefetched.");
+  }
+
+  // Rethrows any exception from evaluating the day
+  m_dayFutures[dayIndex].get();
+}
+
+int SkyStatePrefetcher::getStepTime(unsigned int dayIndex) {
+  waitForDay(dayIndex);
+
+  return m_stepTimes[dayIndex];
+}
+
+std::shared_ptr<const SkyState> SkyStatePrefetcher::getSkyState(
+    unsigned int dayIndex, unsigned int timeIndex) {
+  waitForDay(dayIndex);
+
+  return m_skyStates[dayIndex].at(timeIndex);
+}
+
+void SkyStatePrefetcher::selectSkyState(unsigned int dayIndex,
+                                        unsigned int timeIndex) {
+  m_selectedSkyState = getSkyState(dayIndex, timeIndex);
+}
+
+std::shared_ptr<const SkyState> SkyStatePrefetcher::getSelectedSkyState()
+    const {
+  return m_selectedSkyState;
+}
+
+void SkyStatePrefetcher::selectDay(unsigned int dayIndex) {
+  waitForDay(dayIndex);
+
+  // Copy so that later days can be written whilst this one is read
+  m_selectedDaySkyStates = m_skyStates[dayIndex];
+}
+
+std::shared_ptr<const SkyState> SkyStatePrefetcher::getSelectedSkyState(
+    unsigned int timeIndex) const {
+  return m_selectedDaySkyStates.at(timeIndex);
+}
@@ -0,0 +1,115 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SKY_STATE_PREFETCHER_HPP
+#define PVTREE_SOLAR_SIMULATION_SKY_STATE_PREFETCHER_HPP
+
+/*! @file
+ * \brief Prepares the sky states for a list of days in advance.
+ *
+ * Each day between sunrise and sunset is split into a number of time
+ * segments, with the sky state evaluated at the mid-point of each segment.
+ * The states can be computed on a background thread so that running SMARTS
+ * overlaps with the particle tracking.
+ */
+
+#include "pvtree/full/solarSimulation/sun.hpp"
+#include "pvtree/full/solarSimulation/skyState.hpp"
+
+#include <vector>
+#include <memory>
+#include <future>
+#include <ctime>
+
+class SkyStatePrefetcher {
+ public:
+  /*! \brief Prepare the prefetcher.
+   *
+   * @param[in] sun The sun to copy for evaluating the sky states.
+   * @param[in] timeSegments The number of time segments per day.
+   */
+  SkyStatePrefetcher(const Sun& sun, unsigned int timeSegments);
+  ~SkyStatePrefetcher();
+
+  /*! \brief Start evaluating the sky states for every day.
+   *
+   * @param[in] dayTimes The days to be simulated.
+   * @param[in] background When true the states are evaluated on a separate
+   *                       thread, with the spectrum factory settings of
+   *                       the calling thread. Otherwise this returns once
+   *                       all the states are available.
+   */
+  void prefetch(const std::vector<time_t>& dayTimes, bool background = true);
+
+  /*! \brief Get the length of the time segments on a day.
+   *
+   * Waits for the day to be evaluated if necessary.
+   *
+   * @param[in] dayIndex The index into the list of days.
+   *
+   * \returns The time segment length [s]
+   */
+  int getStepTime(unsigned int dayIndex);
+
+  /*! \brief Get the sky state for a time segment on a day.
+   *
+   * Waits for the day to be evaluated if necessary.
+   *
+   * @param[in] dayIndex The index into the list of days.
+   * @param[in] timeIndex The time segment of the day.
+   */
+  std::shared_ptr<const SkyState> getSkyState(unsigned int dayIndex,
+                                              unsigned int timeIndex);
+
+  /*! \brief Select the sky state used for the next simulation run.
+   */
+  void selectSkyState(unsigned int dayIndex, unsigned int timeIndex);
+
+  /*! \brief Get the currently selected sky state.
+   */
+  std::shared_ptr<const SkyState> getSelectedSkyState() const;
+
+  /*! \brief Select all the time segments of a day, for runs which step
+   *         through the day event by event.
+   *
+   * Waits for the day to be evaluated if necessary.
+   *
+   * @param[in] dayIndex The index into the list of days.
+   */
+  void selectDay(unsigned int dayIndex);
+
+  /*! \brief Get a time segment of the selected day.
+   *
+   * Only reads the selection, so it may be called from worker threads
+   * whilst a run is in progress.
+   *
+   * @param[in] timeIndex The time segment of the day.
+   */
+  std::shared_ptr<const SkyState> getSelectedSkyState(
+      unsigned int timeIndex) const;
+
+ private:
+  /*! \brief Evaluate all the days in order, making each available as soon
+   *         as it is complete.
+   */
+  void evaluateDays();
+
+  /*! \brief Wait until a day has been evaluated.
+   */
+  void waitForDay(unsigned int dayIndex);
+
+  Sun m_sun;
+  unsigned int m_timeSegments;
+  std::vector<time_t> m_dayTimes;
+
+  //! Results for each day
+  std::vector<int> m_stepTimes;
+  std::vector<std::vector<std::shared_ptr<const SkyState> > > m_skyStates;
+
+  //! Signal the completion of each day
+  std::vector<std::promise<void> > m_dayPromises;
+  std::vector<std::shared_future<void> > m_dayFutures;
+  std::future<void> m_worker;
+
+  std::shared_ptr<const SkyState> m_selectedSkyState;
+  std::vector<std::shared_ptr<const SkyState> > m_selectedDaySkyStates;
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SKY_STATE_PREFETCHER_HPP
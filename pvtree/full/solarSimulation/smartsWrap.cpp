@@ -0,0 +1,36 @@
+#include "pvtree/full/solarSimulation/smartsWrap.hpp"
+
+#include <mutex>
+
+extern "C" { void runsmarts_(); }
+
+void runSmarts(const SmartsInput& input, SmartsOutput& output) {
+  // Only one SMARTS run may use the common blocks at a time
+  static std::mutex smartsMutex;
+  std::lock_guard<std::mutex> lock(smartsMutex);
+
+  generalsmarts_ = input.general;
+  inputcard1_ = input.card1;
+  inputcard2_ = input.card2;
+  inputcard3_ = input.card3;
+  inputcard4_ = input.card4;
+  inputcard5_ = input.card5;
+  inputcard6_ = input.card6;
+  inputcard7_ = input.card7;
+  inputcard7a_ = input.card7a;
+  inputcard8_ = input.card8;
+  inputcard9_ = input.card9;
+  inputcard10_ = input.card10;
+  inputcard10b_ = input.card10b;
+  inputcard11_ = input.card11;
+  inputcard12_ = input.card12;
+  inputcard13_ = input.card13;
+  inputcard14_ = input.card14;
+  inputcard15_ = input.card15;
+  inputcard16_ = input.card16;
+  inputcard17_ = input.card17;
+
+  runsmarts_();
+
+  output = smartsoutputs_;
+}
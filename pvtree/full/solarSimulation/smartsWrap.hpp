@@ -2,16 +2,18 @@
 #define PVTREE_SOLAR_SIMULATION_SMARTS_WRAP_HPP
 
 /*! @file
- * \brief Testing common block access. Will need to create a class
- *        for the management of this configuration.
+ * \brief Access to the SMARTS common blocks.
  *
+ * The common blocks are global, so direct access is restricted to
+ * runSmarts which copies a complete set of inputs in and the outputs
+ * back out again.
  */
 
 extern "C" {
 /*! \brief Additional controls for SMARTS code
  *
  */
-extern struct {
+extern struct SmartsGeneralControls {
   //! \brief = 0 print nothing, >= 1 print errors, >= 2 print debug, >=3 print
   //everything.
   int verbosity;
@@ -28,7 +30,7 @@ extern struct {
  * Also note the column/row ordering switch
  * between C++ and Fortran.
  */
-extern struct {
+extern struct SmartsOutput {
   double outputBinValues[2100][55];
   int outputBinNumber;
   int outputHeaderNumber;
@@ -38,12 +40,12 @@ extern struct {
 /*! \brief First input card which is simply a string comment.
  *
  */
-extern struct { char comment[64]; } inputcard1_;
+extern struct SmartsInputCard1 { char comment[64]; } inputcard1_;
 
 /*! \brief Input card describing the site pressure.
  *
  */
-extern struct {
+extern struct SmartsInputCard2 {
   double pressure;
   double altitude;
   double height;
@@ -54,7 +56,7 @@ extern struct {
 /*! \brief Input card selecting proper default atmosphere.
  *
  */
-extern struct {
+extern struct SmartsInputCard3 {
   double temperature;
   double relativeHumidity;
   double dailyTemperature;
@@ -66,7 +68,7 @@ extern struct {
 /*! \brief Input card selecting atmostpheric water content
  *
  */
-extern struct {
+extern struct SmartsInputCard4 {
   double precipitableWater;
   int mode;
 } inputcard4_;
@@ -74,7 +76,7 @@ extern struct {
 /*! \brief Input card selecting ozone abundance
  *
  */
-extern struct {
+extern struct SmartsInputCard5 {
   double ozoneTotalColumnAbundance;
   int altitudeCorrectionMode;
   int mode;
@@ -83,7 +85,7 @@ extern struct {
 /*! \brief Input card controlling gaseous absorption
  *         and pollution.
  */
-extern struct {
+extern struct SmartsInputCard6 {
   double formaldehydeConcentration;
   double methaneConcentration;
   double carbonMonoxideConcentration;
@@ -101,17 +103,19 @@ extern struct {
 /*! \brief Input card selecting carbon dioxide concentration.
  *
  */
-extern struct { double carbonDioxideConcentration; } inputcard7_;
+extern struct SmartsInputCard7 {
+  double carbonDioxideConcentration;
+} inputcard7_;
 
 /*! \brief Input card selecting the proper extraterrestrial
  *         spectrum.
  */
-extern struct { int extraterrestrialSpectrum; } inputcard7a_;
+extern struct SmartsInputCard7a { int extraterrestrialSpectrum; } inputcard7a_;
 
 /*! \brief Input card selecting the aerosol model.
  *
  */
-extern struct {
+extern struct SmartsInputCard8 {
   double alphaShortWavelength;
   double alphaLongWavelength;
   double singleScatteringAlbedo;
@@ -122,7 +126,7 @@ extern struct {
 /*! \brief Input card selecting the turbidity data.
  *
  */
-extern struct {
+extern struct SmartsInputCard9 {
   double aerosolOpticalDepth500;
   double angstromTurbidityCoefficient;
   double schueppTurbidityCoefficient;
@@ -135,7 +139,7 @@ extern struct {
 /*! \brief Input card selecting the correct zonal albedo.
  *
  */
-extern struct {
+extern struct SmartsInputCard10 {
   double broadbandLambertianAlbedo;
   int mode;
 } inputcard10_;
@@ -143,7 +147,7 @@ extern struct {
 /*! \brief Input card selecting tilt calculations.
  *
  */
-extern struct {
+extern struct SmartsInputCard10b {
   double tiltAngle;
   double surfaceAzimuth;
   double foregroundAlbedo;
@@ -154,7 +158,7 @@ extern struct {
 /*! \brief Input card selecting spectral range.
  *
  */
-extern struct {
+extern struct SmartsInputCard11 {
   double minWavelength;
   double maxWavelength;
   double sunCorrectionFactor;
@@ -164,7 +168,7 @@ extern struct {
 /*! \brief Input card selecting how results should
  *         be printed to file.
  */
-extern struct {
+extern struct SmartsInputCard12 {
   double minWavelength;
   double maxWavelength;
   double wavelengthInterval;
@@ -176,7 +180,7 @@ extern struct {
 /*! \brief Input card selecting circumsolar calculation.
  *
  */
-extern struct {
+extern struct SmartsInputCard13 {
   double slopeAngle;
   double halfApertureOpeningAngle;
   double limitAngle;
@@ -186,7 +190,7 @@ extern struct {
 /*! \brief Input card selecting scanning/smoothing filter.
  *
  */
-extern struct {
+extern struct SmartsInputCard14 {
   double minWavelength;
   double maxWavelength;
   double irradianceStep;
@@ -198,17 +202,17 @@ extern struct {
 /*! \brief Input card selecting illuminance, luminous efficacy
  *         and photosynthetically active radiation calculations.
  */
-extern struct { int mode; } inputcard15_;
+extern struct SmartsInputCard15 { int mode; } inputcard15_;
 
 /*! \brief Input card selecting special broadband UV calculations.
  *
  */
-extern struct { int mode; } inputcard16_;
+extern struct SmartsInputCard16 { int mode; } inputcard16_;
 
 /*! \brief Input card selecting solar position and air mass
  *         calculations.
  */
-extern struct {
+extern struct SmartsInputCard17 {
   double zenithAngle;
   double azimuthalAngle;
   double elevationAngle;
@@ -225,4 +229,44 @@ extern struct {
 } inputcard17_;
 }
 
+/*! \brief Complete set of SMARTS inputs.
+ *
+ * Allows each user of SMARTS to hold its own configuration rather than
+ * sharing the common blocks.
+ */
+struct SmartsInput {
+  SmartsGeneralControls general;
+  SmartsInputCard1 card1;
+  SmartsInputCard2 card2;
+  SmartsInputCard3 card3;
+  SmartsInputCard4 card4;
+  SmartsInputCard5 card5;
+  SmartsInputCard6 card6;
+  SmartsInputCard7 card7;
+  SmartsInputCard7a card7a;
+  SmartsInputCard8 card8;
+  SmartsInputCard9 card9;
+  SmartsInputCard10 card10;
+  SmartsInputCard10b card10b;
+  SmartsInputCard11 card11;
+  SmartsInputCard12 card12;
+  SmartsInputCard13 card13;
+  SmartsInputCard14 card14;
+  SmartsInputCard15 card15;
+  SmartsInputCard16 card16;
+  SmartsInputCard17 card17;
+};
+
+/*! \brief Run SMARTS with the specified inputs.
+ *
+ * SMARTS keeps its state in the common blocks and saved local variables,
+ * so runs are serialized. The inputs are copied into the common blocks and
+ * the outputs copied back out whilst holding a lock, which makes this safe
+ * to call from any thread.
+ *
+ * @param[in] input The complete SMARTS configuration.
+ * @param[out] output Filled with the results of the run.
+ */
+void runSmarts(const SmartsInput& input, SmartsOutput& output);
+
 #endif  // PVTREE_SOLAR_SIMULATION_SMARTS_WRAP_HPP
@@ -0,0 +1,101 @@
+#include "pvtree/full/solarSimulation/sobolSequence.hpp"
+
+#include <stdexcept>
+
+namespace {
+// Primitive polynomials and initial direction numbers of Joe and Kuo for
+// the dimensions after the first, which is the van der Corput sequence.
+const unsigned int kPolynomialDegrees[] = {1u, 2u, 3u};
+const std::uint32_t kPolynomialCoefficients[] = {0u, 1u, 1u};
+const std::uint32_t kInitialDirections[][3] = {
+    {1u, 0u, 0u}, {1u, 3u, 0u}, {1u, 3u, 1u}};
+
+std::uint32_t reverseBits(std::uint32_t value) {
+  value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+  value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+  value = ((value >> 4) & 0x0f0f0f0fu) | ((value & 0x0f0f0f0fu) << 4);
+  value = ((value >> 8) & 0x00ff00ffu) | ((value & 0x00ff00ffu) << 8);
+  return (value >> 16) | (value << 16);
+}
+}
+
+SobolSequence::SobolSequence(std::uint32_t seed /* = 0u */) : m_seed(seed) {
+  for (unsigned int bit = 0; bit < 32; bit++) {
+    m_directions[0][bit] = 1u << (31 - bit);
+  }
+
+  for (unsigned int d = 1; d < dimensionNumber; d++) {
+    unsigned int degree = kPolynomialDegrees[d - 1];
+    std::uint32_t coefficients = kPolynomialCoefficients[d - 1];
+
+    for (unsigned int bit = 0; bit < 32; bit++) {
+      if (bit < degree) {
+        m_directions[d][bit] = kInitialDirections[d - 1][bit] << (31 - bit);
+        continue;
+      }
+
+      std::uint32_t direction = m_directions[d][bit - degree];
+      direction ^= direction >> degree;
+      for (unsigned int k = 1; k < degree; k++) {
+        if ((coefficients >> (degree - 1 - k)) & 1u) {
+          direction ^= m_directions[d][bit - k];
+        }
+      }
+      m_directions[d][bit] = direction;
+    }
+  }
+}
+
+void SobolSequence::setSeed(std::uint32_t seed) { m_seed = seed; }
+
+double SobolSequence::sample(std::uint32_t index, unsigned int dimension,
+                             unsigned int group) const {
+  if (dimension >= dimensionNumber) {
+    throw std::out_of_range("Sobol sequence dimension is too large.");
+  }
+
+  // Shuffle the order of the points separately for each group
+  std::uint32_t groupSeed = hashCombine(m_seed, group);
+  std::uint32_t shuffledIndex = nestedUniformScramble(index, groupSeed);
+
+  std::uint32_t value = 0u;
+  for (unsigned int bit = 0; shuffledIndex != 0u;
+       bit++, shuffledIndex >>= 1) {
+    if (shuffledIndex & 1u) {
+      value ^= m_directions[dimension][bit];
+    }
+  }
+
+  value = nestedUniformScramble(value, hashCombine(groupSeed, dimension + 1));
+
+  // Divide by 2^32
+  return value * 2.3283064365386963e-10;
+}
+
+std::uint32_t SobolSequence::nestedUniformScramble(std::uint32_t value,
+                                                   std::uint32_t seed) {
+  // Laine-Karras style permutation, with the improved constants of
+  // N. Vegdahl, acting on the reversed bits so that each bit is only
+  // changed by the bits above it.
+  value = reverseBits(value);
+  value ^= value * 0x3d20adeau;
+  value += seed;
+  value *= (seed >> 16) | 1u;
+  value ^= value * 0x05526c56u;
+  value ^= value * 0x53a22864u;
+  return reverseBits(value);
+}
+
+std::uint32_t SobolSequence::hashCombine(std::uint32_t seed,
+                                         std::uint32_t value) {
+  std::uint32_t hash = seed ^ (value + (seed << 6) + (seed >> 2));
+
+  hash ^= hash >> 17;
+  hash *= 0xed5ad4bbu;
+  hash ^= hash >> 11;
+  hash *= 0xac4c1b51u;
+  hash ^= hash >> 15;
+  hash *= 0x31848babu;
+  hash ^= hash >> 14;
+  return hash;
+}
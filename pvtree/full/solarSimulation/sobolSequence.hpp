@@ -0,0 +1,60 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SOBOL_SEQUENCE_HPP
+#define PVTREE_SOLAR_SIMULATION_SOBOL_SEQUENCE_HPP
+
+/*! @file
+ * \brief Owen scrambled Sobol points for low discrepancy photon sampling.
+ *
+ * Follows the hash based scrambling of Burley, "Practical Hash-based Owen
+ * Scrambling", JCGT 9(4) 2020. Each group of up to four dimensions uses the
+ * first four Sobol dimensions with its own scramble and shuffled point
+ * order, so any number of groups can be used without the groups being
+ * correlated. Every point is uniformly distributed for any seed, so
+ * estimates averaged over seeds remain unbiased.
+ */
+
+#include <cstdint>
+
+class SobolSequence {
+ public:
+  //! Number of dimensions in each group
+  static const unsigned int dimensionNumber = 4u;
+
+  /*! \brief Prepare the sequence.
+   *
+   * @param[in] seed Chooses the randomisation of the points.
+   */
+  explicit SobolSequence(std::uint32_t seed = 0u);
+
+  /*! \brief Choose a new randomisation of the points.
+   */
+  void setSeed(std::uint32_t seed);
+
+  /*! \brief Get a coordinate of a point.
+   *
+   * @param[in] index The index of the point in the sequence.
+   * @param[in] dimension The dimension within the group, below
+   *                      dimensionNumber.
+   * @param[in] group The group of dimensions.
+   *
+   * \returns A number in [0,1).
+   */
+  double sample(std::uint32_t index, unsigned int dimension,
+                unsigned int group) const;
+
+ private:
+  std::uint32_t m_seed;
+
+  //! Direction numbers of each dimension
+  std::uint32_t m_directions[dimensionNumber][32];
+
+  /*! \brief Randomly permute the elementary intervals of a 32-bit number.
+   */
+  static std::uint32_t nestedUniformScramble(std::uint32_t value,
+                                             std::uint32_t seed);
+
+  /*! \brief Mix two numbers into a well distributed seed.
+   */
+  static std::uint32_t hashCombine(std::uint32_t seed, std::uint32_t value);
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SOBOL_SEQUENCE_HPP
@@ -15,8 +15,10 @@
 
 #include "CLHEP/Units/SystemOfUnits.h"
 #include "CLHEP/Units/PhysicalConstants.h"
+#include "Randomize.hh"
 
-Spectrum::Spectrum(std::string inputFilePath) : m_dataPrecision(10000) {
+Spectrum::Spectrum(std::string inputFilePath)
+    : m_externalValues(0), m_binNumber(0), m_dataPrecision(10000) {
   // Need to start by finding the file
   // First try to find it w.r.t the local directory
   std::ifstream localTest(inputFilePath.c_str());
@@ -24,6 +26,7 @@ Spectrum::Spectrum(std::string inputFilePath) : m_dataPrecision(10000) {
   if (localTest.is_open()) {
     // If found use the local file
     extractFile(localTest);
+    calculateIntegrals();
     return;
   }
 
@@ -34,6 +37,7 @@ Spectrum::Spectrum(std::string inputFilePath) : m_dataPrecision(10000) {
 
   if (shareTest.is_open()) {
     extractFile(shareTest);
+    calculateIntegrals();
     return;
   }
 
@@ -45,45 +49,224 @@ Spectrum::Spectrum(std::string inputFilePath) : m_dataPrecision(10000) {
 
 Spectrum::Spectrum(std::vector<std::string> columnNames,
                    std::map<std::string, std::vector<double>> data)
-    : m_data(data), m_columnNames(columnNames), m_dataPrecision(10) {}
+    : m_columnNames(columnNames),
+      m_externalValues(0),
+      m_binNumber(0),
+      m_dataPrecision(10) {
+  if (!m_columnNames.empty()) {
+    m_binNumber = data[m_columnNames[0]].size();
+  }
+
+  m_values.reserve(m_columnNames.size() * m_binNumber);
+  for (auto& name : m_columnNames) {
+    const std::vector<double>& column = data[name];
+
+    if (column.size() != m_binNumber) {
+      throw std::invalid_argument("Spectrum columns differ in length.");
+    }
+
+    m_values.insert(m_values.end(), column.begin(), column.end());
+  }
+
+  calculateIntegrals();
+}
+
+Spectrum::Spectrum(std::vector<std::string> columnNames,
+                   std::vector<double> values)
+    : m_columnNames(columnNames),
+      m_values(values),
+      m_externalValues(0),
+      m_binNumber(0),
+      m_dataPrecision(10) {
+  if (!m_columnNames.empty()) {
+    m_binNumber = m_values.size() / m_columnNames.size();
+  }
+
+  if (m_binNumber * m_columnNames.size() != m_values.size()) {
+    throw std::invalid_argument("Spectrum columns differ in length.");
+  }
+
+  calculateIntegrals();
+}
+
+Spectrum::Spectrum(std::vector<std::string> columnNames, const double* values,
+                   unsigned int binNumber, std::shared_ptr<const void> storage)
+    : m_columnNames(columnNames),
+      m_externalValues(values),
+      m_externalStorage(storage),
+      m_binNumber(binNumber),
+      m_dataPrecision(10) {
+  if (m_externalValues == 0 && !m_columnNames.empty() && m_binNumber > 0) {
+    throw std::invalid_argument("Spectrum has no values.");
+  }
+
+  calculateIntegrals();
+}
 
 Spectrum::~Spectrum() {}
 
 std::vector<std::tuple<double, double>> Spectrum::generatePhotons(
     unsigned int photonNumber) {
-  auto normalIrradianceHistogram = getHistogram("Direct_normal_irradiance");
-
   std::vector<std::tuple<double, double>> generatedPhotons;
 
   // Need to include width of bin!
-  double totalIrradianceSum = normalIrradianceHistogram->Integral("width");
+  double totalIrradianceSum = getIntegral(DIRECT_NORMAL_IRRADIANCE);
 
-  for (unsigned int r = 0; r < photonNumber; r++) {
-    double wavelength = normalIrradianceHistogram->GetRandom();  // nm
-
-    // Convert the wavelength (nm) into energy (eV)
-    double energy =
-        CLHEP::h_Planck * CLHEP::c_light / (wavelength * CLHEP::nm);  // Joules
-    energy /= CLHEP::eV;  // to eV
+  std::vector<double> photonEnergies(photonNumber);
+  generatePhotonEnergies(photonEnergies.data(), photonNumber);
 
+  for (double energy : photonEnergies) {
     generatedPhotons.push_back(std::make_tuple(energy, totalIrradianceSum));
   }
 
   return generatedPhotons;
 }
 
+void Spectrum::generatePhotonEnergies(double* photonEnergies,
+                                      unsigned int photonNumber,
+                                      StandardColumn column) {
+  prepareSampling(column);
+
+  const AliasTable& aliasTable = m_aliasTables.find(column)->second;
+
+  // Convert the wavelength (nm) into energy (eV)
+  const double energyWavelengthProduct =
+      CLHEP::h_Planck * CLHEP::c_light / (CLHEP::nm * CLHEP::eV);
+
+  for (unsigned int p = 0; p < photonNumber; p++) {
+    unsigned int bin = aliasTable.sample(G4UniformRand());
+
+    // Uniformly within the selected bin, as for TH1::GetRandom
+    double wavelength =
+        m_aliasBinLowEdges[bin] + G4UniformRand() * m_aliasBinWidths[bin];
+
+    photonEnergies[p] = energyWavelengthProduct / wavelength;
+  }
+}
+
+void Spectrum::prepareSampling(StandardColumn column) {
+  if (m_aliasTables.count(column) == 0) {
+    createAliasTable(column);
+  }
+}
+
+void Spectrum::createAliasTable(StandardColumn column) {
+  auto irradianceHistogram = getHistogram(getColumnName(column));
+  unsigned int binNumber = irradianceHistogram->GetNbinsX();
+
+  // Same bin weights as TH1::GetRandom (the bin contents)
+  std::vector<double> weights(binNumber);
+  double totalWeight = 0.0;
+
+  m_aliasBinLowEdges.resize(binNumber);
+  m_aliasBinWidths.resize(binNumber);
+  for (unsigned int b = 0; b < binNumber; b++) {
+    weights[b] = std::max(irradianceHistogram->GetBinContent(b + 1), 0.0);
+    totalWeight += weights[b];
+    m_aliasBinLowEdges[b] = irradianceHistogram->GetBinLowEdge(b + 1);
+    m_aliasBinWidths[b] = irradianceHistogram->GetBinWidth(b + 1);
+  }
+
+  if (totalWeight <= 0.0) {
+    throw std::runtime_error("Can't sample photons from an empty spectrum.");
+  }
+
+  m_aliasTables[column] = AliasTable(weights);
+}
+
 std::vector<std::string> Spectrum::getSMARTSColumnNames() const {
   return m_columnNames;
 }
 
 std::map<std::string, std::vector<double>> Spectrum::getSMARTSData() const {
-  return m_data;
+  std::map<std::string, std::vector<double>> data;
+
+  for (unsigned int c = 0; c < m_columnNames.size(); c++) {
+    ColumnView column = getColumn(c);
+    data[m_columnNames[c]] = std::vector<double>(column.begin(), column.end());
+  }
+
+  return data;
+}
+
+const std::string& Spectrum::getColumnName(StandardColumn column) {
+  static const std::vector<std::string> standardColumnNames = {
+      "Wvlgth", "Extraterrestrial_spectrm", "Direct_normal_irradiance",
+      "Difuse_horizn_irradiance"};
+
+  return standardColumnNames[column];
+}
+
+int Spectrum::getColumnIndex(const std::string& columnName) const {
+  auto column = std::find(m_columnNames.begin(), m_columnNames.end(),
+                          columnName);
+
+  if (column == m_columnNames.end()) {
+    return -1;
+  }
+
+  return column - m_columnNames.begin();
+}
+
+unsigned int Spectrum::getBinNumber() const { return m_binNumber; }
+
+Spectrum::ColumnView Spectrum::getColumn(StandardColumn column) const {
+  return getColumn(getColumnName(column));
+}
+
+Spectrum::ColumnView Spectrum::getColumn(const std::string& columnName) const {
+  int columnIndex = getColumnIndex(columnName);
+
+  if (columnIndex < 0) {
+    throwMissingColumn(columnName);
+  }
+
+  return getColumn((unsigned int)columnIndex);
+}
+
+Spectrum::ColumnView Spectrum::getColumn(unsigned int columnIndex) const {
+  if (columnIndex >= m_columnNames.size()) {
+    throw std::out_of_range("Spectrum column index out of range.");
+  }
+
+  const double* values =
+      m_externalValues != 0 ? m_externalValues : m_values.data();
+
+  return ColumnView(values + columnIndex * m_binNumber, m_binNumber);
+}
+
+double Spectrum::getIntegral(StandardColumn column) const {
+  return getIntegral(getColumnName(column));
+}
+
+double Spectrum::getIntegral(const std::string& columnName) const {
+  int columnIndex = getColumnIndex(columnName);
+
+  if (columnIndex < 0) {
+    throwMissingColumn(columnName);
+  }
+
+  if ((unsigned int)columnIndex >= m_columnIntegrals.size()) {
+    throw std::string("Spectrum has no wavelength binning to integrate.");
+  }
+
+  return m_columnIntegrals[columnIndex];
 }
 
-bool Spectrum::operator==(const Spectrum& otherSpectrum) {
+void Spectrum::throwMissingColumn(const std::string& columnName) const {
+  std::cerr << "SMARTS has not produced the column: " << columnName
+            << std::endl;
+  std::cerr << "SMARTS has produced the following columns: - " << std::endl;
+  for (auto name : m_columnNames) {
+    std::cerr << "\t" << name << std::endl;
+  }
+
+  throw std::string("SMARTS has not produced the column: ") + columnName;
+}
+
+bool Spectrum::operator==(const Spectrum& otherSpectrum) const {
   // Check that the column names are the same
-  if (this->getSMARTSColumnNames().size() !=
-      otherSpectrum.getSMARTSColumnNames().size()) {
+  if (this->m_columnNames.size() != otherSpectrum.m_columnNames.size()) {
     return false;
   }
 
@@ -93,20 +276,21 @@ bool Spectrum::operator==(const Spectrum& otherSpectrum) {
     return false;
   }
 
+  // Same columns so the data has the same layout
+  if (this->m_binNumber != otherSpectrum.m_binNumber) {
+    return false;
+  }
+
   // Get the largest data precision check as SMARTS stores < float precision
   // in the export file.
   int largestPrecision = this->m_dataPrecision > otherSpectrum.m_dataPrecision
                              ? this->m_dataPrecision
                              : otherSpectrum.m_dataPrecision;
 
-  // Check that the data values per column are the same
-  for (auto& name : this->getSMARTSColumnNames()) {
-    std::vector<double> data1 = this->getSMARTSData()[name];
-    std::vector<double> data2 = otherSpectrum.getSMARTSData()[name];
-
-    if (data1.size() != data2.size()) {
-      return false;
-    }
+  // Check that the data values are the same
+  for (unsigned int c = 0; c < m_columnNames.size(); c++) {
+    ColumnView data1 = this->getColumn(c);
+    ColumnView data2 = otherSpectrum.getColumn(c);
 
     for (unsigned int x = 0; x < data1.size(); x++) {
       if (!almost_equal(float(data1[x]), float(data2[x]), largestPrecision)) {
@@ -119,7 +303,7 @@ bool Spectrum::operator==(const Spectrum& otherSpectrum) {
   return true;
 }
 
-bool Spectrum::operator!=(const Spectrum& otherSpectrum) {
+bool Spectrum::operator!=(const Spectrum& otherSpectrum) const {
   return !(*this == otherSpectrum);
 }
 
@@ -128,6 +312,9 @@ void Spectrum::extractFile(std::ifstream& inputFile) {
 
   bool extractingHeader = true;
 
+  // Rows are read in file order then rearranged into columns
+  std::vector<double> rowValues;
+
   while (inputFile.getline(line, 512)) {
     std::string currentLine(line);
     std::stringstream currentLineStream(currentLine);
@@ -139,11 +326,6 @@ void Spectrum::extractFile(std::ifstream& inputFile) {
         m_columnNames.push_back(columnName);
       }
 
-      // Create vector<double>s to store results
-      for (auto& column : m_columnNames) {
-        m_data[column] = std::vector<double>();
-      }
-
       extractingHeader = false;
       continue;
     }
@@ -158,47 +340,44 @@ void Spectrum::extractFile(std::ifstream& inputFile) {
         throw std::exception();
       }
 
-      m_data[m_columnNames[columnIndex]].push_back(std::stod(rowValue));
+      rowValues.push_back(std::stod(rowValue));
       columnIndex++;
     }
+
+    if (columnIndex != 0 && columnIndex != m_columnNames.size()) {
+      std::cout << "Current line has too few values: - \n" << currentLine
+                << std::endl;
+      throw std::exception();
+    }
+  }
+
+  unsigned int columnNumber = m_columnNames.size();
+  m_binNumber = columnNumber > 0 ? rowValues.size() / columnNumber : 0;
+  m_values.resize(rowValues.size());
+
+  for (unsigned int b = 0; b < m_binNumber; b++) {
+    for (unsigned int c = 0; c < columnNumber; c++) {
+      m_values[c * m_binNumber + b] = rowValues[b * columnNumber + c];
+    }
   }
 }
 
 void Spectrum::createHistogram(std::string columnName) {
+  ColumnView wavelengths = getColumn(WAVELENGTH);
+  ColumnView values = getColumn(columnName);
+
   // Get the binning
-  std::vector<double> binWidths;
-  std::vector<double> binValues;
+  std::vector<double> binWidths = calculateBinWidths();
+  std::vector<double> binValues(values.begin(), values.end());
   std::vector<double> binLowEdges;
 
-  // Fill the first bin width as a special case
-  binWidths.push_back(m_data[std::string("Wvlgth")][1] -
-                      m_data[std::string("Wvlgth")][0]);
-  binValues.push_back(m_data[columnName][0]);
-  binLowEdges.push_back(m_data[std::string("Wvlgth")][0] - binWidths[0] / 2.0);
-
-  for (unsigned int b = 1; b < m_data[std::string("Wvlgth")].size(); b++) {
-    double distanceToPreviousBinCentre =
-        m_data[std::string("Wvlgth")][b] - m_data[std::string("Wvlgth")][b - 1];
-
-    // Use the previous bin size to get the next bin size.
-    double currentBinHalfWidth =
-        distanceToPreviousBinCentre - (binWidths.back() / 2.0);
-
-    if (currentBinHalfWidth < 0.0) {
-      std::cerr << "Can't use negative bin widths. Logic problem in irradiance "
-                   "histogram creation!" << std::endl;
-      throw;
-    }
-
-    binWidths.push_back(2.0 * currentBinHalfWidth);
-    binValues.push_back(m_data[columnName][b]);
-    binLowEdges.push_back(m_data[std::string("Wvlgth")][b] -
-                          binWidths[b] / 2.0);
+  for (unsigned int b = 0; b < wavelengths.size(); b++) {
+    binLowEdges.push_back(wavelengths[b] - binWidths[b] / 2.0);
   }
 
   // Add one additional low bin edge (and zero value)
   binValues.push_back(0.0);
-  binLowEdges.push_back(m_data[std::string("Wvlgth")].back() +
+  binLowEdges.push_back(wavelengths[wavelengths.size() - 1] +
                         binWidths.back() / 2.0);
 
   // Build an array of low edges
@@ -225,6 +404,54 @@ void Spectrum::createHistogram(std::string columnName) {
   delete[] binLowEdgeArray;
 }
 
+std::vector<double> Spectrum::calculateBinWidths() const {
+  ColumnView wavelengths = getColumn(WAVELENGTH);
+  std::vector<double> binWidths;
+
+  // Fill the first bin width as a special case
+  binWidths.push_back(wavelengths[1] - wavelengths[0]);
+
+  for (unsigned int b = 1; b < wavelengths.size(); b++) {
+    double distanceToPreviousBinCentre = wavelengths[b] - wavelengths[b - 1];
+
+    // Use the previous bin size to get the next bin size.
+    double currentBinHalfWidth =
+        distanceToPreviousBinCentre - (binWidths.back() / 2.0);
+
+    if (currentBinHalfWidth < 0.0) {
+      std::cerr << "Can't use negative bin widths. Logic problem in irradiance "
+                   "histogram creation!" << std::endl;
+      throw std::string("Negative spectrum bin width.");
+    }
+
+    binWidths.push_back(2.0 * currentBinHalfWidth);
+  }
+
+  return binWidths;
+}
+
+void Spectrum::calculateIntegrals() {
+  m_columnIntegrals.clear();
+
+  // Binning is only defined with at least two wavelengths
+  if (getColumnIndex(getColumnName(WAVELENGTH)) < 0 || m_binNumber < 2) {
+    return;
+  }
+
+  std::vector<double> binWidths = calculateBinWidths();
+
+  for (unsigned int c = 0; c < m_columnNames.size(); c++) {
+    ColumnView column = getColumn(c);
+    double integral = 0.0;
+
+    for (unsigned int b = 0; b < m_binNumber; b++) {
+      integral += column[b] * binWidths[b];
+    }
+
+    m_columnIntegrals.push_back(integral);
+  }
+}
+
 std::shared_ptr<TH1D> Spectrum::getHistogram(std::string columnName) {
   // Check if already created
   if (m_histograms.find(columnName) != m_histograms.end()) {
@@ -232,16 +459,8 @@ std::shared_ptr<TH1D> Spectrum::getHistogram(std::string columnName) {
   }
 
   // Check if the column requested was actually produced by SMARTS
-  if (std::find(begin(m_columnNames), end(m_columnNames), columnName) ==
-      m_columnNames.end()) {
-    std::cerr << "SMARTS has not produced the column: " << columnName
-              << std::endl;
-    std::cerr << "SMARTS has produced the following columns: - " << std::endl;
-    for (auto name : m_columnNames) {
-      std::cerr << "\t" << name << std::endl;
-    }
-
-    throw std::string("SMARTS has not produced the column: ") + columnName;
+  if (getColumnIndex(columnName) < 0) {
+    throwMissingColumn(columnName);
   }
 
   // Finally try creating it
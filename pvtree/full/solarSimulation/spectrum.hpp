@@ -9,21 +9,112 @@
  */
 
 #include <string>
+#include <cstddef>
 #include <iosfwd>
 #include <vector>
 #include <map>
 #include <tuple>
 #include <memory>
 
+#include "pvtree/full/solarSimulation/aliasTable.hpp"
+
 class TH1D;
 
 class Spectrum {
  public:
+  /*! \brief Columns produced by SMARTS with the default configuration.
+   */
+  enum StandardColumn {
+    WAVELENGTH,
+    EXTRATERRESTRIAL_SPECTRUM,
+    DIRECT_NORMAL_IRRADIANCE,
+    DIFFUSE_HORIZONTAL_IRRADIANCE
+  };
+
+  /*! \brief Read-only view of the bin values of a single column.
+   *
+   * Only valid for the lifetime of the spectrum it was obtained from.
+   */
+  class ColumnView {
+   public:
+    ColumnView() : m_data(0), m_size(0) {}
+    ColumnView(const double* data, std::size_t size)
+        : m_data(data), m_size(size) {}
+
+    const double* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const double* begin() const { return m_data; }
+    const double* end() const { return m_data + m_size; }
+    double operator[](std::size_t index) const { return m_data[index]; }
+
+   private:
+    const double* m_data;
+    std::size_t m_size;
+  };
+
   explicit Spectrum(std::string inputFilePath);
   Spectrum(std::vector<std::string> columnNames,
            std::map<std::string, std::vector<double> > data);
+
+  /*! \brief Construct from columnar data.
+   *
+   * @param[in] columnNames The SMARTS names of each column.
+   * @param[in] values The bin values of all the columns, with the bins of
+   *                   each column stored contiguously in the same order
+   *                   as the column names.
+   */
+  Spectrum(std::vector<std::string> columnNames, std::vector<double> values);
+
+  /*! \brief Construct from columnar data owned elsewhere, e.g. a memory
+   *         mapped spectrum archive.
+   *
+   * The values are not copied.
+   *
+   * @param[in] columnNames The SMARTS names of each column.
+   * @param[in] values The bin values of all the columns in the same layout
+   *                   as the vector constructor.
+   * @param[in] binNumber The number of bins in each column.
+   * @param[in] storage Keeps the memory holding the values alive for the
+   *                    lifetime of the spectrum.
+   */
+  Spectrum(std::vector<std::string> columnNames, const double* values,
+           unsigned int binNumber, std::shared_ptr<const void> storage);
   ~Spectrum();
 
+  /*! \brief Get the SMARTS name of a standard column.
+   */
+  static const std::string& getColumnName(StandardColumn column);
+
+  /*! \brief Get the position of a column.
+   *
+   * \returns The column index or -1 if the column is not present.
+   */
+  int getColumnIndex(const std::string& columnName) const;
+
+  /*! \brief Get the number of wavelength bins.
+   */
+  unsigned int getBinNumber() const;
+
+  /*! \brief Access the bin values of a column without copying.
+   *
+   * Throws if the column was not produced by SMARTS.
+   */
+  ColumnView getColumn(StandardColumn column) const;
+  ColumnView getColumn(const std::string& columnName) const;
+  ColumnView getColumn(unsigned int columnIndex) const;
+
+  /*! \brief Get the integral of a column over wavelength.
+   *
+   * Calculated once when the spectrum is built, giving the same value as
+   * Integral("width") of the column histogram, e.g. the total irradiance
+   * [W/m^2] for the irradiance columns.
+   *
+   * Throws if the column was not produced by SMARTS.
+   */
+  double getIntegral(StandardColumn column) const;
+  double getIntegral(const std::string& columnName) const;
+
   /*! \brief Produce a set of photons with the
    *         bias of more photons in regions with
    *         higher irradiance.
@@ -36,6 +127,33 @@ class Spectrum {
   std::vector<std::tuple<double, double> > generatePhotons(
       unsigned int photonNumber);
 
+  /*! \brief Fill a buffer with photon energies sampled from an irradiance
+   *         column, by default the direct normal irradiance.
+   *
+   * Uses an alias table built once per spectrum and column, so each photon
+   * takes a constant time to generate regardless of the number of bins.
+   * The random numbers come from the Geant4 engine of the calling thread.
+   *
+   * @param[out] photonEnergies Buffer to be filled with photon energies in eV.
+   * @param[in] photonNumber The number of photons to generate, the buffer
+   *                         must be at least this long.
+   * @param[in] column The irradiance to follow.
+   */
+  void generatePhotonEnergies(double* photonEnergies, unsigned int photonNumber,
+                              StandardColumn column = DIRECT_NORMAL_IRRADIANCE);
+
+  /*! \brief Build the alias table of a column in advance.
+   *
+   * Generating energies from a column which has been prepared does not
+   * modify the spectrum, so it can then be shared between threads.
+   *
+   * Throws std::runtime_error if the column has no positive bins, so
+   * callers should check the column integral first.
+   *
+   * @param[in] column The irradiance to be sampled.
+   */
+  void prepareSampling(StandardColumn column);
+
   /*! \brief Retrieve the raw SMARTS column names
    *         for the spectrum
    */
@@ -46,7 +164,8 @@ class Spectrum {
    *         the requested variables.
    *
    * \returns a map containing bin values for each variable
-   *          where the map is indexed by the column name.
+   *          where the map is indexed by the column name. This is a
+   *          copy, so prefer getColumn for repeated access.
    */
   std::map<std::string, std::vector<double> > getSMARTSData() const;
 
@@ -61,12 +180,12 @@ class Spectrum {
   /*! \brief Check that two spectra are the same
    *         within the precision of the data.
    */
-  bool operator==(const Spectrum& otherSpectrum);
+  bool operator==(const Spectrum& otherSpectrum) const;
 
   /*! \brief Check that two spectra are not the same
    *         within the precision of the data.
    */
-  bool operator!=(const Spectrum& otherSpectrum);
+  bool operator!=(const Spectrum& otherSpectrum) const;
 
  private:
   /*! \brief Extract the spectra definition
@@ -80,17 +199,52 @@ class Spectrum {
    */
   void createHistogram(std::string columnName);
 
-  //! The raw data from the file
-  std::map<std::string, std::vector<double> > m_data;
+  /*! \brief Get the width of each wavelength bin.
+   *
+   * The bins are centred on the wavelength values and stop at the centre
+   * of the neighbouring bins.
+   */
+  std::vector<double> calculateBinWidths() const;
+
+  /*! \brief Integrate every column over wavelength.
+   */
+  void calculateIntegrals();
+
+  /*! \brief Build the alias table for sampling the histogram of a
+   *         column.
+   */
+  void createAliasTable(StandardColumn column);
+
+  /*! \brief Report a column which SMARTS has not produced.
+   */
+  void throwMissingColumn(const std::string& columnName) const;
 
-  //! Store the column names seperately as well
+  //! The column names in storage order
   std::vector<std::string> m_columnNames;
 
+  //! Bin values with each column stored contiguously
+  std::vector<double> m_values;
+
+  //! Bin values held outside of the spectrum, in place of m_values
+  const double* m_externalValues;
+  std::shared_ptr<const void> m_externalStorage;
+
+  //! Number of wavelength bins in each column
+  unsigned int m_binNumber;
+
+  //! Integral over wavelength of each column
+  std::vector<double> m_columnIntegrals;
+
   //! Store the histograms by name
   std::map<std::string, std::shared_ptr<TH1D> > m_histograms;
 
   //! Precision of import format (to handle standard smarts export)
   int m_dataPrecision;
+
+  //! Alias tables for the bins of the sampled columns
+  std::map<StandardColumn, AliasTable> m_aliasTables;
+  std::vector<double> m_aliasBinLowEdges;
+  std::vector<double> m_aliasBinWidths;
 };
 
 #endif  // PVTREE_SOLAR_SIMULATION_SPECTRUM
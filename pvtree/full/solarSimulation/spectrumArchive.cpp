@@ -0,0 +1,243 @@
+#include "pvtree/full/solarSimulation/spectrumArchive.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+const char archiveIdentifier[8] = {'P', 'V', 'S', 'P', 'E', 'C', 'A', 'R'};
+const std::uint32_t archiveVersion = 2;
+}
+
+SpectrumArchive::SpectrumArchive(std::string inputFilePath)
+    : m_mappingSize(0), m_header(0), m_times(0), m_values(0) {
+  int fileDescriptor = open(inputFilePath.c_str(), O_RDONLY);
+
+  if (fileDescriptor < 0) {
+    std::cerr << "SpectrumArchive::SpectrumArchive - Unable to open "
+              << inputFilePath << std::endl;
+    throw std::invalid_argument("Can't open spectrum archive.");
+  }
+
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus) != 0 ||
+      fileStatus.st_size < (off_t)sizeof(Header)) {
+    close(fileDescriptor);
+    std::cerr << "SpectrumArchive::SpectrumArchive - Too short to be an "
+              << "archive " << inputFilePath << std::endl;
+    throw std::invalid_argument("Not a spectrum archive.");
+  }
+
+  m_mappingSize = fileStatus.st_size;
+  void* mapping =
+      mmap(0, m_mappingSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+
+  // The mapping remains valid after the file is closed
+  close(fileDescriptor);
+
+  if (mapping == MAP_FAILED) {
+    std::cerr << "SpectrumArchive::SpectrumArchive - Unable to map "
+              << inputFilePath << std::endl;
+    throw std::string("Can't memory map spectrum archive.");
+  }
+
+  std::size_t mappingSize = m_mappingSize;
+  m_mapping = std::shared_ptr<const char>(
+      static_cast<const char*>(mapping), [mappingSize](const char* address) {
+        munmap(const_cast<char*>(address), mappingSize);
+      });
+
+  checkMapping(inputFilePath);
+}
+
+SpectrumArchive::~SpectrumArchive() {}
+
+void SpectrumArchive::checkMapping(const std::string& filePath) {
+  m_header = reinterpret_cast<const Header*>(m_mapping.get());
+
+  if (std::memcmp(m_header->identifier, archiveIdentifier,
+                  sizeof(archiveIdentifier)) != 0 ||
+      m_header->version != archiveVersion) {
+    std::cerr << "SpectrumArchive::checkMapping - Unrecognised format in "
+              << filePath << std::endl;
+    throw std::invalid_argument("Not a spectrum archive.");
+  }
+
+  std::size_t namesSize = m_header->columnNumber * m_columnNameLength;
+  std::size_t timesSize = m_header->entryNumber * sizeof(std::int64_t);
+  std::size_t valuesSize = m_header->entryNumber * m_header->columnNumber *
+                           m_header->binNumber * sizeof(double);
+
+  if (m_mappingSize != sizeof(Header) + namesSize + timesSize + valuesSize) {
+    std::cerr << "SpectrumArchive::checkMapping - Incomplete archive "
+              << filePath << std::endl;
+    throw std::invalid_argument("Spectrum archive is truncated.");
+  }
+
+  const char* names = m_mapping.get() + sizeof(Header);
+  for (unsigned int c = 0; c < m_header->columnNumber; c++) {
+    const char* name = names + c * m_columnNameLength;
+    m_columnNames.push_back(
+        std::string(name, strnlen(name, m_columnNameLength)));
+  }
+
+  m_times = reinterpret_cast<const std::int64_t*>(names + namesSize);
+  m_values = reinterpret_cast<const double*>(names + namesSize + timesSize);
+}
+
+void SpectrumArchive::write(
+    std::string outputFilePath, const std::vector<time_t>& times,
+    const std::vector<std::shared_ptr<Spectrum> >& spectra, double latitude,
+    double longitude, double altitude, std::uint32_t climateOptions,
+    double wavelengthInterval, std::uint64_t smartsCardHash) {
+  if (times.size() != spectra.size()) {
+    throw std::invalid_argument("Need one time for each archived spectrum.");
+  }
+
+  // Order the entries by time for the lookup, keeping the first of any
+  // repeated times.
+  std::vector<unsigned int> order(times.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(),
+                   [&times](unsigned int a, unsigned int b) {
+                     return times[a] < times[b];
+                   });
+  order.erase(std::unique(order.begin(), order.end(),
+                          [&times](unsigned int a, unsigned int b) {
+                            return times[a] == times[b];
+                          }),
+              order.end());
+
+  Header header;
+  std::memset(&header, 0, sizeof(Header));
+  std::memcpy(header.identifier, archiveIdentifier, sizeof(archiveIdentifier));
+  header.version = archiveVersion;
+  header.entryNumber = order.size();
+  header.latitude = latitude;
+  header.longitude = longitude;
+  header.altitude = altitude;
+  header.climateOptions = climateOptions;
+  header.wavelengthInterval = wavelengthInterval;
+  header.smartsCardHash = smartsCardHash;
+
+  std::vector<std::string> columnNames;
+  if (!order.empty()) {
+    columnNames = spectra[order[0]]->getSMARTSColumnNames();
+    header.columnNumber = columnNames.size();
+    header.binNumber = spectra[order[0]]->getBinNumber();
+  }
+
+  std::ofstream outputFile(outputFilePath.c_str(),
+                           std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!outputFile.is_open()) {
+    std::cerr << "SpectrumArchive::write - Unable to create " << outputFilePath
+              << std::endl;
+    throw std::invalid_argument("Can't create spectrum archive.");
+  }
+
+  outputFile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+  for (auto& columnName : columnNames) {
+    if (columnName.size() > m_columnNameLength) {
+      throw std::invalid_argument("Spectrum column name is too long.");
+    }
+
+    char paddedName[m_columnNameLength] = {0};
+    std::memcpy(paddedName, columnName.data(), columnName.size());
+    outputFile.write(paddedName, m_columnNameLength);
+  }
+
+  for (unsigned int entry : order) {
+    std::int64_t time = times[entry];
+    outputFile.write(reinterpret_cast<const char*>(&time), sizeof(time));
+  }
+
+  for (unsigned int entry : order) {
+    const Spectrum& spectrum = *spectra[entry];
+
+    if (spectrum.getSMARTSColumnNames() != columnNames ||
+        spectrum.getBinNumber() != header.binNumber) {
+      throw std::invalid_argument("Archived spectra differ in layout.");
+    }
+
+    for (unsigned int c = 0; c < header.columnNumber; c++) {
+      Spectrum::ColumnView column = spectrum.getColumn(c);
+      outputFile.write(reinterpret_cast<const char*>(column.data()),
+                       column.size() * sizeof(double));
+    }
+  }
+
+  if (!outputFile.good()) {
+    std::cerr << "SpectrumArchive::write - Failed writing " << outputFilePath
+              << std::endl;
+    throw std::string("Failed to write spectrum archive.");
+  }
+}
+
+std::shared_ptr<Spectrum> SpectrumArchive::getSpectrum(time_t time) const {
+  const std::int64_t* lastTime = m_times + m_header->entryNumber;
+  const std::int64_t* entry =
+      std::lower_bound(m_times, lastTime, (std::int64_t)time);
+
+  if (entry == lastTime || *entry != (std::int64_t)time) {
+    return std::shared_ptr<Spectrum>();
+  }
+
+  unsigned long entrySize = m_header->columnNumber * m_header->binNumber;
+
+  return std::make_shared<Spectrum>(
+      m_columnNames, m_values + (entry - m_times) * entrySize,
+      m_header->binNumber, m_mapping);
+}
+
+unsigned long SpectrumArchive::getEntryNumber() const {
+  return m_header->entryNumber;
+}
+
+double SpectrumArchive::getLatitude() const { return m_header->latitude; }
+
+double SpectrumArchive::getLongitude() const { return m_header->longitude; }
+
+double SpectrumArchive::getAltitude() const { return m_header->altitude; }
+
+std::uint32_t SpectrumArchive::getClimateOptions() const {
+  return m_header->climateOptions;
+}
+
+double SpectrumArchive::getWavelengthInterval() const {
+  return m_header->wavelengthInterval;
+}
+
+std::uint64_t SpectrumArchive::getSmartsCardHash() const {
+  return m_header->smartsCardHash;
+}
+
+bool SpectrumArchive::matchesLocation(double latitude, double longitude,
+                                      double altitude) const {
+  const double tolerance = 1.0e-6;
+
+  return std::fabs(latitude - m_header->latitude) < tolerance &&
+         std::fabs(longitude - m_header->longitude) < tolerance &&
+         std::fabs(altitude - m_header->altitude) < tolerance;
+}
+
+bool SpectrumArchive::matchesConditions(std::uint32_t climateOptions,
+                                        double wavelengthInterval,
+                                        std::uint64_t smartsCardHash) const {
+  const double tolerance = 1.0e-6;
+
+  return climateOptions == m_header->climateOptions &&
+         std::fabs(wavelengthInterval - m_header->wavelengthInterval) <
+             tolerance &&
+         smartsCardHash == m_header->smartsCardHash;
+}
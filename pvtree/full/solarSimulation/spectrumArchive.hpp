@@ -0,0 +1,139 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SPECTRUM_ARCHIVE_HPP
+#define PVTREE_SOLAR_SIMULATION_SPECTRUM_ARCHIVE_HPP
+
+/*! @file
+ * \brief Precomputed spectra for a site, looked up by time.
+ *
+ * The spectra are stored in a single binary file which is memory mapped
+ * when read, so that jobs on the same node share the data through the page
+ * cache and no SMARTS runs are needed for the archived times.
+ *
+ * File layout (native byte order): -
+ *
+ *   Header with the format identifier, version, column number, bin number,
+ *   entry number, the site latitude, longitude and altitude and the
+ *   conditions the spectra were produced with (climate options, wavelength
+ *   interval and SMARTS card hash).
+ *
+ *   Column names, each padded to a fixed length.
+ *
+ *   Times of the entries in ascending order [s since the epoch].
+ *
+ *   Bin values of each entry, in the columnar layout used by Spectrum.
+ */
+
+#include "pvtree/full/solarSimulation/spectrum.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+
+class SpectrumArchive {
+ public:
+  /*! \brief Memory map an existing archive.
+   *
+   * @param[in] inputFilePath The archive file to read.
+   */
+  explicit SpectrumArchive(std::string inputFilePath);
+  ~SpectrumArchive();
+
+  /*! \brief Write spectra to a new archive.
+   *
+   * All the spectra must have the same columns and binning. Where the same
+   * time appears more than once the first spectrum is kept.
+   *
+   * @param[in] outputFilePath The file to be written.
+   * @param[in] times The time of each spectrum.
+   * @param[in] spectra The spectra to be stored.
+   * @param[in] latitude The site latitude [deg]
+   * @param[in] longitude The site longitude [deg]
+   * @param[in] altitude The site altitude [km]
+   * @param[in] climateOptions The climate options of the sun used to produce
+   *                           the spectra, as returned by
+   *                           Sun::getClimateOptionMask.
+   * @param[in] wavelengthInterval The SMARTS wavelength interval [nm]
+   * @param[in] smartsCardHash The SMARTS card hash of the spectrum factory
+   *                           before any climate values were applied.
+   */
+  static void write(std::string outputFilePath,
+                    const std::vector<time_t>& times,
+                    const std::vector<std::shared_ptr<Spectrum> >& spectra,
+                    double latitude, double longitude, double altitude,
+                    std::uint32_t climateOptions, double wavelengthInterval,
+                    std::uint64_t smartsCardHash);
+
+  /*! \brief Get the spectrum stored for a time.
+   *
+   * The spectrum refers directly to the mapped file and keeps it mapped
+   * for as long as it exists.
+   *
+   * \returns The spectrum or a null pointer if the time is not archived.
+   */
+  std::shared_ptr<Spectrum> getSpectrum(time_t time) const;
+
+  /*! \brief Get the number of archived spectra.
+   */
+  unsigned long getEntryNumber() const;
+
+  double getLatitude() const;
+  double getLongitude() const;
+  double getAltitude() const;
+  std::uint32_t getClimateOptions() const;
+  double getWavelengthInterval() const;
+  std::uint64_t getSmartsCardHash() const;
+
+  /*! \brief Check if the archive was produced for a site.
+   */
+  bool matchesLocation(double latitude, double longitude,
+                       double altitude) const;
+
+  /*! \brief Check if the archive was produced under the same conditions as
+   *         a simulation.
+   *
+   * @param[in] climateOptions The climate options of the simulation sun.
+   * @param[in] wavelengthInterval The SMARTS wavelength interval [nm]
+   * @param[in] smartsCardHash The SMARTS card hash of the spectrum factory
+   *                           before any climate values were applied.
+   */
+  bool matchesConditions(std::uint32_t climateOptions,
+                         double wavelengthInterval,
+                         std::uint64_t smartsCardHash) const;
+
+ private:
+  //! Fixed size start of the file
+  struct Header {
+    char identifier[8];
+    std::uint32_t version;
+    std::uint32_t columnNumber;
+    std::uint32_t binNumber;
+    std::uint32_t padding;
+    std::uint64_t entryNumber;
+    double latitude;
+    double longitude;
+    double altitude;
+    std::uint32_t climateOptions;
+    std::uint32_t conditionsPadding;
+    double wavelengthInterval;
+    std::uint64_t smartsCardHash;
+  };
+
+  //! Space reserved for each column name
+  static const unsigned int m_columnNameLength = 32;
+
+  //! Keeps the file mapped whilst the archive or its spectra exist
+  std::shared_ptr<const char> m_mapping;
+  std::size_t m_mappingSize;
+
+  const Header* m_header;
+  std::vector<std::string> m_columnNames;
+  const std::int64_t* m_times;
+  const double* m_values;
+
+  /*! \brief Check the mapped file is a complete archive.
+   */
+  void checkMapping(const std::string& filePath);
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SPECTRUM_ARCHIVE_HPP
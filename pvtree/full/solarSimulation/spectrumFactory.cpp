@@ -2,10 +2,58 @@
 #include "pvtree/full/solarSimulation/smartsWrap.hpp"
 
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
+
+namespace {
+// Quantization steps applied to the SMARTS inputs when memoizing spectra
+const double kAngleStep = 0.01;               // [deg]
+const double kAirMassStep = 0.0001;           // []
+const double kPressureStep = 0.1;             // [mb]
+const double kAltitudeStep = 0.001;           // [km]
+const double kPrecipitableWaterStep = 0.001;  // [g/cm^2]
+const double kOzoneAbundanceStep = 0.0001;    // [atm-cm]
+const double kWavelengthStep = 0.01;          // [nm]
+
+// Finest wavelength step of the SMARTS calculation
+const double kSmartsWavelengthStep = 0.5;  // [nm]
+
+long long quantize(double value, double step) {
+  return std::llround(value / step);
+}
+
+// FNV-1a hash accumulated over the bytes of each added value
+class CardHasher {
+ public:
+  CardHasher() : m_hash(14695981039346656037ull) {}
 
-extern "C" { void runsmarts_(); }
+  template <typename T>
+  void add(const T& value) {
+    addBytes(&value, sizeof(value));
+  }
+
+  void addBytes(const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t b = 0; b < size; b++) {
+      m_hash ^= bytes[b];
+      m_hash *= 1099511628211ull;
+    }
+  }
+
+  std::uint64_t getHash() const { return m_hash; }
+
+ private:
+  std::uint64_t m_hash;
+};
+
+// Move a value to the centre of its quantization step, dividing by the
+// whole number of steps per unit so that round values are kept exactly
+void snapToStep(double& value, double step) {
+  value = quantize(value, step) / (double)std::llround(1.0 / step);
+}
+}
 
 void SpectrumFactory::convertToFortran(char* fstring, std::size_t fstring_len,
                                        const char* cstring) {
@@ -25,7 +73,18 @@ void SpectrumFactory::convertToFortran(char* fstring, std::size_t fstring_len,
   std::fill(fstring + cpylen, fstring + fstring_len, ' ');
 }
 
-SpectrumFactory::SpectrumFactory() {
+SpectrumFactory::SpectrumFactory()
+    : m_smartsInput(new SmartsInput()),
+      m_smartsOutput(new SmartsOutput()),
+      m_parametersChanged(true),
+      m_modifiersChanged(true),
+      m_cloudCover(0.0),
+      m_currentCacheEntry(0),
+      m_spectrumCacheSize(1024u),
+      m_spectrumCacheHits(0ul),
+      m_spectrumCacheMisses(0ul),
+      m_spectrumArchiveHits(0ul),
+      m_settingsVersion(0ul) {
   // Set default SMARTS options
   setDefaults();
 }
@@ -33,11 +92,11 @@ SpectrumFactory::SpectrumFactory() {
 void SpectrumFactory::setDefaults() {
   // Control verbosity of smarts, where we only want
   // errors reported and no output files produced.
-  generalsmarts_.verbosity = 1;
-  generalsmarts_.writeOutputFiles = 0;
+  m_smartsInput->general.verbosity = 1;
+  m_smartsInput->general.writeOutputFiles = 0;
 
   // Card 1
-  convertToFortran(inputcard1_.comment, 64, "Spectrum Factory Setup");
+  convertToFortran(m_smartsInput->card1.comment, 64, "Spectrum Factory Setup");
 
   // Card 2
   setDefaultAtmosphericPressure();
@@ -55,62 +114,63 @@ void SpectrumFactory::setDefaults() {
   setDefaultGasLoad();
 
   // Card 7
-  inputcard7_.carbonDioxideConcentration = 370.0;
+  m_smartsInput->card7.carbonDioxideConcentration = 370.0;
 
   // Card 7a
-  inputcard7a_.extraterrestrialSpectrum = 1;
+  m_smartsInput->card7a.extraterrestrialSpectrum = 1;
 
   // Card 8
-  convertToFortran(inputcard8_.aerosolModel, 64, "S&F_URBAN");
+  convertToFortran(m_smartsInput->card8.aerosolModel, 64, "S&F_URBAN");
 
   // Card 9
-  inputcard9_.mode = 0;
-  inputcard9_.aerosolOpticalDepth500 = 0.084;
+  m_smartsInput->card9.mode = 0;
+  m_smartsInput->card9.aerosolOpticalDepth500 = 0.084;
 
   // Card 10
-  inputcard10_.mode = 38;
+  m_smartsInput->card10.mode = 38;
 
   // Card 10b
-  inputcard10b_.mode = 0;
+  m_smartsInput->card10b.mode = 0;
 
   // Card 11
-  inputcard11_.minWavelength = 280.0;
-  inputcard11_.maxWavelength = 4000.0;
-  inputcard11_.sunCorrectionFactor = 1.0;
-  inputcard11_.solarConstant = 1367.0;
+  m_smartsInput->card11.minWavelength = 280.0;
+  m_smartsInput->card11.maxWavelength = 4000.0;
+  m_smartsInput->card11.sunCorrectionFactor = 1.0;
+  m_smartsInput->card11.solarConstant = 1367.0;
 
   // Card 12
-  inputcard12_.mode = 2;
-  inputcard12_.minWavelength = 280.0;
-  inputcard12_.maxWavelength = 4000.0;
-  inputcard12_.wavelengthInterval = 0.5;
+  m_smartsInput->card12.mode = 2;
+  m_smartsInput->card12.minWavelength = 280.0;
+  m_smartsInput->card12.maxWavelength = 4000.0;
+  m_smartsInput->card12.wavelengthInterval = 0.5;
 
   if (m_outputVariablesSelected.size() > 54) {
     throw std::string("Too many output variables selected.");
   }
 
-  inputcard12_.numberOfOutputVariables = m_outputVariablesSelected.size();
+  m_smartsInput->card12.numberOfOutputVariables =
+      m_outputVariablesSelected.size();
   for (unsigned int variableIndex = 0;
        variableIndex < m_outputVariablesSelected.size(); variableIndex++) {
-    inputcard12_.variablesSelected[variableIndex] =
+    m_smartsInput->card12.variablesSelected[variableIndex] =
         m_outputVariablesSelected[variableIndex];
   }
 
   // Card 13
-  inputcard13_.mode = 0;
+  m_smartsInput->card13.mode = 0;
 
   // Card 14
-  inputcard14_.mode = 0;
+  m_smartsInput->card14.mode = 0;
 
   // Card 15
-  inputcard15_.mode = 0;
+  m_smartsInput->card15.mode = 0;
 
   // Card 16
-  inputcard16_.mode = 0;
+  m_smartsInput->card16.mode = 0;
 
   // Card 17
-  inputcard17_.mode = 2;
-  inputcard17_.relativeAirMass = 1.5;
+  m_smartsInput->card17.mode = 2;
+  m_smartsInput->card17.relativeAirMass = 1.5;
 
   // Non-SMARTS
   m_cloudCover = 0.0;
@@ -121,138 +181,544 @@ void SpectrumFactory::setDefaults() {
 
 SpectrumFactory::SpectrumFactory(SpectrumFactory& /*spectrumFactory*/) {}
 
+SpectrumFactory::~SpectrumFactory() {}
+
 SpectrumFactory* SpectrumFactory::instance() {
-  static SpectrumFactory spectrumFactory;
+  static thread_local SpectrumFactory spectrumFactory;
   return &spectrumFactory;
 }
 
+void SpectrumFactory::copySettings(const SpectrumFactory& spectrumFactory) {
+  *m_smartsInput = *spectrumFactory.m_smartsInput;
+  m_outputVariablesSelected = spectrumFactory.m_outputVariablesSelected;
+  m_cloudCover = spectrumFactory.m_cloudCover;
+  m_spectrumTable = spectrumFactory.m_spectrumTable;
+  m_spectrumArchive = spectrumFactory.m_spectrumArchive;
+  setSpectrumCacheSize(spectrumFactory.m_spectrumCacheSize);
+
+  clearCache();
+}
+
+std::shared_ptr<Spectrum> SpectrumFactory::getSpectrum(time_t time) {
+  if (m_spectrumArchive) {
+    std::shared_ptr<Spectrum> archivedSpectrum =
+        m_spectrumArchive->getSpectrum(time);
+
+    if (archivedSpectrum) {
+      m_spectrumArchiveHits++;
+      return archivedSpectrum;
+    }
+  }
+
+  return getSpectrum();
+}
+
 std::shared_ptr<Spectrum> SpectrumFactory::getSpectrum() {
-  if (!m_parametersChanged) {
+  if (!m_parametersChanged && !m_modifiersChanged) {
     // If nothing has changed return previously constructed spectrum
     return m_previousSpectrum;
   }
 
+  // Only a change of the SMARTS inputs needs a new clear sky spectrum
+  if (m_parametersChanged) {
+    m_currentCacheEntry = &findClearSkySpectrum();
+    m_parametersChanged = false;
+  }
+
+  // Reuse the modified spectrum if the modifiers are as before
+  SpectrumCacheEntry& entry = *m_currentCacheEntry;
+  if (!entry.modifiedSpectrum || entry.modifiedCloudCover != m_cloudCover) {
+    entry.modifiedSpectrum = applySpectrumModifiers(entry.clearSkySpectrum);
+    entry.modifiedCloudCover = m_cloudCover;
+  }
+
+  m_previousSpectrum = entry.modifiedSpectrum;
+  m_modifiersChanged = false;
+
+  return m_previousSpectrum;
+}
+
+SpectrumFactory::SpectrumCacheEntry& SpectrumFactory::findClearSkySpectrum() {
+  if (m_spectrumCacheSize == 0u) {
+    m_spectrumCacheMisses++;
+    m_uncachedEntry.clearSkySpectrum = calculateSpectrum(*m_smartsInput);
+    m_uncachedEntry.modifiedSpectrum.reset();
+    return m_uncachedEntry;
+  }
+
+  // Evaluate the memoized inputs at the centre of their steps, so that a
+  // spectrum does not depend on which request first reached the step. Only
+  // a copy is snapped, so the configured cards keep their values.
+  SmartsInput snappedInput = *m_smartsInput;
+  snapToSpectrumCacheGrid(snappedInput);
+
+  // Check if the same conditions have been seen before
+  SpectrumCacheKey key = getSpectrumCacheKey(snappedInput);
+  auto cachedSpectrum = m_spectrumCache.find(key);
+
+  if (cachedSpectrum != m_spectrumCache.end()) {
+    m_spectrumCacheHits++;
+
+    // Move to the front of the usage order
+    m_spectrumCacheOrder.splice(m_spectrumCacheOrder.begin(),
+                                m_spectrumCacheOrder,
+                                cachedSpectrum->second.order);
+
+    return cachedSpectrum->second;
+  }
+
+  m_spectrumCacheMisses++;
+  std::shared_ptr<Spectrum> clearSkySpectrum = calculateSpectrum(snappedInput);
+
+  // Discard the least recently used spectrum to stay within limits
+  if (m_spectrumCache.size() >= m_spectrumCacheSize) {
+    m_spectrumCache.erase(m_spectrumCacheOrder.back());
+    m_spectrumCacheOrder.pop_back();
+  }
+
+  m_spectrumCacheOrder.push_front(key);
+
+  SpectrumCacheEntry& entry = m_spectrumCache[key];
+  entry.clearSkySpectrum = clearSkySpectrum;
+  entry.order = m_spectrumCacheOrder.begin();
+
+  return entry;
+}
+
+std::shared_ptr<Spectrum> SpectrumFactory::calculateSpectrum(
+    const SmartsInput& input) {
+  if (canUseSpectrumTable()) {
+    return interpolateSpectrumTable(input);
+  }
+
+  return runSMARTS(input);
+}
+
+bool SpectrumFactory::canUseSpectrumTable() const {
+  if (!m_spectrumTable) return false;
+
+  // Table is indexed by solar elevation and explicit pressure
+  if (m_smartsInput->card17.mode != 1 || m_smartsInput->card2.mode != 1) {
+    return false;
+  }
+
+  if (quantize(m_smartsInput->card2.altitude, kAltitudeStep) !=
+      quantize(m_spectrumTable->getAltitude(), kAltitudeStep)) {
+    return false;
+  }
+
+  // Water and ozone either tabulated or from the reference atmosphere
+  if (m_smartsInput->card4.mode !=
+      (m_spectrumTable->usesReferencePrecipitableWater() ? 1 : 0)) {
+    return false;
+  }
+  if (m_smartsInput->card5.mode !=
+      (m_spectrumTable->usesReferenceOzoneAbundance() ? 1 : 0)) {
+    return false;
+  }
+  if (m_smartsInput->card5.mode == 0 &&
+      m_smartsInput->card5.altitudeCorrectionMode != 0) {
+    return false;
+  }
+
+  // Table must have been filled with the same wavelength binning
+  const std::vector<double>& wavelengths = m_spectrumTable->getWavelengths();
+  if (wavelengths.size() < 2 ||
+      quantize(wavelengths[1] - wavelengths[0], kWavelengthStep) !=
+          quantize(m_smartsInput->card12.wavelengthInterval, kWavelengthStep)) {
+    return false;
+  }
+
+  // Only the default columns are tabulated
+  if (m_outputVariablesSelected.size() != 5) return false;
+
+  // Every other SMARTS input must be as when the table was filled
+  return m_spectrumTable->getSmartsCardHash() == getSmartsCardHash();
+}
+
+std::shared_ptr<Spectrum> SpectrumFactory::interpolateSpectrumTable(
+    const SmartsInput& input) {
+  std::shared_ptr<Spectrum> tabulatedSpectrum = m_spectrumTable->getSpectrum(
+      input.card17.elevationAngle, input.card2.pressure,
+      input.card4.precipitableWater, input.card5.ozoneTotalColumnAbundance);
+
+  return tabulatedSpectrum;
+}
+
+std::shared_ptr<Spectrum> SpectrumFactory::runSMARTS(
+    const SmartsInput& input) {
   // Run SMARTS
-  runsmarts_();
+  runSmarts(input, *m_smartsOutput);
 
   // Extract the results from smarts
   // Start with the header names
   std::vector<std::string> headerNames;
-  std::map<std::string, std::vector<double> > binValues;
-  for (int x = 0; x < smartsoutputs_.outputHeaderNumber; x++) {
-    std::string headerName = std::string(smartsoutputs_.outputHeaders[x]);
-    headerNames.push_back(headerName);
-    binValues[headerName] = std::vector<double>();
+  for (int x = 0; x < m_smartsOutput->outputHeaderNumber; x++) {
+    headerNames.push_back(std::string(m_smartsOutput->outputHeaders[x]));
   }
 
-  // Then the bin values
-  for (int w = 0; w < smartsoutputs_.outputBinNumber; w++) {
-    for (int h = 0; h < smartsoutputs_.outputHeaderNumber; h++) {
-      binValues[headerNames[h]].push_back(smartsoutputs_.outputBinValues[w][h]);
+  // Then the bin values, stored column by column
+  int binNumber = m_smartsOutput->outputBinNumber;
+  std::vector<double> binValues(headerNames.size() * binNumber);
+  for (int w = 0; w < binNumber; w++) {
+    for (int h = 0; h < m_smartsOutput->outputHeaderNumber; h++) {
+      binValues[h * binNumber + w] = m_smartsOutput->outputBinValues[w][h];
     }
   }
 
+  // Create the spectrum (don't manually delete!)
+  return std::make_shared<Spectrum>(headerNames, binValues);
+}
+
+std::shared_ptr<Spectrum> SpectrumFactory::applySpectrumModifiers(
+    const std::shared_ptr<Spectrum>& clearSkySpectrum) const {
+  std::vector<std::string> headerNames =
+      clearSkySpectrum->getSMARTSColumnNames();
+  int directColumn = clearSkySpectrum->getColumnIndex(
+      Spectrum::getColumnName(Spectrum::DIRECT_NORMAL_IRRADIANCE));
+
+  if (directColumn < 0) return clearSkySpectrum;
+
+  // Copy the columns so the clear sky spectrum can be reused
+  unsigned int binNumber = clearSkySpectrum->getBinNumber();
+  std::vector<double> binValues;
+  binValues.reserve(headerNames.size() * binNumber);
+
+  for (unsigned int h = 0; h < headerNames.size(); h++) {
+    Spectrum::ColumnView column = clearSkySpectrum->getColumn(h);
+    binValues.insert(binValues.end(), column.begin(), column.end());
+  }
+
+  unsigned int firstBin = directColumn * binNumber;
+
   //! \todo Replace the use of incredibly simple model of cloud cover.
-  for (unsigned int b = 0;
-       b < binValues[std::string("Direct_normal_irradiance")].size(); b++) {
-    binValues[std::string("Direct_normal_irradiance")][b] *=
-        1.00001 - m_cloudCover;
+  for (unsigned int b = firstBin; b < firstBin + binNumber; b++) {
+    binValues[b] *= 1.00001 - m_cloudCover;
   }
 
-  // Create the spectrum (don't manually delete!)
-  Spectrum* spectrum = new Spectrum(headerNames, binValues);
-  m_previousSpectrum = std::shared_ptr<Spectrum>(spectrum);
+  return std::make_shared<Spectrum>(headerNames, binValues);
+}
 
-  m_parametersChanged = false;
-  return m_previousSpectrum;
+SpectrumFactory::SpectrumCacheKey SpectrumFactory::getSpectrumCacheKey(
+    const SmartsInput& input) const {
+  // When not using the solar position the air mass defines the path length
+  double solarPosition = input.card17.mode == 1 ? input.card17.elevationAngle
+                                                : input.card17.relativeAirMass;
+  double solarPositionStep = input.card17.mode == 1 ? kAngleStep : kAirMassStep;
+
+  SpectrumCacheKey key = {
+      {input.card17.mode, quantize(solarPosition, solarPositionStep),
+       quantize(input.card17.azimuthalAngle, kAngleStep),
+       input.card2.mode,
+       quantize(input.card2.pressure, kPressureStep),
+       quantize(input.card2.altitude, kAltitudeStep),
+       input.card4.mode * 10 + input.card5.mode * 100 +
+           input.card5.altitudeCorrectionMode * 1000,
+       quantize(input.card4.precipitableWater, kPrecipitableWaterStep),
+       quantize(input.card5.ozoneTotalColumnAbundance, kOzoneAbundanceStep),
+       quantize(input.card12.wavelengthInterval, kWavelengthStep)}};
+
+  return key;
+}
+
+void SpectrumFactory::snapToSpectrumCacheGrid(SmartsInput& input) const {
+  if (input.card17.mode == 1) {
+    snapToStep(input.card17.elevationAngle, kAngleStep);
+  } else {
+    snapToStep(input.card17.relativeAirMass, kAirMassStep);
+  }
+  snapToStep(input.card17.azimuthalAngle, kAngleStep);
+  snapToStep(input.card2.pressure, kPressureStep);
+  snapToStep(input.card2.altitude, kAltitudeStep);
+  snapToStep(input.card4.precipitableWater, kPrecipitableWaterStep);
+  snapToStep(input.card5.ozoneTotalColumnAbundance, kOzoneAbundanceStep);
+}
+
+std::size_t SpectrumFactory::SpectrumCacheKeyHash::operator()(
+    const SpectrumCacheKey& key) const {
+  std::size_t seed = 0;
+  for (auto value : key) {
+    seed ^= std::hash<long long>()(value) + 0x9e3779b9 + (seed << 6) +
+            (seed >> 2);
+  }
+  return seed;
+}
+
+std::uint64_t SpectrumFactory::getSmartsCardHash() const {
+  // Every field is added separately so padding between them is ignored
+  const SmartsInput& input = *m_smartsInput;
+  CardHasher hasher;
+
+  // The altitude is compared separately, to within the cache step
+  hasher.add(input.card2.height);
+  hasher.add(input.card2.latitude);
+  hasher.add(input.card2.mode);
+
+  hasher.add(input.card3.temperature);
+  hasher.add(input.card3.relativeHumidity);
+  hasher.add(input.card3.dailyTemperature);
+  hasher.add(input.card3.mode);
+  hasher.add(input.card3.season);
+  hasher.add(input.card3.reference);
+
+  hasher.add(input.card4.mode);
+
+  hasher.add(input.card5.altitudeCorrectionMode);
+  hasher.add(input.card5.mode);
+
+  // Gas concentrations are only read when the default load is not used
+  hasher.add(input.card6.mode);
+  if (input.card6.mode == 0) {
+    hasher.add(input.card6.loadMode);
+    hasher.add(input.card6.formaldehydeConcentration);
+    hasher.add(input.card6.methaneConcentration);
+    hasher.add(input.card6.carbonMonoxideConcentration);
+    hasher.add(input.card6.nitrousAcidConcentration);
+    hasher.add(input.card6.nitricAcidConcentration);
+    hasher.add(input.card6.nitricOxideConcentration);
+    hasher.add(input.card6.nitrogenDioxideConcentration);
+    hasher.add(input.card6.nitrogenTrioxideConcentration);
+    hasher.add(input.card6.ozoneConcentration);
+    hasher.add(input.card6.sulfurDioxideConcentration);
+  }
+
+  hasher.add(input.card7.carbonDioxideConcentration);
+  hasher.add(input.card7a.extraterrestrialSpectrum);
+
+  hasher.add(input.card8.alphaShortWavelength);
+  hasher.add(input.card8.alphaLongWavelength);
+  hasher.add(input.card8.singleScatteringAlbedo);
+  hasher.add(input.card8.aerosolAsymmetry);
+  hasher.add(input.card8.aerosolModel);
+
+  hasher.add(input.card9.aerosolOpticalDepth500);
+  hasher.add(input.card9.angstromTurbidityCoefficient);
+  hasher.add(input.card9.schueppTurbidityCoefficient);
+  hasher.add(input.card9.meteorologicalRange);
+  hasher.add(input.card9.prevailingVisibility);
+  hasher.add(input.card9.aerosolOpticalDepth550);
+  hasher.add(input.card9.mode);
+
+  hasher.add(input.card10.broadbandLambertianAlbedo);
+  hasher.add(input.card10.mode);
+
+  hasher.add(input.card10b.tiltAngle);
+  hasher.add(input.card10b.surfaceAzimuth);
+  hasher.add(input.card10b.foregroundAlbedo);
+  hasher.add(input.card10b.foregroundAlbedoMode);
+  hasher.add(input.card10b.mode);
+
+  hasher.add(input.card11.minWavelength);
+  hasher.add(input.card11.maxWavelength);
+  hasher.add(input.card11.sunCorrectionFactor);
+  hasher.add(input.card11.solarConstant);
+
+  hasher.add(input.card12.minWavelength);
+  hasher.add(input.card12.maxWavelength);
+  hasher.add(input.card12.wavelengthInterval);
+  hasher.add(input.card12.numberOfOutputVariables);
+  hasher.add(input.card12.mode);
+  hasher.addBytes(input.card12.variablesSelected,
+                  input.card12.numberOfOutputVariables * sizeof(int));
+
+  hasher.add(input.card13.slopeAngle);
+  hasher.add(input.card13.halfApertureOpeningAngle);
+  hasher.add(input.card13.limitAngle);
+  hasher.add(input.card13.mode);
+
+  hasher.add(input.card14.minWavelength);
+  hasher.add(input.card14.maxWavelength);
+  hasher.add(input.card14.irradianceStep);
+  hasher.add(input.card14.fullWidthHalfMaximum);
+  hasher.add(input.card14.transmittanceMode);
+  hasher.add(input.card14.mode);
+
+  hasher.add(input.card15.mode);
+  hasher.add(input.card16.mode);
+
+  // Only the way the solar position is given, not the position itself
+  hasher.add(input.card17.mode);
+
+  return hasher.getHash();
+}
+
+void SpectrumFactory::parametersChanged() {
+  m_parametersChanged = true;
+  m_settingsVersion++;
 }
 
-void SpectrumFactory::clearCache() { m_parametersChanged = true; }
+unsigned long SpectrumFactory::getSettingsVersion() const {
+  return m_settingsVersion;
+}
+
+void SpectrumFactory::setSpectrumCacheSize(unsigned int maximumSize) {
+  m_spectrumCacheSize = maximumSize;
+
+  // Remove the least recently used spectra beyond the new limit
+  while (m_spectrumCache.size() > m_spectrumCacheSize) {
+    m_spectrumCache.erase(m_spectrumCacheOrder.back());
+    m_spectrumCacheOrder.pop_back();
+
+    // Current entry may have gone so it must be looked up again
+    m_parametersChanged = true;
+  }
+}
+
+unsigned long SpectrumFactory::getSpectrumCacheHits() const {
+  return m_spectrumCacheHits;
+}
+
+unsigned long SpectrumFactory::getSpectrumCacheMisses() const {
+  return m_spectrumCacheMisses;
+}
+
+void SpectrumFactory::printSpectrumCacheStatistics() const {
+  unsigned long requests = m_spectrumCacheHits + m_spectrumCacheMisses;
+  double hitRate =
+      requests > 0ul ? 100.0 * m_spectrumCacheHits / (double)requests : 0.0;
+
+  std::cout << "Spectrum cache: " << m_spectrumCacheHits << " hits, "
+            << m_spectrumCacheMisses << " misses (" << hitRate
+            << "% hit rate) with " << m_spectrumCache.size() << "/"
+            << m_spectrumCacheSize << " spectra stored." << std::endl;
+
+  if (m_spectrumArchive) {
+    std::cout << "Spectrum archive: " << m_spectrumArchiveHits
+              << " spectra read." << std::endl;
+  }
+}
+
+unsigned long SpectrumFactory::getSpectrumArchiveHits() const {
+  return m_spectrumArchiveHits;
+}
+
+void SpectrumFactory::setSpectrumTable(
+    std::shared_ptr<SpectrumTable> spectrumTable) {
+  m_spectrumTable = spectrumTable;
+
+  clearCache();
+}
+
+void SpectrumFactory::setSpectrumArchive(
+    std::shared_ptr<SpectrumArchive> spectrumArchive) {
+  m_spectrumArchive = spectrumArchive;
+  m_settingsVersion++;
+}
+
+void SpectrumFactory::clearCache() {
+  m_parametersChanged = true;
+  m_modifiersChanged = true;
+  m_settingsVersion++;
+
+  m_spectrumCache.clear();
+  m_spectrumCacheOrder.clear();
+}
 
 void SpectrumFactory::setSolarPositionWithElevationAzimuth(
     double solarElevation, double solarAzimuth) {
   // Card 17
-  inputcard17_.mode = 1;
-  inputcard17_.elevationAngle = solarElevation;
-  inputcard17_.azimuthalAngle = solarAzimuth;
+  m_smartsInput->card17.mode = 1;
+  m_smartsInput->card17.elevationAngle = solarElevation;
+  m_smartsInput->card17.azimuthalAngle = solarAzimuth;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setDefaultAtmosphericPressure() {
   // Card 2
-  inputcard2_.mode = 1;
-  inputcard2_.pressure = 1015.0;
-  inputcard2_.altitude = 0.088;
-  inputcard2_.height = 0.0;
+  m_smartsInput->card2.mode = 1;
+  m_smartsInput->card2.pressure = 1015.0;
+  m_smartsInput->card2.altitude = 0.088;
+  m_smartsInput->card2.height = 0.0;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setAtmosphericPressure(double pressure) {
   // Card 2
-  inputcard2_.pressure = pressure;
+  m_smartsInput->card2.pressure = pressure;
 
-  if (inputcard2_.mode == 2) {
+  if (m_smartsInput->card2.mode == 2) {
     // Wrong mode for using pressure, switch by default (but also warn!)
     // Mode 1 is actually recommended!
-    inputcard2_.mode = 1;
+    m_smartsInput->card2.mode = 1;
     std::cerr << "Inconsistant mode for using atmospheric pressure, switching "
                  "to mode 1." << std::endl;
   }
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setAltitude(double altitude) {
   // Card 2
-  inputcard2_.altitude = altitude;
+  m_smartsInput->card2.altitude = altitude;
 
-  if (inputcard2_.mode == 0) {
+  if (m_smartsInput->card2.mode == 0) {
     // Wrong mode for using altitude
     std::cerr << "Inconsistant mode for using altitude." << std::endl;
   }
 
-  clearCache();
+  parametersChanged();
+}
+
+void SpectrumFactory::setWavelengthInterval(double wavelengthInterval) {
+  // Output is only produced at the wavelengths SMARTS calculates
+  double steps = wavelengthInterval / kSmartsWavelengthStep;
+
+  if (steps < 1.0 - 1.0e-6 || std::fabs(steps - std::round(steps)) > 1.0e-6) {
+    std::cerr << "Wavelength interval " << wavelengthInterval
+              << " nm is not a multiple of " << kSmartsWavelengthStep << " nm."
+              << std::endl;
+    throw std::invalid_argument("Unusable SMARTS wavelength interval.");
+  }
+
+  // Card 12
+  m_smartsInput->card12.wavelengthInterval = wavelengthInterval;
+
+  parametersChanged();
+}
+
+double SpectrumFactory::getWavelengthInterval() const {
+  return m_smartsInput->card12.wavelengthInterval;
 }
 
 void SpectrumFactory::setDefaultPrecipitableWater() {
   // Card 4
   // Use default value for current atmosphere.
-  inputcard4_.mode = 1;
+  m_smartsInput->card4.mode = 1;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setPrecipitableWater(double precipitableWater) {
   // Card 4
-  inputcard4_.mode = 0;
-  inputcard4_.precipitableWater = precipitableWater;
+  m_smartsInput->card4.mode = 0;
+  m_smartsInput->card4.precipitableWater = precipitableWater;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setDefaultOzoneAbundance() {
   // Card 5
-  inputcard5_.mode = 1;
+  m_smartsInput->card5.mode = 1;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setOzoneAbundance(double ozoneAbundance,
                                         int altitudeCorrectionMode /* = 0 */) {
   // Card 5
-  inputcard5_.mode = 0;
-  inputcard5_.altitudeCorrectionMode = altitudeCorrectionMode;
-  inputcard5_.ozoneTotalColumnAbundance = ozoneAbundance;
+  m_smartsInput->card5.mode = 0;
+  m_smartsInput->card5.altitudeCorrectionMode = altitudeCorrectionMode;
+  m_smartsInput->card5.ozoneTotalColumnAbundance = ozoneAbundance;
 
-  clearCache();
+  parametersChanged();
 }
 
 void SpectrumFactory::setDefaultAtmosphereProperties() {
   // Card 3
-  inputcard3_.mode = 1;
-  convertToFortran(inputcard3_.reference, 4, "USSA");
+  m_smartsInput->card3.mode = 1;
+  convertToFortran(m_smartsInput->card3.reference, 4, "USSA");
 
   clearCache();
 }
@@ -262,21 +728,21 @@ void SpectrumFactory::setAtmosphereProperties(double airTemperature,
                                               time_t /*time*/,
                                               double averageDailyTemperature) {
   // Card 3 -- Setting up a 'realisitic' atmosphere
-  inputcard3_.mode = 0;
+  m_smartsInput->card3.mode = 0;
 
-  inputcard3_.temperature = airTemperature;
-  inputcard3_.relativeHumidity = relativeHumidity;
-  inputcard3_.dailyTemperature = averageDailyTemperature;
+  m_smartsInput->card3.temperature = airTemperature;
+  m_smartsInput->card3.relativeHumidity = relativeHumidity;
+  m_smartsInput->card3.dailyTemperature = averageDailyTemperature;
 
   //! \todo Pick a season based upon the month and location.
-  convertToFortran(inputcard3_.season, 6, "SUMMER");
+  convertToFortran(m_smartsInput->card3.season, 6, "SUMMER");
 
   clearCache();
 }
 
 void SpectrumFactory::setDefaultGasLoad() {
   // Card 6
-  inputcard6_.mode = 1;
+  m_smartsInput->card6.mode = 1;
 
   clearCache();
 }
@@ -302,8 +768,8 @@ void SpectrumFactory::setGasLoad(GasLoad loadChoice) {
   }
 
   // Card 6
-  inputcard6_.mode = 0;
-  inputcard6_.loadMode = translatedLoadMode;
+  m_smartsInput->card6.mode = 0;
+  m_smartsInput->card6.loadMode = translatedLoadMode;
 
   clearCache();
 }
@@ -311,21 +777,23 @@ void SpectrumFactory::setGasLoad(GasLoad loadChoice) {
 void SpectrumFactory::setCloudCover(double cloudCover) {
   m_cloudCover = cloudCover;
 
-  clearCache();
+  // Applied to the clear sky spectrum, so SMARTS need not be run again
+  m_modifiersChanged = true;
+  m_settingsVersion++;
 }
 
 void SpectrumFactory::setTiltAngles(double elevation, double azimuth) {
   // Card 10b
-  inputcard10b_.mode = 1;
-  inputcard10b_.tiltAngle = elevation;
-  inputcard10b_.surfaceAzimuth = azimuth;
+  m_smartsInput->card10b.mode = 1;
+  m_smartsInput->card10b.tiltAngle = elevation;
+  m_smartsInput->card10b.surfaceAzimuth = azimuth;
 
   clearCache();
 }
 
 void SpectrumFactory::setTiltLocalAlbedo(int referenceAlbedoIndex) {
   // Card 10b
-  inputcard10b_.foregroundAlbedoMode = referenceAlbedoIndex;
+  m_smartsInput->card10b.foregroundAlbedoMode = referenceAlbedoIndex;
 
   clearCache();
 }
@@ -345,10 +813,11 @@ void SpectrumFactory::appendOutputVariable(int extraVariableIndex) {
     throw std::string("Too many output variables selected.");
   }
 
-  inputcard12_.numberOfOutputVariables = m_outputVariablesSelected.size();
+  m_smartsInput->card12.numberOfOutputVariables =
+      m_outputVariablesSelected.size();
   for (unsigned int variableIndex = 0;
        variableIndex < m_outputVariablesSelected.size(); variableIndex++) {
-    inputcard12_.variablesSelected[variableIndex] =
+    m_smartsInput->card12.variablesSelected[variableIndex] =
         m_outputVariablesSelected[variableIndex];
   }
 
@@ -2,19 +2,30 @@
 #define PVTREE_SOLAR_SIMULATION_SPECTRUM_FACTORY_HPP
 
 #include "pvtree/full/solarSimulation/spectrum.hpp"
+#include "pvtree/full/solarSimulation/spectrumTable.hpp"
+#include "pvtree/full/solarSimulation/spectrumArchive.hpp"
 
 #include <string>
 #include <map>
 #include <memory>
 #include <functional>
+#include <array>
+#include <list>
+#include <unordered_map>
+#include <ctime>
+#include <cstdint>
+
+struct SmartsInput;
+struct SmartsOutput;
 
 /*! \brief Factory which will provide access to SMARTS
  *         spectra.
  *
- * Follows the singleton pattern so all access to methods
- * is made through a static instance. This is because of
- * the need to access SMARTS via a set of structs->common
- * block.
+ * All access to methods is made through a static instance,
+ * with one instance per thread. Each instance holds its own
+ * SMARTS configuration, so threads can produce spectra for
+ * different conditions independently. The SMARTS runs
+ * themselves are serialized as they go via the common blocks.
  */
 class SpectrumFactory {
  private:
@@ -24,25 +35,128 @@ class SpectrumFactory {
   SpectrumFactory(SpectrumFactory& spectrumFactory);
 
  public:
+  ~SpectrumFactory();
+
   /*! \brief Set the configurations values to default
    *         settings.
    */
   void setDefaults();
 
-  /*! \brief Retrieve the singleton reference to this factory.
+  /*! \brief Retrieve the reference to the factory for the calling thread.
+   *
+   * Each thread has its own instance which needs to be configured
+   * separately.
    */
   static SpectrumFactory* instance();
 
+  /*! \brief Copy the configuration of another factory.
+   *
+   * Allows a factory in a new thread to start from the settings of
+   * the factory in the thread which created it. The memoized spectra
+   * are not copied.
+   *
+   * @param[in] spectrumFactory The factory to take settings from.
+   */
+  void copySettings(const SpectrumFactory& spectrumFactory);
+
   /*! \brief Retrieve the spectrum produced by current configuration.
    * \returns A shared pointer to a spectrum.
    */
   std::shared_ptr<Spectrum> getSpectrum();
 
+  /*! \brief Retrieve the spectrum for a point in time.
+   *
+   * Served from the spectrum archive when it holds the time, otherwise
+   * the same as for the current configuration.
+   *
+   * @param[in] time The time being simulated.
+   * \returns A shared pointer to a spectrum.
+   */
+  std::shared_ptr<Spectrum> getSpectrum(time_t time);
+
   /*! \brief Force the factory to re-run SMARTS even if the
    *         parameters are unchanged since last run.
+   *
+   * Also empties the memoized spectra held by the factory.
    */
   void clearCache();
 
+  /*! \brief Set the maximum number of memoized spectra.
+   *
+   * Clear sky spectra are memoized using the quantized solar position,
+   * pressure, precipitable water, ozone, altitude and wavelength interval.
+   * The cloud cover is applied afterwards so is not part of the key.
+   * Whilst memoizing, the quantized inputs are moved to the centre of
+   * their step before SMARTS is run, so every request within a step gets
+   * the same spectrum regardless of the order of the requests.
+   * When the limit is reached the least recently used spectrum is
+   * discarded.
+   *
+   * @param[in] maximumSize The number of spectra to retain. Setting
+   *                        to zero disables the memoization.
+   */
+  void setSpectrumCacheSize(unsigned int maximumSize);
+
+  /*! \brief Get the number of spectra served from the memoized spectra.
+   */
+  unsigned long getSpectrumCacheHits() const;
+
+  /*! \brief Get the number of spectra which required SMARTS to be run.
+   */
+  unsigned long getSpectrumCacheMisses() const;
+
+  /*! \brief Print the memoized spectra usage to standard output.
+   */
+  void printSpectrumCacheStatistics() const;
+
+  /*! \brief Use a precomputed table of spectra instead of running SMARTS.
+   *
+   * The table is only used when the configuration is one it can represent,
+   * i.e. the solar position is given by elevation, the pressure, water and
+   * ozone modes match the table, the site altitude and wavelength interval
+   * match, only the default output variables are requested and every other
+   * SMARTS input has the card hash the table was filled with. Otherwise
+   * SMARTS is run as before.
+   *
+   * @param[in] spectrumTable The table to interpolate. A null pointer
+   *                          returns to always running SMARTS.
+   */
+  void setSpectrumTable(std::shared_ptr<SpectrumTable> spectrumTable);
+
+  /*! \brief Use precomputed spectra for the archived times.
+   *
+   * Archived spectra are used as stored, including any cloud cover they were
+   * produced with, so callers should check the archive with
+   * SpectrumArchive::matchesLocation and SpectrumArchive::matchesConditions
+   * before setting it.
+   *
+   * @param[in] spectrumArchive The archive to read. A null pointer stops
+   *                            using an archive.
+   */
+  void setSpectrumArchive(std::shared_ptr<SpectrumArchive> spectrumArchive);
+
+  /*! \brief Get the number of spectra served from the spectrum archive.
+   */
+  unsigned long getSpectrumArchiveHits() const;
+
+  /*! \brief Get a hash of the SMARTS inputs which stay the same across a
+   *         spectrum table or archive.
+   *
+   * Covers every card apart from the comment, the solar position, the site
+   * altitude and the values of the pressure, precipitable water and ozone
+   * abundance, which vary between the stored spectra. Their modes are
+   * included.
+   */
+  std::uint64_t getSmartsCardHash() const;
+
+  /*! \brief Get a count of the changes to any setting which affects the
+   *         spectrum produced.
+   *
+   * Allows users holding on to results derived from a spectrum to tell
+   * whether they are still up to date.
+   */
+  unsigned long getSettingsVersion() const;
+
   /*! \brief Set the solar position (also for air mass calculation).
    *
    * @param[in] solarElevation True astronomical elevation plus refraction
@@ -77,6 +191,24 @@ class SpectrumFactory {
    */
   void setAltitude(double altitude);
 
+  /*! \brief Set the spacing of the wavelengths in the spectra.
+   *
+   * SMARTS reports its results at every wavelength interval between 280nm
+   * and 4000nm. A coarser interval gives fewer bins in the spectra, their
+   * histograms and the photon sampling, which is enough for screening
+   * runs. The SMARTS calculation itself is unchanged, so the values at the
+   * reported wavelengths are the same as at full resolution. The default
+   * is 0.5nm.
+   *
+   * @param[in] wavelengthInterval The interval between wavelengths, which
+   *                               must be a multiple of 0.5 [nm]
+   */
+  void setWavelengthInterval(double wavelengthInterval);
+
+  /*! \brief Get the spacing of the wavelengths in the spectra [nm]
+   */
+  double getWavelengthInterval() const;
+
   /*! \brief Set the precipitable water above the site to the default.
    *
    * Uses the SMARTS mode where the precipitable water value originates
@@ -157,7 +289,8 @@ class SpectrumFactory {
 
   /*! \brief Set the cloud cover fraction
    *
-   * This is a non-smarts parameter.
+   * This is a non-smarts parameter. It is applied to the clear sky
+   * spectrum, so changing it alone never requires SMARTS to be run.
    */
   void setCloudCover(double cloudCover);
 
@@ -191,9 +324,107 @@ class SpectrumFactory {
   void appendOutputVariable(int extraVariableIndex);
 
  private:
+  /*! \brief Quantized SMARTS inputs used to identify memoized spectra.
+   */
+  typedef std::array<long long, 11> SpectrumCacheKey;
+
+  /*! \brief Hash function combining all the quantized inputs.
+   */
+  struct SpectrumCacheKeyHash {
+    std::size_t operator()(const SpectrumCacheKey& key) const;
+  };
+
+  typedef std::list<SpectrumCacheKey> SpectrumCacheOrder;
+
+  /*! \brief Memoized clear sky spectrum along with the spectrum last
+   *         produced from it by the post-SMARTS modifiers.
+   */
+  struct SpectrumCacheEntry {
+    std::shared_ptr<Spectrum> clearSkySpectrum;
+    std::shared_ptr<Spectrum> modifiedSpectrum;
+    double modifiedCloudCover;
+    SpectrumCacheOrder::iterator order;
+  };
+
+  typedef std::unordered_map<SpectrumCacheKey, SpectrumCacheEntry,
+                             SpectrumCacheKeyHash> SpectrumCache;
+
+  //! The SMARTS configuration and outputs for this instance
+  std::unique_ptr<SmartsInput> m_smartsInput;
+  std::unique_ptr<SmartsOutput> m_smartsOutput;
+
+  //! SMARTS inputs or the post-SMARTS modifiers have changed
   bool m_parametersChanged;
+  bool m_modifiersChanged;
   std::shared_ptr<Spectrum> m_previousSpectrum;
   double m_cloudCover;
+  std::shared_ptr<SpectrumTable> m_spectrumTable;
+  std::shared_ptr<SpectrumArchive> m_spectrumArchive;
+
+  //! Memoized spectra and their order of use (most recent first)
+  SpectrumCache m_spectrumCache;
+  SpectrumCacheOrder m_spectrumCacheOrder;
+
+  //! Entry for the current SMARTS inputs, either memoized or the
+  //! uncached entry when memoization is disabled
+  SpectrumCacheEntry* m_currentCacheEntry;
+  SpectrumCacheEntry m_uncachedEntry;
+  unsigned int m_spectrumCacheSize;
+  unsigned long m_spectrumCacheHits;
+  unsigned long m_spectrumCacheMisses;
+  unsigned long m_spectrumArchiveHits;
+
+  //! Incremented whenever a setting affecting the spectrum changes
+  unsigned long m_settingsVersion;
+
+  /*! \brief Record that a memoized SMARTS input has been changed so
+   *         the spectrum needs to be looked up again.
+   */
+  void parametersChanged();
+
+  /*! \brief Round the memoized SMARTS inputs to the centre of their
+   *         quantization steps.
+   *
+   * @param[in,out] input A copy of the configured cards.
+   */
+  void snapToSpectrumCacheGrid(SmartsInput& input) const;
+
+  /*! \brief Build the memoization key from a set of card settings.
+   */
+  SpectrumCacheKey getSpectrumCacheKey(const SmartsInput& input) const;
+
+  /*! \brief Run SMARTS with a set of card settings and convert the
+   *         output into a spectrum.
+   */
+  std::shared_ptr<Spectrum> runSMARTS(const SmartsInput& input);
+
+  /*! \brief Find the clear sky spectrum for the current SMARTS inputs,
+   *         from the memoized spectra when possible.
+   */
+  SpectrumCacheEntry& findClearSkySpectrum();
+
+  /*! \brief Apply the modifiers which act on the SMARTS output, currently
+   *         the cloud cover scaling of the direct normal irradiance.
+   *
+   * @param[in] clearSkySpectrum The spectrum produced for the SMARTS
+   *                             inputs, which is left unchanged.
+   */
+  std::shared_ptr<Spectrum> applySpectrumModifiers(
+      const std::shared_ptr<Spectrum>& clearSkySpectrum) const;
+
+  /*! \brief Check if the current configuration can be served by the
+   *         spectrum table.
+   */
+  bool canUseSpectrumTable() const;
+
+  /*! \brief Interpolate the spectrum table for a set of card settings.
+   */
+  std::shared_ptr<Spectrum> interpolateSpectrumTable(const SmartsInput& input);
+
+  /*! \brief Produce a spectrum for a set of card settings, using the
+   *         spectrum table when possible.
+   */
+  std::shared_ptr<Spectrum> calculateSpectrum(const SmartsInput& input);
 
   /*! \brief Output variables to be calculated by SMARTS.
    *
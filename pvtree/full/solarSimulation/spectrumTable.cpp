@@ -0,0 +1,410 @@
+#include "pvtree/full/solarSimulation/spectrumTable.hpp"
+#include "pvtree/utils/resource.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "TFile.h"
+#include "TTree.h"
+
+SpectrumTable::SpectrumTable(std::vector<double> elevations,
+                             std::vector<double> pressures,
+                             std::vector<double> precipitableWaters,
+                             std::vector<double> ozoneAbundances,
+                             double altitude)
+    : m_elevations(elevations),
+      m_pressures(pressures),
+      m_precipitableWaters(precipitableWaters),
+      m_ozoneAbundances(ozoneAbundances),
+      m_altitude(altitude),
+      m_referencePrecipitableWater(precipitableWaters.empty()),
+      m_referenceOzoneAbundance(ozoneAbundances.empty()),
+      m_smartsCardHash(0) {
+  prepareGrid();
+}
+
+SpectrumTable::SpectrumTable(std::string inputFilePath)
+    : m_altitude(0.0),
+      m_referencePrecipitableWater(false),
+      m_referenceOzoneAbundance(false),
+      m_smartsCardHash(0) {
+  // First try to find it w.r.t the local directory
+  std::ifstream localTest(inputFilePath.c_str());
+
+  if (localTest.is_open()) {
+    localTest.close();
+    extractFile(inputFilePath);
+    return;
+  }
+
+  // Not a local file so look in the installed share directory
+  std::string shareFilePath = pvtree::getConfigFile(inputFilePath);
+  std::ifstream shareTest(shareFilePath.c_str());
+
+  if (shareTest.is_open()) {
+    shareTest.close();
+    extractFile(shareFilePath);
+    return;
+  }
+
+  std::cout << "SpectrumTable::SpectrumTable - Unable to find the specified "
+               "input file " << inputFilePath << std::endl;
+  throw std::invalid_argument("Can't find spectrum table input file.");
+}
+
+SpectrumTable::~SpectrumTable() {}
+
+void SpectrumTable::prepareGrid() {
+  // Reference atmosphere values are represented by a single dummy point
+  if (m_referencePrecipitableWater) m_precipitableWaters.assign(1, 0.0);
+  if (m_referenceOzoneAbundance) m_ozoneAbundances.assign(1, 0.0);
+
+  for (auto axis : {&m_elevations, &m_pressures, &m_precipitableWaters,
+                    &m_ozoneAbundances}) {
+    if (axis->empty()) {
+      throw std::invalid_argument("Spectrum table axes need grid points.");
+    }
+    if (!std::is_sorted(axis->begin(), axis->end())) {
+      throw std::invalid_argument("Spectrum table axes must be sorted.");
+    }
+  }
+
+  m_filled.assign(m_elevations.size() * m_pressures.size() *
+                      m_precipitableWaters.size() * m_ozoneAbundances.size(),
+                  false);
+}
+
+const std::vector<std::string>& SpectrumTable::getColumnNames() {
+  static const std::vector<std::string> columnNames = {
+      Spectrum::getColumnName(Spectrum::EXTRATERRESTRIAL_SPECTRUM),
+      Spectrum::getColumnName(Spectrum::DIRECT_NORMAL_IRRADIANCE),
+      Spectrum::getColumnName(Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE)};
+  return columnNames;
+}
+
+const std::vector<double>& SpectrumTable::getElevations() const {
+  return m_elevations;
+}
+
+const std::vector<double>& SpectrumTable::getPressures() const {
+  return m_pressures;
+}
+
+const std::vector<double>& SpectrumTable::getPrecipitableWaters() const {
+  return m_precipitableWaters;
+}
+
+const std::vector<double>& SpectrumTable::getOzoneAbundances() const {
+  return m_ozoneAbundances;
+}
+
+double SpectrumTable::getAltitude() const { return m_altitude; }
+
+const std::vector<double>& SpectrumTable::getWavelengths() const {
+  return m_wavelengths;
+}
+
+bool SpectrumTable::usesReferencePrecipitableWater() const {
+  return m_referencePrecipitableWater;
+}
+
+bool SpectrumTable::usesReferenceOzoneAbundance() const {
+  return m_referenceOzoneAbundance;
+}
+
+void SpectrumTable::setSmartsCardHash(std::uint64_t smartsCardHash) {
+  m_smartsCardHash = smartsCardHash;
+}
+
+std::uint64_t SpectrumTable::getSmartsCardHash() const {
+  return m_smartsCardHash;
+}
+
+unsigned int SpectrumTable::gridIndex(unsigned int elevationIndex,
+                                      unsigned int pressureIndex,
+                                      unsigned int precipitableWaterIndex,
+                                      unsigned int ozoneIndex) const {
+  return ((elevationIndex * m_pressures.size() + pressureIndex) *
+              m_precipitableWaters.size() +
+          precipitableWaterIndex) *
+             m_ozoneAbundances.size() +
+         ozoneIndex;
+}
+
+void SpectrumTable::setSpectrum(unsigned int elevationIndex,
+                                unsigned int pressureIndex,
+                                unsigned int precipitableWaterIndex,
+                                unsigned int ozoneIndex,
+                                std::shared_ptr<Spectrum> spectrum) {
+  if (elevationIndex >= m_elevations.size() ||
+      pressureIndex >= m_pressures.size() ||
+      precipitableWaterIndex >= m_precipitableWaters.size() ||
+      ozoneIndex >= m_ozoneAbundances.size()) {
+    throw std::out_of_range("Spectrum table grid point does not exist.");
+  }
+
+  Spectrum::ColumnView wavelengths = spectrum->getColumn(Spectrum::WAVELENGTH);
+
+  // The first spectrum defines the wavelength binning
+  if (m_wavelengths.empty()) {
+    m_wavelengths.assign(wavelengths.begin(), wavelengths.end());
+    m_values.assign(
+        m_filled.size() * getColumnNames().size() * m_wavelengths.size(), 0.0);
+  }
+
+  if (wavelengths.size() != m_wavelengths.size()) {
+    throw std::invalid_argument(
+        "Spectrum table requires the same wavelength binning everywhere.");
+  }
+
+  unsigned int index = gridIndex(elevationIndex, pressureIndex,
+                                 precipitableWaterIndex, ozoneIndex);
+  unsigned int binNumber = m_wavelengths.size();
+
+  for (unsigned int c = 0; c < getColumnNames().size(); c++) {
+    Spectrum::ColumnView column = spectrum->getColumn(getColumnNames()[c]);
+
+    std::copy(column.begin(), column.end(),
+              m_values.begin() +
+                  (index * getColumnNames().size() + c) * binNumber);
+  }
+
+  m_filled[index] = true;
+}
+
+bool SpectrumTable::isComplete() const {
+  return std::find(m_filled.begin(), m_filled.end(), false) == m_filled.end();
+}
+
+void SpectrumTable::findInterval(const std::vector<double>& axis, double value,
+                                 unsigned int& lowerIndex, double& fraction) {
+  if (axis.size() == 1 || value <= axis.front()) {
+    lowerIndex = 0u;
+    fraction = 0.0;
+    return;
+  }
+
+  if (value >= axis.back()) {
+    lowerIndex = axis.size() - 2;
+    fraction = 1.0;
+    return;
+  }
+
+  lowerIndex =
+      std::upper_bound(axis.begin(), axis.end(), value) - axis.begin() - 1;
+  fraction = (value - axis[lowerIndex]) /
+             (axis[lowerIndex + 1] - axis[lowerIndex]);
+}
+
+std::shared_ptr<Spectrum> SpectrumTable::getSpectrum(
+    double elevation, double pressure, double precipitableWater,
+    double ozoneAbundance) const {
+  if (m_wavelengths.empty()) {
+    throw std::string("Spectrum table has not been filled.");
+  }
+
+  unsigned int lowerIndices[4];
+  double fractions[4];
+  findInterval(m_elevations, elevation, lowerIndices[0], fractions[0]);
+  findInterval(m_pressures, pressure, lowerIndices[1], fractions[1]);
+  findInterval(m_precipitableWaters, precipitableWater, lowerIndices[2],
+               fractions[2]);
+  findInterval(m_ozoneAbundances, ozoneAbundance, lowerIndices[3],
+               fractions[3]);
+
+  unsigned int columnNumber = getColumnNames().size();
+  unsigned int binNumber = m_wavelengths.size();
+  std::vector<double> blended(columnNumber * binNumber, 0.0);
+
+  // Blend the (up to) sixteen surrounding grid points
+  for (unsigned int corner = 0; corner < 16; corner++) {
+    double weight = 1.0;
+    unsigned int indices[4];
+
+    for (unsigned int axis = 0; axis < 4; axis++) {
+      bool upper = (corner >> axis) & 1u;
+      weight *= upper ? fractions[axis] : 1.0 - fractions[axis];
+      indices[axis] = lowerIndices[axis] + (upper ? 1u : 0u);
+    }
+
+    if (weight == 0.0) continue;
+
+    unsigned int index =
+        gridIndex(indices[0], indices[1], indices[2], indices[3]);
+
+    if (!m_filled[index]) {
+      throw std::string("Spectrum table grid point has not been filled.");
+    }
+
+    const double* values = &m_values[index * columnNumber * binNumber];
+    for (unsigned int v = 0; v < blended.size(); v++) {
+      blended[v] += weight * values[v];
+    }
+  }
+
+  // Repackage in the same form as the SMARTS output
+  std::vector<std::string> columnNames = {
+      Spectrum::getColumnName(Spectrum::WAVELENGTH)};
+  columnNames.insert(columnNames.end(), getColumnNames().begin(),
+                     getColumnNames().end());
+
+  blended.insert(blended.begin(), m_wavelengths.begin(), m_wavelengths.end());
+
+  return std::make_shared<Spectrum>(columnNames, blended);
+}
+
+void SpectrumTable::write(std::string outputFilePath) const {
+  if (!isComplete()) {
+    std::cerr << "Writing an incomplete spectrum table to " << outputFilePath
+              << std::endl;
+  }
+
+  TFile outputFile(outputFilePath.c_str(), "RECREATE");
+  TTree* tree = new TTree("smartstable", "SMARTS spectrum grid");
+
+  double elevation, pressure, precipitableWater, ozoneAbundance;
+  double altitude = m_altitude;
+  bool referencePrecipitableWater = m_referencePrecipitableWater;
+  bool referenceOzoneAbundance = m_referenceOzoneAbundance;
+  ULong64_t smartsCardHash = m_smartsCardHash;
+  std::vector<double> wavelengths = m_wavelengths;
+  std::vector<std::vector<double> > columns(getColumnNames().size());
+
+  tree->Branch("elevation", &elevation);
+  tree->Branch("pressure", &pressure);
+  tree->Branch("precipitableWater", &precipitableWater);
+  tree->Branch("ozone", &ozoneAbundance);
+  tree->Branch("altitude", &altitude);
+  tree->Branch("referencePrecipitableWater", &referencePrecipitableWater);
+  tree->Branch("referenceOzone", &referenceOzoneAbundance);
+  tree->Branch("smartsCardHash", &smartsCardHash);
+  tree->Branch(Spectrum::getColumnName(Spectrum::WAVELENGTH).c_str(),
+               &wavelengths);
+  for (unsigned int c = 0; c < columns.size(); c++) {
+    tree->Branch(getColumnNames()[c].c_str(), &columns[c]);
+  }
+
+  unsigned int binNumber = m_wavelengths.size();
+  for (unsigned int e = 0; e < m_elevations.size(); e++) {
+    for (unsigned int p = 0; p < m_pressures.size(); p++) {
+      for (unsigned int w = 0; w < m_precipitableWaters.size(); w++) {
+        for (unsigned int o = 0; o < m_ozoneAbundances.size(); o++) {
+          unsigned int index = gridIndex(e, p, w, o);
+          if (!m_filled[index]) continue;
+
+          elevation = m_elevations[e];
+          pressure = m_pressures[p];
+          precipitableWater = m_precipitableWaters[w];
+          ozoneAbundance = m_ozoneAbundances[o];
+
+          for (unsigned int c = 0; c < columns.size(); c++) {
+            auto start =
+                m_values.begin() + (index * columns.size() + c) * binNumber;
+            columns[c].assign(start, start + binNumber);
+          }
+
+          tree->Fill();
+        }
+      }
+    }
+  }
+
+  tree->Write();
+  outputFile.Close();
+}
+
+void SpectrumTable::extractFile(std::string filePath) {
+  TFile inputFile(filePath.c_str(), "READ");
+  TTree* tree = (TTree*)inputFile.Get("smartstable");
+
+  if (!tree) {
+    throw std::invalid_argument("File does not contain a spectrum table.");
+  }
+
+  double elevation, pressure, precipitableWater, ozoneAbundance;
+  bool referencePrecipitableWater, referenceOzoneAbundance;
+  ULong64_t smartsCardHash = 0;
+  std::vector<double>* wavelengths = 0;
+  std::vector<std::vector<double>*> columns(getColumnNames().size(), 0);
+
+  tree->SetBranchAddress("elevation", &elevation);
+  tree->SetBranchAddress("pressure", &pressure);
+  tree->SetBranchAddress("precipitableWater", &precipitableWater);
+  tree->SetBranchAddress("ozone", &ozoneAbundance);
+  tree->SetBranchAddress("altitude", &m_altitude);
+  tree->SetBranchAddress("referencePrecipitableWater",
+                         &referencePrecipitableWater);
+  tree->SetBranchAddress("referenceOzone", &referenceOzoneAbundance);
+  if (tree->GetBranch("smartsCardHash")) {
+    tree->SetBranchAddress("smartsCardHash", &smartsCardHash);
+  } else {
+    std::cerr << "Spectrum table " << filePath
+              << " does not record its SMARTS cards so will not be used."
+              << std::endl;
+  }
+  tree->SetBranchAddress(
+      Spectrum::getColumnName(Spectrum::WAVELENGTH).c_str(), &wavelengths);
+  for (unsigned int c = 0; c < columns.size(); c++) {
+    tree->SetBranchAddress(getColumnNames()[c].c_str(), &columns[c]);
+  }
+
+  // Recover the grid axes from the stored points
+  for (Long64_t entry = 0; entry < tree->GetEntries(); entry++) {
+    tree->GetEntry(entry);
+    m_elevations.push_back(elevation);
+    m_pressures.push_back(pressure);
+    m_precipitableWaters.push_back(precipitableWater);
+    m_ozoneAbundances.push_back(ozoneAbundance);
+    m_referencePrecipitableWater = referencePrecipitableWater;
+    m_referenceOzoneAbundance = referenceOzoneAbundance;
+    m_smartsCardHash = smartsCardHash;
+  }
+
+  for (auto axis : {&m_elevations, &m_pressures, &m_precipitableWaters,
+                    &m_ozoneAbundances}) {
+    std::sort(axis->begin(), axis->end());
+    axis->erase(std::unique(axis->begin(), axis->end()), axis->end());
+  }
+
+  prepareGrid();
+
+  // Then fill the values
+  for (Long64_t entry = 0; entry < tree->GetEntries(); entry++) {
+    tree->GetEntry(entry);
+
+    if (m_wavelengths.empty()) {
+      m_wavelengths = *wavelengths;
+      m_values.assign(
+          m_filled.size() * columns.size() * m_wavelengths.size(), 0.0);
+    }
+
+    unsigned int index = gridIndex(
+        std::lower_bound(m_elevations.begin(), m_elevations.end(), elevation) -
+            m_elevations.begin(),
+        std::lower_bound(m_pressures.begin(), m_pressures.end(), pressure) -
+            m_pressures.begin(),
+        std::lower_bound(m_precipitableWaters.begin(),
+                         m_precipitableWaters.end(), precipitableWater) -
+            m_precipitableWaters.begin(),
+        std::lower_bound(m_ozoneAbundances.begin(), m_ozoneAbundances.end(),
+                         ozoneAbundance) -
+            m_ozoneAbundances.begin());
+
+    for (unsigned int c = 0; c < columns.size(); c++) {
+      std::copy(columns[c]->begin(), columns[c]->end(),
+                m_values.begin() +
+                    (index * columns.size() + c) * m_wavelengths.size());
+    }
+
+    m_filled[index] = true;
+  }
+
+  inputFile.Close();
+
+  if (!isComplete()) {
+    std::cerr << "Spectrum table in " << filePath
+              << " does not cover the full grid." << std::endl;
+  }
+}
@@ -0,0 +1,177 @@
+#ifndef PVTREE_SOLAR_SIMULATION_SPECTRUM_TABLE_HPP
+#define PVTREE_SOLAR_SIMULATION_SPECTRUM_TABLE_HPP
+
+/*! @file
+ * \brief Precomputed grid of SMARTS spectra.
+ *
+ * Stores the extraterrestrial, direct normal and diffuse horizontal
+ * irradiance columns produced by SMARTS over a grid of solar elevation,
+ * atmospheric pressure, precipitable water and ozone abundance. Spectra
+ * for intermediate conditions are obtained by multi-linear interpolation
+ * between the neighbouring grid points.
+ */
+
+#include "pvtree/full/solarSimulation/spectrum.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+class SpectrumTable {
+ public:
+  /*! \brief Prepare an empty table with the specified grid.
+   *
+   * Each axis must be sorted in increasing order. An empty precipitable
+   * water or ozone axis indicates that the table is filled using the
+   * values of the reference atmosphere instead.
+   *
+   * @param[in] elevations Solar elevation grid points [deg]
+   * @param[in] pressures Atmospheric pressure grid points [mb]
+   * @param[in] precipitableWaters Precipitable water grid points [g/cm^2]
+   * @param[in] ozoneAbundances Ozone abundance grid points [atm-cm]
+   * @param[in] altitude The site altitude used to fill the table [km]
+   */
+  SpectrumTable(std::vector<double> elevations, std::vector<double> pressures,
+                std::vector<double> precipitableWaters,
+                std::vector<double> ozoneAbundances, double altitude);
+
+  /*! \brief Load a table previously written to a ROOT file.
+   *
+   * The file is searched for locally first and then in the installed
+   * share directory.
+   *
+   * @param[in] inputFilePath The path to the ROOT file.
+   */
+  explicit SpectrumTable(std::string inputFilePath);
+  ~SpectrumTable();
+
+  /*! \brief Store the SMARTS spectrum for a grid point.
+   *
+   * @param[in] elevationIndex Index along the solar elevation axis.
+   * @param[in] pressureIndex Index along the pressure axis.
+   * @param[in] precipitableWaterIndex Index along the precipitable water
+   *                                   axis.
+   * @param[in] ozoneIndex Index along the ozone abundance axis.
+   * @param[in] spectrum The spectrum produced by SMARTS at the grid point.
+   */
+  void setSpectrum(unsigned int elevationIndex, unsigned int pressureIndex,
+                   unsigned int precipitableWaterIndex, unsigned int ozoneIndex,
+                   std::shared_ptr<Spectrum> spectrum);
+
+  /*! \brief Interpolate a spectrum from the grid.
+   *
+   * Values outside of the grid are clamped to the grid edges.
+   *
+   * @param[in] elevation The solar elevation [deg]
+   * @param[in] pressure The atmospheric pressure [mb]
+   * @param[in] precipitableWater The precipitable water [g/cm^2]
+   * @param[in] ozoneAbundance The ozone abundance [atm-cm]
+   *
+   * \returns A new spectrum containing the tabulated columns.
+   */
+  std::shared_ptr<Spectrum> getSpectrum(double elevation, double pressure,
+                                        double precipitableWater,
+                                        double ozoneAbundance) const;
+
+  /*! \brief Check that every grid point has been filled.
+   */
+  bool isComplete() const;
+
+  /*! \brief Persist the table to a ROOT file.
+   *
+   * @param[in] outputFilePath The path of the ROOT file to (re)create.
+   */
+  void write(std::string outputFilePath) const;
+
+  /*! \brief Get the names of the SMARTS columns stored in the table.
+   */
+  static const std::vector<std::string>& getColumnNames();
+
+  const std::vector<double>& getElevations() const;
+  const std::vector<double>& getPressures() const;
+  const std::vector<double>& getPrecipitableWaters() const;
+  const std::vector<double>& getOzoneAbundances() const;
+  double getAltitude() const;
+
+  /*! \brief Get the wavelength bin centres of the tabulated spectra [nm]
+   *
+   * Empty until the first spectrum has been stored.
+   */
+  const std::vector<double>& getWavelengths() const;
+
+  /*! \brief Check if the precipitable water is taken from the reference
+   *         atmosphere rather than tabulated.
+   */
+  bool usesReferencePrecipitableWater() const;
+
+  /*! \brief Check if the ozone abundance is taken from the reference
+   *         atmosphere rather than tabulated.
+   */
+  bool usesReferenceOzoneAbundance() const;
+
+  /*! \brief Record the hash of the other SMARTS inputs used to fill the
+   *         table.
+   *
+   * @param[in] smartsCardHash The hash from SpectrumFactory, which is
+   *                           written with the table.
+   */
+  void setSmartsCardHash(std::uint64_t smartsCardHash);
+
+  /*! \brief Get the hash of the other SMARTS inputs used to fill the table.
+   *
+   * Zero if it was never set or the table was written without one, in which
+   * case the table will not match any SMARTS configuration.
+   */
+  std::uint64_t getSmartsCardHash() const;
+
+ private:
+  /*! \brief Extract the table from an opened ROOT file.
+   */
+  void extractFile(std::string filePath);
+
+  /*! \brief Check the axes are usable and size the grid.
+   */
+  void prepareGrid();
+
+  /*! \brief Flattened index of a grid point.
+   */
+  unsigned int gridIndex(unsigned int elevationIndex,
+                         unsigned int pressureIndex,
+                         unsigned int precipitableWaterIndex,
+                         unsigned int ozoneIndex) const;
+
+  /*! \brief Find the grid interval containing a value.
+   *
+   * @param[in] axis The grid points along one axis.
+   * @param[in] value The value to be located.
+   * @param[out] lowerIndex The index of the lower edge of the interval.
+   * @param[out] fraction The distance from the lower edge as a fraction of
+   *                      the interval width.
+   */
+  static void findInterval(const std::vector<double>& axis, double value,
+                           unsigned int& lowerIndex, double& fraction);
+
+  //! Grid axes
+  std::vector<double> m_elevations;
+  std::vector<double> m_pressures;
+  std::vector<double> m_precipitableWaters;
+  std::vector<double> m_ozoneAbundances;
+  double m_altitude;
+  bool m_referencePrecipitableWater;
+  bool m_referenceOzoneAbundance;
+
+  //! Hash of the SMARTS cards which are not tabulated
+  std::uint64_t m_smartsCardHash;
+
+  //! Wavelength bin centres shared by all grid points [nm]
+  std::vector<double> m_wavelengths;
+
+  //! Column values ordered by grid point, column and then wavelength bin
+  std::vector<double> m_values;
+
+  //! Record of which grid points have been filled
+  std::vector<bool> m_filled;
+};
+
+#endif  // PVTREE_SOLAR_SIMULATION_SPECTRUM_TABLE_HPP
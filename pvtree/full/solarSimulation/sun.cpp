@@ -1,10 +1,12 @@
 #include "pvtree/full/solarSimulation/sun.hpp"
 #include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+#include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
 #include "pvtree/climate/climateFactory.hpp"
 #include "pvtree/climate/climate.hpp"
 #include <cmath>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 #include <time.h>
 
 #include <CLHEP/Units/SystemOfUnits.h>
@@ -15,6 +17,12 @@ using CLHEP::cm2;
 using CLHEP::kilogram;
 using CLHEP::m2;
 
+namespace {
+// Default sky sampling grid, roughly 2 deg by 4 deg cells
+const unsigned int kDefaultSkySamplerThetaBins = 45u;
+const unsigned int kDefaultSkySamplerGammaBins = 90u;
+}
+
 void Sun::updateEnvironment() {
   // hmm need this run first to get the month :D
   S_solpos(&(this->m_solarPositionData));
@@ -122,7 +130,10 @@ void Sun::updateSolarPosition() {
 Sun::Sun(LocationDetails deviceLocation)
     : m_recalculateEnvironment(true),
       m_recalculateSolarPosition(true),
-      m_deviceLocation(deviceLocation) {
+      m_deviceLocation(deviceLocation),
+      m_skyStateSettingsVersion(0ul),
+      m_skySamplerThetaBins(kDefaultSkySamplerThetaBins),
+      m_skySamplerGammaBins(kDefaultSkySamplerGammaBins) {
   // Initialize all the default values
   S_init(&(this->m_solarPositionData));
 
@@ -164,6 +175,7 @@ void Sun::setDate(time_t date) {
 
   this->m_recalculateEnvironment = true;
   this->m_recalculateSolarPosition = true;
+  this->m_skyState.reset();
 }
 
 void Sun::setDate(int dayNumber, int yearNumber) {
@@ -175,6 +187,7 @@ void Sun::setDate(int dayNumber, int yearNumber) {
 
   this->m_recalculateEnvironment = true;
   this->m_recalculateSolarPosition = true;
+  this->m_skyState.reset();
 }
 
 void Sun::setTime(int hour, int minute, int second) {
@@ -183,6 +196,7 @@ void Sun::setTime(int hour, int minute, int second) {
   this->m_solarPositionData.second = second;
   this->m_recalculateEnvironment = true;
   this->m_recalculateSolarPosition = true;
+  this->m_skyState.reset();
 }
 
 void Sun::setTime(int secondOfDay) {
@@ -201,6 +215,7 @@ void Sun::setTime(int secondOfDay) {
 
   this->m_recalculateEnvironment = true;
   this->m_recalculateSolarPosition = true;
+  this->m_skyState.reset();
 }
 
 void Sun::setDeviceLocation(LocationDetails deviceLocation) {
@@ -212,6 +227,7 @@ void Sun::setDeviceLocation(LocationDetails deviceLocation) {
 
   this->m_recalculateEnvironment = true;
   this->m_recalculateSolarPosition = true;
+  this->m_skyState.reset();
 }
 
 double Sun::getAzimuthalAngle() {
@@ -307,7 +323,115 @@ std::shared_ptr<Spectrum> Sun::getSpectrum() {
   }
 
   SpectrumFactory* factory = SpectrumFactory::instance();
-  return factory->getSpectrum();
+  return factory->getSpectrum(getTime());
+}
+
+time_t Sun::getTime() {
+  if (this->m_recalculateEnvironment) {
+    updateEnvironment();
+  }
+  if (this->m_recalculateSolarPosition) {
+    updateSolarPosition();
+  }
+
+  // Day and month are filled by solpos even when set by day number
+  struct tm calendarTime;
+  calendarTime.tm_sec = this->m_solarPositionData.second;
+  calendarTime.tm_min = this->m_solarPositionData.minute;
+  calendarTime.tm_hour = this->m_solarPositionData.hour;
+  calendarTime.tm_mday = this->m_solarPositionData.day;
+  calendarTime.tm_mon = this->m_solarPositionData.month - 1;
+  calendarTime.tm_year = this->m_solarPositionData.year - 1900;
+  calendarTime.tm_isdst = 0;
+
+  return timegm(&calendarTime);
+}
+
+std::shared_ptr<const SkyState> Sun::getSkyState() {
+  // Reuse the state until the time, conditions or spectrum settings change
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  if (m_skyState &&
+      m_skyStateSettingsVersion == factory->getSettingsVersion()) {
+    return m_skyState;
+  }
+
+  std::shared_ptr<SkyState> skyState = std::make_shared<SkyState>();
+
+  skyState->lightVector = getLightVector();
+  skyState->elevationAngle = getElevationAngle();
+  skyState->azimuthalAngle = getAzimuthalAngle();
+  skyState->albedo = getAlbedo();
+  skyState->spectrum = getSpectrum();
+  skyState->time = getTime();
+
+  // Define a tangent surface in which the sun photons start
+  skyState->orthogonalVector1 = skyState->lightVector.Orthogonal().Unit();
+  skyState->orthogonalVector2 =
+      skyState->lightVector.Cross(skyState->orthogonalVector1).Unit();
+
+  skyState->totalNormalIrradiance =
+      skyState->spectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE);
+  skyState->totalDiffuseIrradiance =
+      skyState->spectrum->getIntegral(Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE);
+  skyState->totalExtraterrestrialIrradiance =
+      skyState->spectrum->getIntegral(Spectrum::EXTRATERRESTRIAL_SPECTRUM);
+
+  // Perez brightness
+  double bright = 0.0;
+  if (skyState->totalExtraterrestrialIrradiance > 0.0) {
+    bright = 1.5 * skyState->totalDiffuseIrradiance /
+             skyState->totalExtraterrestrialIrradiance;  // 1.5 air mass
+  }
+
+  if (bright < 0.1)
+    bright = 0.1;  // limit to minimum 10% diffuse light or 5deg sun disc size
+  if (bright > 1.0) bright = 1.0;
+
+  // experimental link to Perez bright parameter
+  skyState->turbidity = 1.0 / (1.1 - bright);
+  if (skyState->turbidity > 10.0) skyState->turbidity = 10.0;
+  if (skyState->turbidity < 1.0) skyState->turbidity = 1.0;
+
+  skyState->skyAlbedo = skyState->albedo;
+  if (skyState->skyAlbedo < 0.0) skyState->skyAlbedo = 0.0;
+  if (skyState->skyAlbedo > 1.0) skyState->skyAlbedo = 1.0;
+
+  // from Perez clearness parameter, 1+normal/diffuse irradiance. Without
+  // any diffuse light every photon comes from the sun (and without any
+  // light at all no photons are generated).
+  skyState->skyPhotonFraction = 0.0;
+  if (skyState->totalDiffuseIrradiance > 0.0) {
+    skyState->skyPhotonFraction =
+        skyState->totalDiffuseIrradiance /
+        (std::max(skyState->totalNormalIrradiance, 0.0) +
+         skyState->totalDiffuseIrradiance);
+  }
+
+  // Tabulate the sky again only when its cooked state changes
+  SkyFunction skyFunction(skyState->elevationAngle, skyState->turbidity,
+                          skyState->skyAlbedo);
+
+  if (!m_skySampler || m_skySampler->getState() != skyFunction.getState()) {
+    m_skySampler = std::make_shared<const SkySampler>(
+        skyFunction, m_skySamplerThetaBins, m_skySamplerGammaBins);
+  }
+  skyState->skySampler = m_skySampler;
+
+  // Photon energies can then be generated without modifying the spectrum.
+  // A column without any light has nothing to sample, but no photons are
+  // generated from it either.
+  if (skyState->totalNormalIrradiance > 0.0) {
+    skyState->spectrum->prepareSampling(Spectrum::DIRECT_NORMAL_IRRADIANCE);
+  }
+  if (skyState->totalDiffuseIrradiance > 0.0) {
+    skyState->spectrum->prepareSampling(
+        Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE);
+  }
+
+  // Evaluating the sun position above updates the factory settings too
+  m_skyState = skyState;
+  m_skyStateSettingsVersion = factory->getSettingsVersion();
+  return m_skyState;
 }
 
 bool Sun::isTimeDuringDay(time_t time) {
@@ -338,6 +462,25 @@ bool Sun::getClimateOption(RealClimateOption option) {
 
 void Sun::setClimateOption(RealClimateOption option, bool isEnabled) {
   m_climateOptions[option] = isEnabled;
+  this->m_recalculateEnvironment = true;
+  this->m_skyState.reset();
+}
+
+std::uint32_t Sun::getClimateOptionMask() const {
+  std::uint32_t mask = 0;
+
+  for (auto& option : m_climateOptions) {
+    if (option.second) mask |= 1u << option.first;
+  }
+  return mask;
+}
+
+void Sun::setSkySamplerResolution(unsigned int thetaBins,
+                                  unsigned int gammaBins) {
+  m_skySamplerThetaBins = thetaBins;
+  m_skySamplerGammaBins = gammaBins;
+  m_skySampler.reset();
+  m_skyState.reset();
 }
 
 double Sun::getAlbedo() {
@@ -9,9 +9,11 @@
  */
 
 #include "pvtree/full/solarSimulation/spectrum.hpp"
+#include "pvtree/full/solarSimulation/skyState.hpp"
 #include "pvtree/location/locationDetails.hpp"
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 // save diagnostic state
 #pragma GCC diagnostic push
@@ -65,6 +67,17 @@ class Sun {
 
   double m_albedo;
 
+  //! Sky state for the current time, until a setting changes
+  std::shared_ptr<const SkyState> m_skyState;
+
+  //! Spectrum factory settings the sky state was evaluated with
+  unsigned long m_skyStateSettingsVersion;
+
+  //! Diffuse light sampler, kept whilst the sky model state is unchanged
+  std::shared_ptr<const SkySampler> m_skySampler;
+  unsigned int m_skySamplerThetaBins;
+  unsigned int m_skySamplerGammaBins;
+
   /*! \brief Setting environment variables from climate factory.
    *
    */
@@ -130,6 +143,25 @@ class Sun {
    */
   std::shared_ptr<Spectrum> getSpectrum();
 
+  /*! \brief Get a snapshot of the sun and sky at the current time.
+   *
+   * The state is built once and then returned again until the date, time,
+   * location or climate options are changed. Building it is not thread
+   * safe, so with worker threads call this before starting the run; the
+   * workers then only read the stored state.
+   *
+   * \returns The light vector, solar position, albedo, spectrum and the
+   *          quantities derived from them for generating photons.
+   */
+  std::shared_ptr<const SkyState> getSkyState();
+
+  /*! \brief Get the date and time being evaluated.
+   *
+   * \returns The time since the epoch, treating the clock time as UTC in
+   *          the same way as setDate.
+   */
+  time_t getTime();
+
   /*! \brief Set the date for which sun should be evaluated
    *
    * The allowed range of year number is 1950 to 2050 due
@@ -192,6 +224,20 @@ class Sun {
    *data to be used.
    */
   void setClimateOption(RealClimateOption option, bool isEnabled);
+
+  /*! \brief Get all the climate options as a bit mask.
+   *
+   * Bit n is set when the option with RealClimateOption value n is enabled.
+   */
+  std::uint32_t getClimateOptionMask() const;
+
+  /*! \brief Set the grid on which the sky radiance is tabulated for
+   *         sampling the diffuse light.
+   *
+   * @param[in] thetaBins Number of cells between the zenith and the horizon.
+   * @param[in] gammaBins Number of cells around the sky.
+   */
+  void setSkySamplerResolution(unsigned int thetaBins, unsigned int gammaBins);
   
   /*! \brief Get the surface albedo from the climate data.
    *
@@ -7,9 +7,18 @@
 #include "G4VPhysicalVolume.hh"
 #include "G4ProcessManager.hh"
 #include "G4ParticleDefinition.hh"
-#include "G4SDManager.hh"
-
-SteppingAction::SteppingAction() : m_oneStepPrimaries(false) {
+#include "G4LogicalVolume.hh"
+#include "G4VSensitiveDetector.hh"
+#include "G4RunManager.hh"
+#include "G4Run.hh"
+
+std::atomic<unsigned long> SteppingAction::m_killedPhotonNumber(0ul);
+
+SteppingAction::SteppingAction()
+    : m_oneStepPrimaries(false),
+      m_killPhotons(false),
+      m_killMargin(0.0),
+      m_envelopeRunID(-1) {
   m_expectedNextStatus = Undefined;
 }
 
@@ -62,6 +71,15 @@ void SteppingAction::UserSteppingAction(const G4Step* step) {
   if (particleType == G4OpticalPhoton::OpticalPhotonDefinition()) {
     // Optical photon only
 
+    // Stop photons heading away from the trees through the world
+    if (m_killPhotons && thePostPV->GetMotherLogical() == 0 &&
+        !canReachTrees(thePostPoint)) {
+      theTrack->SetTrackStatus(fStopAndKill);
+      m_killedPhotonNumber++;
+      m_expectedNextStatus = Undefined;
+      return;
+    }
+
     // Was the photon absorbed by the absorption process
     //     if(thePostPoint->GetProcessDefinedStep()->GetProcessName() ==
     //     "OpAbsorption"){
@@ -97,14 +115,13 @@ void SteppingAction::UserSteppingAction(const G4Step* step) {
           break;
         case Detection: {
           // 	  G4cout << "Detection by " << thePostPV->GetName() << G4endl;
-          if (thePostPV->GetName() == "LeafSensitive") {
-            G4SDManager* SDman = G4SDManager::GetSDMpointer();
-            G4String photovoltaicCellsName = "PVTree/LeafSensitiveDetector";
-            bool showSearchWarning = false;
-            LeafTrackerSD* trackerSD =
-                static_cast<LeafTrackerSD*>(SDman->FindSensitiveDetector(
-                    photovoltaicCellsName, showSearchWarning));
-            if (trackerSD) trackerSD->ProcessHits_user(step, NULL);
+          // The leaf construction tags its sensitive volumes with the
+          // tracker of this thread, so no name comparisons are needed
+          G4VSensitiveDetector* sensitiveDetector =
+              thePostPV->GetLogicalVolume()->GetSensitiveDetector();
+          if (sensitiveDetector) {
+            static_cast<LeafTrackerSD*>(sensitiveDetector)
+                ->ProcessHits_user(step, NULL);
           }
           break;
         }
@@ -133,3 +150,34 @@ void SteppingAction::SetOneStepPrimaries(G4bool usesOneStepPrimaries) {
 }
 
 G4bool SteppingAction::GetOneStepPrimaries() { return m_oneStepPrimaries; }
+
+void SteppingAction::SetPhotonKilling(G4bool killPhotons,
+                                      G4double margin /* = 0.0 */) {
+  m_killPhotons = killPhotons;
+  m_killMargin = margin;
+}
+
+unsigned long SteppingAction::GetKilledPhotonNumber() {
+  return m_killedPhotonNumber;
+}
+
+void SteppingAction::ResetKilledPhotonNumber() { m_killedPhotonNumber = 0ul; }
+
+G4bool SteppingAction::canReachTrees(const G4StepPoint* postPoint) {
+  // The geometry may be rebuilt between runs
+  G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+  if (runID != m_envelopeRunID) {
+    m_treeEnvelope.update(postPoint->GetPhysicalVolume()->GetLogicalVolume());
+    m_envelopeRunID = runID;
+  }
+
+  // Without any trees there is nothing to aim for
+  if (!m_treeEnvelope.isFound()) return true;
+
+  // Photons heading down may be reflected back up by the floor
+  const G4ThreeVector& direction = postPoint->GetMomentumDirection();
+  if (direction.z() < 0.0) return true;
+
+  return m_treeEnvelope.isReachable(postPoint->GetPosition(), direction,
+                                    m_killMargin);
+}
@@ -4,6 +4,9 @@
 #include "globals.hh"
 #include "G4UserSteppingAction.hh"
 #include "G4OpBoundaryProcess.hh"
+#include "pvtree/full/treeEnvelope.hpp"
+
+#include <atomic>
 
 class SteppingAction : public G4UserSteppingAction {
  public:
@@ -14,9 +17,41 @@ class SteppingAction : public G4UserSteppingAction {
   void SetOneStepPrimaries(G4bool usesOneStepPrimaries);
   G4bool GetOneStepPrimaries();
 
+  /*! \brief Stop tracking optical photons in the world volume which can no
+   *         longer reach any tree. Disabled by default.
+   *
+   * A photon is killed once it is travelling through the air of the world
+   * upwards, or level, along a path which misses the box enclosing the
+   * trees. The air does not scatter and nothing is placed above the floor
+   * apart from the trees, so such a photon could only leave the world.
+   *
+   * @param[in] killPhotons Enable the killing of stray photons.
+   * @param[in] margin Distance by which the box around the trees is
+   *                   enlarged on every side.
+   */
+  void SetPhotonKilling(G4bool killPhotons, G4double margin = 0.0);
+
+  /*! \brief Get the number of photons killed by the stepping actions of
+   *         every thread since the last reset.
+   */
+  static unsigned long GetKilledPhotonNumber();
+  static void ResetKilledPhotonNumber();
+
  private:
   G4bool m_oneStepPrimaries;
   G4OpBoundaryProcessStatus m_expectedNextStatus;
+
+  // Stray photon killing
+  G4bool m_killPhotons;
+  G4double m_killMargin;
+  TreeEnvelope m_treeEnvelope;
+  G4int m_envelopeRunID;
+  static std::atomic<unsigned long> m_killedPhotonNumber;
+
+  /*! \brief Check if a photon in the world volume can still reach the
+   *         trees, finding the tree envelope again for each new run.
+   */
+  G4bool canReachTrees(const G4StepPoint* postPoint);
 };
 
 #endif  // PVTREE_FULL_STEPPING_ACTION_HPP
@@ -0,0 +1,84 @@
+#include "pvtree/full/treeEnvelope.hpp"
+
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Box.hh"
+
+#include <algorithm>
+#include <limits>
+
+TreeEnvelope::TreeEnvelope()
+    : m_found(false), m_minimum(0.0, 0.0, 0.0), m_maximum(0.0, 0.0, 0.0) {}
+
+bool TreeEnvelope::update(G4LogicalVolume* worldLV) {
+  bool foundTree = false;
+
+  for (G4int d = 0; d < worldLV->GetNoDaughters(); d++) {
+    G4VPhysicalVolume* daughter = worldLV->GetDaughter(d);
+    if (daughter->GetName() != "tree") continue;
+
+    G4Box* treeBox =
+        dynamic_cast<G4Box*>(daughter->GetLogicalVolume()->GetSolid());
+    if (!treeBox) continue;
+
+    // Include every corner of the placed tree box
+    G4RotationMatrix rotation = daughter->GetObjectRotationValue();
+    G4ThreeVector translation = daughter->GetObjectTranslation();
+    for (unsigned int c = 0; c < 8; c++) {
+      G4ThreeVector corner((c & 1u ? 1.0 : -1.0) * treeBox->GetXHalfLength(),
+                           (c & 2u ? 1.0 : -1.0) * treeBox->GetYHalfLength(),
+                           (c & 4u ? 1.0 : -1.0) * treeBox->GetZHalfLength());
+      corner = rotation * corner + translation;
+
+      for (unsigned int axis = 0; axis < 3; axis++) {
+        if (!foundTree || corner[axis] < m_minimum[axis]) {
+          m_minimum[axis] = corner[axis];
+        }
+        if (!foundTree || corner[axis] > m_maximum[axis]) {
+          m_maximum[axis] = corner[axis];
+        }
+      }
+      foundTree = true;
+    }
+  }
+
+  // Photons cannot reach anything below the floor
+  if (m_minimum.z() < 0.0) m_minimum.setZ(0.0);
+
+  m_found = foundTree && m_maximum.z() > m_minimum.z();
+  return m_found;
+}
+
+bool TreeEnvelope::isFound() const { return m_found; }
+
+const G4ThreeVector& TreeEnvelope::getMinimum() const { return m_minimum; }
+
+const G4ThreeVector& TreeEnvelope::getMaximum() const { return m_maximum; }
+
+bool TreeEnvelope::isReachable(const G4ThreeVector& position,
+                               const G4ThreeVector& direction,
+                               G4double margin) const {
+  // Distances along the path where it is between each pair of faces
+  G4double entryDistance = 0.0;
+  G4double exitDistance = std::numeric_limits<G4double>::max();
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    G4double lower = m_minimum[axis] - margin;
+    G4double upper = m_maximum[axis] + margin;
+
+    if (direction[axis] == 0.0) {
+      if (position[axis] < lower || position[axis] > upper) return false;
+      continue;
+    }
+
+    G4double lowerDistance = (lower - position[axis]) / direction[axis];
+    G4double upperDistance = (upper - position[axis]) / direction[axis];
+    if (lowerDistance > upperDistance) std::swap(lowerDistance, upperDistance);
+
+    if (lowerDistance > entryDistance) entryDistance = lowerDistance;
+    if (upperDistance < exitDistance) exitDistance = upperDistance;
+    if (entryDistance > exitDistance) return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef PVTREE_FULL_TREE_ENVELOPE_HPP
+#define PVTREE_FULL_TREE_ENVELOPE_HPP
+
+/*! @file
+ * \brief The axis aligned box enclosing all the trees placed in the world,
+ *        above the floor.
+ *
+ * Nothing outside of the box can detect a photon, so it is used both to aim
+ * the primary photons and to stop tracking photons which can no longer reach
+ * any leaf.
+ */
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+
+class G4LogicalVolume;
+
+class TreeEnvelope {
+ public:
+  TreeEnvelope();
+
+  /*! \brief Find the box enclosing the trees placed in a world volume.
+   *
+   * @param[in] worldLV The world, whose daughters named "tree" are the
+   *                    bounding boxes of the trees.
+   *
+   * \returns False if the world does not contain any trees.
+   */
+  bool update(G4LogicalVolume* worldLV);
+
+  /*! \brief Check if the last update found any trees.
+   */
+  bool isFound() const;
+
+  const G4ThreeVector& getMinimum() const;
+  const G4ThreeVector& getMaximum() const;
+
+  /*! \brief Check if a straight path crosses the box.
+   *
+   * @param[in] position The start of the path.
+   * @param[in] direction The direction of the path.
+   * @param[in] margin Distance by which the box is enlarged on every side.
+   *
+   * \returns True if the path starts inside or later enters the box.
+   */
+  bool isReachable(const G4ThreeVector& position,
+                   const G4ThreeVector& direction, G4double margin) const;
+
+ private:
+  bool m_found;
+  G4ThreeVector m_minimum;
+  G4ThreeVector m_maximum;
+};
+
+#endif  // PVTREE_FULL_TREE_ENVELOPE_HPP
@@ -29,3 +29,28 @@ void WeightedParticleGun::GenerateWeightedPrimaryVertex(G4Event* evt,
   }
   evt->AddPrimaryVertex(vertex);
 }
+
+void WeightedParticleGun::GenerateWeightedPrimaryVertices(
+    G4Event* evt, unsigned int particleNumber, const G4ThreeVector* positions,
+    const G4ThreeVector* directions, const double* energies,
+    const G4ThreeVector* polarisations, const double* weights) {
+  if (particle_definition == 0) return;
+
+  G4double mass = particle_definition->GetPDGMass();
+
+  for (unsigned int p = 0; p < particleNumber; p++) {
+    G4PrimaryVertex* vertex =
+        new G4PrimaryVertex(positions[p], particle_time);
+
+    G4PrimaryParticle* particle = new G4PrimaryParticle(particle_definition);
+    particle->SetKineticEnergy(energies[p]);
+    particle->SetMass(mass);
+    particle->SetMomentumDirection(directions[p]);
+    particle->SetCharge(particle_charge);
+    particle->SetPolarization(polarisations[p].x(), polarisations[p].y(),
+                              polarisations[p].z());
+    particle->SetWeight(weights[p]);
+    vertex->SetPrimary(particle);
+    evt->AddPrimaryVertex(vertex);
+  }
+}
@@ -22,6 +22,33 @@ class WeightedParticleGun : public G4ParticleGun {
    */
   void GenerateWeightedPrimaryVertex(G4Event* evt, double weight);
 
+  /*! \brief Add many primaries of the current particle definition to
+   *         the event in one call.
+   *
+   * Each primary takes its kinematics from the arrays rather than the
+   * gun settings, avoiding the per-particle setter calls. Every primary
+   * has its own vertex, as the recorders count the photons by vertex.
+   * The vertices and particles come from the per-thread G4Allocator pools,
+   * which reuse the storage released by earlier events, and are owned by
+   * the event.
+   *
+   * @param[in] evt The event to be filled.
+   * @param[in] particleNumber The number of primaries, all the arrays must
+   *                           be at least this long.
+   * @param[in] positions Starting positions.
+   * @param[in] directions Unit momentum directions.
+   * @param[in] energies Kinetic energies.
+   * @param[in] polarisations Polarisation vectors.
+   * @param[in] weights Weight of each primary.
+   */
+  void GenerateWeightedPrimaryVertices(G4Event* evt,
+                                       unsigned int particleNumber,
+                                       const G4ThreeVector* positions,
+                                       const G4ThreeVector* directions,
+                                       const double* energies,
+                                       const G4ThreeVector* polarisations,
+                                       const double* weights);
+
  private:
 };
 
@@ -1,8 +1,19 @@
 #include "pvtree/test/catch.hpp"
 #include "pvtree/full/solarSimulation/spectrumFactory.hpp"
+#include "pvtree/full/solarSimulation/HosekSkyModel.hpp"
+#include "pvtree/full/solarSimulation/skySampler.hpp"
+#include "pvtree/full/solarSimulation/sobolSequence.hpp"
 #include "pvtree/location/locationDetails.hpp"
 #include "pvtree/utils/resource.hpp"
 
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+
+#include "TH1D.h"
+#include "TF2.h"
+
 TEST_CASE("solarSimulation/spectrumFactory", "[sun]") {
   pvtree::loadEnvironment();
   // Get the device location details
@@ -44,4 +55,418 @@ TEST_CASE("solarSimulation/spectrumFactory", "[sun]") {
   std::shared_ptr<Spectrum> highElevationSpectrum = factory->getSpectrum();
 
   CHECK(*(lowElevationSpectrum.get()) != *(highElevationSpectrum.get()));
+
+  // Returning to previously seen conditions should be served from
+  // the memoized spectra without re-running SMARTS.
+  unsigned long previousHits = factory->getSpectrumCacheHits();
+  unsigned long previousMisses = factory->getSpectrumCacheMisses();
+
+  elevation = 10.0;
+  factory->setSolarPositionWithElevationAzimuth(elevation, 0.0);
+  std::shared_ptr<Spectrum> repeatedSpectrum = factory->getSpectrum();
+
+  CHECK(repeatedSpectrum == lowElevationSpectrum);
+  CHECK(factory->getSpectrumCacheHits() == previousHits + 1u);
+  CHECK(factory->getSpectrumCacheMisses() == previousMisses);
+
+  // Inputs within the same step share the spectrum of the step centre,
+  // whichever of them is requested first.
+  factory->clearCache();
+  factory->setSolarPositionWithElevationAzimuth(elevation + 0.004, 0.0);
+  std::shared_ptr<Spectrum> offsetSpectrum = factory->getSpectrum();
+
+  CHECK(*(offsetSpectrum.get()) == *(lowElevationSpectrum.get()));
+
+  // Disabling the memoization forces a new spectrum to be produced
+  factory->setSpectrumCacheSize(0u);
+  factory->setSolarPositionWithElevationAzimuth(60.0, 0.0);
+  factory->setSolarPositionWithElevationAzimuth(elevation, 0.0);
+  std::shared_ptr<Spectrum> uncachedSpectrum = factory->getSpectrum();
+
+  CHECK(uncachedSpectrum != lowElevationSpectrum);
+  CHECK(*(uncachedSpectrum.get()) == *(lowElevationSpectrum.get()));
+  CHECK(factory->getSpectrumCacheMisses() == previousMisses + 2u);
+  factory->setSpectrumCacheSize(1024u);
+}
+
+TEST_CASE("solarSimulation/spectrumTable", "[sun]") {
+  pvtree::loadEnvironment();
+  LocationDetails deviceLocation("location.cfg");
+
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setDefaults();
+  factory->setAltitude(deviceLocation.getAltitude());
+
+  // Small table using the reference atmosphere water and ozone
+  SpectrumTable table({10.0, 60.0}, {1015.0}, {}, {},
+                      deviceLocation.getAltitude());
+  CHECK_FALSE(table.isComplete());
+
+  factory->setSolarPositionWithElevationAzimuth(10.0, 0.0);
+  std::shared_ptr<Spectrum> lowElevationSpectrum = factory->getSpectrum();
+  table.setSpectrum(0, 0, 0, 0, lowElevationSpectrum);
+
+  factory->setSolarPositionWithElevationAzimuth(60.0, 0.0);
+  std::shared_ptr<Spectrum> highElevationSpectrum = factory->getSpectrum();
+  table.setSpectrum(1, 0, 0, 0, highElevationSpectrum);
+  CHECK(table.isComplete());
+
+  // Grid points are reproduced exactly
+  std::string column("Direct_normal_irradiance");
+  std::shared_ptr<Spectrum> gridSpectrum =
+      table.getSpectrum(10.0, 1015.0, 0.0, 0.0);
+  Spectrum::ColumnView gridValues = gridSpectrum->getColumn(column);
+  Spectrum::ColumnView lowElevationValues =
+      lowElevationSpectrum->getColumn(column);
+  CHECK(std::equal(gridValues.begin(), gridValues.end(),
+                   lowElevationValues.begin()));
+
+  // Between grid points the irradiance is bracketed by the neighbours
+  double lowIrradiance =
+      lowElevationSpectrum->getHistogram(column)->Integral("width");
+  double highIrradiance =
+      highElevationSpectrum->getHistogram(column)->Integral("width");
+  double middleIrradiance = table.getSpectrum(35.0, 1015.0, 0.0, 0.0)
+                                ->getHistogram(column)
+                                ->Integral("width");
+
+  CHECK(middleIrradiance == Approx((lowIrradiance + highIrradiance) / 2.0));
+
+  // The factory serves matching configurations from the table (including
+  // the cloud cover scaling of the direct irradiance)
+  table.setSmartsCardHash(factory->getSmartsCardHash());
+  factory->setSpectrumTable(std::make_shared<SpectrumTable>(table));
+  factory->setSolarPositionWithElevationAzimuth(35.0, 0.0);
+  CHECK(factory->getSpectrum()->getHistogram(column)->Integral("width") ==
+        Approx(middleIrradiance * 1.00001));
+
+  // Any other change to the SMARTS inputs stops the table being used
+  factory->setGasLoad(SpectrumFactory::SEVERE_POLLUTION);
+  CHECK(factory->getSmartsCardHash() != table.getSmartsCardHash());
+  factory->setDefaultGasLoad();
+  CHECK(factory->getSmartsCardHash() == table.getSmartsCardHash());
+  factory->setSpectrumTable(nullptr);
+}
+
+TEST_CASE("solarSimulation/spectrumFactoryThreads", "[sun]") {
+  pvtree::loadEnvironment();
+  LocationDetails deviceLocation("location.cfg");
+
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setDefaults();
+  factory->setAltitude(deviceLocation.getAltitude());
+  factory->setSolarPositionWithElevationAzimuth(30.0, 0.0);
+  std::shared_ptr<Spectrum> spectrum = factory->getSpectrum();
+
+  // Each thread has its own factory and configuration
+  std::vector<std::shared_ptr<Spectrum> > threadSpectra(4);
+  std::vector<bool> separateFactory(4, false);
+  std::vector<std::thread> threads;
+
+  for (unsigned int t = 0; t < threadSpectra.size(); t++) {
+    threads.push_back(std::thread([&, t]() {
+      SpectrumFactory* threadFactory = SpectrumFactory::instance();
+      threadFactory->setAltitude(deviceLocation.getAltitude());
+      threadFactory->setSolarPositionWithElevationAzimuth(30.0 + 20.0 * t,
+                                                          0.0);
+      separateFactory[t] = threadFactory != factory;
+      threadSpectra[t] = threadFactory->getSpectrum();
+    }));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  CHECK(separateFactory[0]);
+  CHECK(*(threadSpectra[0].get()) == *(spectrum.get()));
+  CHECK(*(threadSpectra[1].get()) != *(spectrum.get()));
+
+  // Configuration in other threads does not affect this one
+  CHECK(factory->getSpectrum() == spectrum);
+}
+
+TEST_CASE("solarSimulation/spectrumPhotonSampling", "[sun]") {
+  pvtree::loadEnvironment();
+  Spectrum spectrum("spectra/validation.default.results");
+
+  unsigned int photonNumber = 100000;
+  std::vector<double> photonEnergies(photonNumber);
+  spectrum.generatePhotonEnergies(photonEnergies.data(), photonNumber);
+
+  // Fraction of photons above 2 eV should follow the bin contents
+  auto histogram = spectrum.getHistogram("Direct_normal_irradiance");
+  double wavelengthCut = 619.92;  // nm for 2 eV
+  int cutBin = histogram->FindBin(wavelengthCut);
+  double expectedFraction =
+      histogram->Integral(1, cutBin - 1) / histogram->Integral();
+
+  unsigned int highEnergyPhotons = 0;
+  for (double energy : photonEnergies) {
+    CHECK(energy > 0.0);
+    if (energy > 2.0) highEnergyPhotons++;
+  }
+
+  double highEnergyFraction = highEnergyPhotons / (double)photonNumber;
+  CHECK(highEnergyFraction == Approx(expectedFraction).epsilon(0.02));
+}
+
+TEST_CASE("solarSimulation/spectrumColumns", "[sun]") {
+  pvtree::loadEnvironment();
+  Spectrum spectrum("spectra/validation.default.results");
+
+  // Columnar access matches the copied map
+  auto data = spectrum.getSMARTSData();
+  Spectrum::ColumnView wavelengths = spectrum.getColumn(Spectrum::WAVELENGTH);
+  Spectrum::ColumnView direct =
+      spectrum.getColumn(Spectrum::DIRECT_NORMAL_IRRADIANCE);
+
+  CHECK(wavelengths.size() == spectrum.getBinNumber());
+  CHECK(std::equal(wavelengths.begin(), wavelengths.end(),
+                   data["Wvlgth"].begin()));
+  CHECK(std::equal(direct.begin(), direct.end(),
+                   data["Direct_normal_irradiance"].begin()));
+  CHECK(spectrum.getColumnIndex("NotAColumn") == -1);
+
+  // Rebuilding from the columns gives the same spectrum
+  Spectrum rebuilt(spectrum.getSMARTSColumnNames(), data);
+  CHECK(rebuilt == spectrum);
+
+  // Cached integrals agree with the histograms
+  for (auto& columnName : spectrum.getSMARTSColumnNames()) {
+    CHECK(spectrum.getIntegral(columnName) ==
+          Approx(spectrum.getHistogram(columnName)->Integral("width")));
+  }
+  CHECK(spectrum.getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE) ==
+        Approx(rebuilt.getIntegral("Direct_normal_irradiance")));
+}
+
+TEST_CASE("solarSimulation/spectrumArchive", "[sun]") {
+  pvtree::loadEnvironment();
+  std::shared_ptr<Spectrum> spectrum =
+      std::make_shared<Spectrum>("spectra/validation.default.results");
+  std::string archiveFileName("spectrumArchive.test.bin");
+
+  // Entries are stored out of order to check the lookup
+  SpectrumArchive::write(archiveFileName, {2000, 1000}, {spectrum, spectrum},
+                         51.5, -0.1, 0.02, 0x0fu, 0.5, 42u);
+
+  std::shared_ptr<Spectrum> archivedSpectrum;
+  {
+    SpectrumArchive archive(archiveFileName);
+    CHECK(archive.getEntryNumber() == 2ul);
+    CHECK(archive.matchesLocation(51.5, -0.1, 0.02));
+    CHECK_FALSE(archive.matchesLocation(51.5, -0.1, 0.5));
+    CHECK(archive.matchesConditions(0x0fu, 0.5, 42u));
+    CHECK_FALSE(archive.matchesConditions(0x1fu, 0.5, 42u));
+    CHECK_FALSE(archive.matchesConditions(0x0fu, 2.0, 42u));
+    CHECK_FALSE(archive.matchesConditions(0x0fu, 0.5, 43u));
+    CHECK_FALSE(archive.getSpectrum(1500));
+
+    archivedSpectrum = archive.getSpectrum(1000);
+    REQUIRE(archivedSpectrum);
+  }
+
+  // Spectrum remains valid after the archive is gone
+  CHECK(*archivedSpectrum == *spectrum);
+  CHECK(archivedSpectrum->getHistogram("Direct_normal_irradiance")
+            ->Integral("width") ==
+        Approx(spectrum->getHistogram("Direct_normal_irradiance")
+                   ->Integral("width")));
+
+  // The factory only uses the archive for the archived times
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setDefaults();
+  factory->setSpectrumArchive(
+      std::make_shared<SpectrumArchive>(archiveFileName));
+  unsigned long archiveHits = factory->getSpectrumArchiveHits();
+
+  CHECK(*factory->getSpectrum(2000) == *spectrum);
+  CHECK(factory->getSpectrumArchiveHits() == archiveHits + 1);
+  factory->getSpectrum(3000);
+  CHECK(factory->getSpectrumArchiveHits() == archiveHits + 1);
+
+  factory->setSpectrumArchive(nullptr);
+  std::remove(archiveFileName.c_str());
+}
+
+TEST_CASE("solarSimulation/spectrumWavelengthInterval", "[sun]") {
+  pvtree::loadEnvironment();
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setDefaults();
+
+  CHECK_THROWS(factory->setWavelengthInterval(0.7));
+  CHECK_THROWS(factory->setWavelengthInterval(0.0));
+
+  std::shared_ptr<Spectrum> fineSpectrum = factory->getSpectrum();
+
+  factory->setWavelengthInterval(5.0);
+  CHECK(factory->getWavelengthInterval() == Approx(5.0));
+  std::shared_ptr<Spectrum> coarseSpectrum = factory->getSpectrum();
+
+  // Fewer bins but a similar total irradiance
+  Spectrum::ColumnView wavelengths =
+      coarseSpectrum->getColumn(Spectrum::WAVELENGTH);
+  CHECK(coarseSpectrum->getBinNumber() < fineSpectrum->getBinNumber() / 2);
+  double wavelengthStep = wavelengths[1] - wavelengths[0];
+  CHECK(wavelengthStep == Approx(5.0));
+  CHECK(coarseSpectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE) ==
+        Approx(fineSpectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE))
+            .epsilon(0.05));
+
+  factory->setDefaults();
+}
+
+TEST_CASE("solarSimulation/spectrumCloudCover", "[sun]") {
+  pvtree::loadEnvironment();
+  SpectrumFactory* factory = SpectrumFactory::instance();
+  factory->setDefaults();
+
+  std::shared_ptr<Spectrum> clearSpectrum = factory->getSpectrum();
+  unsigned long previousMisses = factory->getSpectrumCacheMisses();
+
+  // Changing only the cloud cover does not need SMARTS to be run
+  factory->setCloudCover(0.5);
+  std::shared_ptr<Spectrum> cloudySpectrum = factory->getSpectrum();
+
+  CHECK(factory->getSpectrumCacheMisses() == previousMisses);
+  double directRatio =
+      cloudySpectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE) /
+      clearSpectrum->getIntegral(Spectrum::DIRECT_NORMAL_IRRADIANCE);
+  CHECK(directRatio == Approx(0.50001 / 1.00001));
+  CHECK(cloudySpectrum->getIntegral(Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE) ==
+        clearSpectrum->getIntegral(Spectrum::DIFFUSE_HORIZONTAL_IRRADIANCE));
+
+  // Clear sky spectrum is unaffected
+  factory->setCloudCover(0.0);
+  CHECK(*factory->getSpectrum() == *clearSpectrum);
+  CHECK(factory->getSpectrumCacheMisses() == previousMisses);
+
+  factory->setDefaults();
+}
+
+TEST_CASE("solarSimulation/skySampler", "[sun]") {
+  pvtree::loadEnvironment();
+  double pi = acos(-1.0);
+  SkyFunction skyFunction(0.6, 3.5, 0.2);
+  SkySampler sampler(skyFunction, 45u, 90u);
+
+  CHECK(sampler.getState() == skyFunction.getState());
+
+  // Directions should follow the previous TF2 sampling of the sky function.
+  // Histogram bins are aligned with the cells of both grids.
+  TF2 skyDistribution("skyDistribution", &skyFunction, &SkyFunction::Eval,
+                      0.0, pi / 2.0, 0.0, 2.0 * pi, 0, "SkyFunction", "Eval");
+  skyDistribution.SetNpx(30);
+  skyDistribution.SetNpy(30);
+
+  TH1D sampledTheta("sampledTheta", "", 15, 0.0, pi / 2.0);
+  TH1D sampledGamma("sampledGamma", "", 15, 0.0, 2.0 * pi);
+  TH1D expectedTheta("expectedTheta", "", 15, 0.0, pi / 2.0);
+  TH1D expectedGamma("expectedGamma", "", 15, 0.0, 2.0 * pi);
+
+  double theta, gamma;
+  for (unsigned int sample = 0; sample < 100000; sample++) {
+    sampler.generateDirection(theta, gamma);
+    CHECK(theta >= 0.0);
+    CHECK(theta <= pi / 2.0);
+    sampledTheta.Fill(theta);
+    sampledGamma.Fill(gamma);
+
+    skyDistribution.GetRandom2(theta, gamma);
+    expectedTheta.Fill(theta);
+    expectedGamma.Fill(gamma);
+  }
+
+  double expectedMeanTheta = expectedTheta.GetMean();
+  double expectedMeanGamma = expectedGamma.GetMean();
+  CHECK(sampledTheta.GetMean() == Approx(expectedMeanTheta).epsilon(0.01));
+  CHECK(sampledGamma.GetMean() == Approx(expectedMeanGamma).epsilon(0.01));
+  CHECK(sampledTheta.Chi2Test(&expectedTheta, "UU") > 0.001);
+  CHECK(sampledGamma.Chi2Test(&expectedGamma, "UU") > 0.001);
+
+  // Directions for a wavelength follow the radiance of its channel, or
+  // the radiance interpolated between two channels (380nm)
+  for (double wavelength : {320.0, 720.0, 380.0}) {
+    double channelPosition =
+        (wavelength - HosekSkyModelData::firstChannelWavelength) /
+        HosekSkyModelData::channelWavelengthStep;
+    unsigned int channel = (unsigned int)channelPosition;
+    double fraction = channelPosition - channel;
+    std::vector<double> thetas, gammas;
+    for (unsigned int t = 0; t < 90; t++) {
+      for (unsigned int g = 0; g < 180; g++) {
+        thetas.push_back((t + 0.5) * pi / 180.0);
+        gammas.push_back((g + 0.5) * pi / 90.0);
+      }
+    }
+
+    const HosekSkyModelState& state = *skyFunction.getState();
+    std::vector<double> radiances(thetas.size() * state.getChannelNumber());
+    state.evaluateChannelRadiances(thetas.data(), gammas.data(),
+                                   radiances.data(), thetas.size());
+
+    double weightedTheta = 0.0, totalRadiance = 0.0;
+    for (unsigned int i = 0; i < thetas.size(); i++) {
+      double radiance =
+          (1.0 - fraction) * radiances[channel * thetas.size() + i];
+      if (fraction > 0.0) {
+        radiance += fraction * radiances[(channel + 1) * thetas.size() + i];
+      }
+      weightedTheta += radiance * thetas[i];
+      totalRadiance += radiance;
+    }
+
+    double meanTheta = 0.0;
+    for (unsigned int sample = 0; sample < 100000; sample++) {
+      sampler.generateDirection(wavelength, theta, gamma);
+      meanTheta += theta / 100000.0;
+    }
+
+    double expectedMean = weightedTheta / totalRadiance;
+    CHECK(meanTheta == Approx(expectedMean).epsilon(0.01));
+  }
+}
+
+TEST_CASE("solarSimulation/sobolSequence", "[sun]") {
+  SobolSequence sequence(42u);
+  unsigned int level = 8;
+  unsigned int pointNumber = 1u << level;
+
+  for (unsigned int group = 0; group < 3; group++) {
+    // Every dimension has one point in each interval of width 1/N
+    for (unsigned int d = 0; d < SobolSequence::dimensionNumber; d++) {
+      std::vector<unsigned int> counts(pointNumber, 0u);
+      for (unsigned int p = 0; p < pointNumber; p++) {
+        double value = sequence.sample(p, d, group);
+        REQUIRE(value >= 0.0);
+        REQUIRE(value < 1.0);
+        counts[(unsigned int)(value * pointNumber)]++;
+      }
+      CHECK(std::count(counts.begin(), counts.end(), 1u) == pointNumber);
+    }
+
+    // The first two dimensions have one point in each elementary interval
+    for (unsigned int xLevel = 0; xLevel <= level; xLevel++) {
+      unsigned int xCells = 1u << xLevel;
+      unsigned int yCells = pointNumber / xCells;
+      std::vector<unsigned int> counts(pointNumber, 0u);
+      for (unsigned int p = 0; p < pointNumber; p++) {
+        unsigned int x = sequence.sample(p, 0, group) * xCells;
+        unsigned int y = sequence.sample(p, 1, group) * yCells;
+        counts[x * yCells + y]++;
+      }
+      CHECK(std::count(counts.begin(), counts.end(), 1u) == pointNumber);
+    }
+  }
+
+  // Averaging over seeds gives uniformly distributed points
+  unsigned int seedNumber = 100000;
+  double sum = 0.0;
+  for (unsigned int s = 0; s < seedNumber; s++) {
+    sequence.setSeed(s);
+    sum += sequence.sample(7u, 3, 1);
+  }
+  double mean = sum / seedNumber;
+  CHECK(mean == Approx(0.5).epsilon(0.01));
 }